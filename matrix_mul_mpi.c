@@ -1,14 +1,90 @@
 /*
     How to compile and run this code:
-    Compile: mpicc -o matrix_mpi matrix_mul_mpi.c
+    Compile: mpicc -o matrix_mpi matrix_mul_mpi.c -lm
     Run:     mpirun -np 2 ./matrix_mpi
+             mpirun -np 2 ./matrix_mpi --progress-thread
+             mpirun -np 2 ./matrix_mpi --overlap-bench
+             mpirun -np 4 ./matrix_mpi --coll-tune coll.tune
+             mpirun -np 3 ./matrix_mpi --structure symmetric --verify
+             mpirun -np 4 ./matrix_mpi --dims 40 30 20 10
+             mpirun -np 2 ./matrix_mpi --gemv 8
+             mpirun -np 4 ./matrix_mpi --solve cyclic
+             mpirun -np 8 ./matrix_mpi --2.5d 2 --verify
+             mpirun -np 8 ./matrix_mpi --2.5d 2 --topo-grid
+             mpirun -np 8 ./matrix_mpi --2.5d 2 --topo-grid --simulate-nodes 2 --verify
 
     This program performs matrix multiplication using MPI, distributing the work across multiple processes.
+
+    Options:
+      --progress-thread  scatter and gather in stages that overlap the multiplication, with a thread
+                         that keeps MPI progressing meanwhile (needs MPI_THREAD_MULTIPLE)
+      --overlap-bench    measure how much of the communication that pipeline actually hides
+      --coll-tune <file> scatter and gather with the algorithms tuned for this machine (see mpi_coll.h);
+                         the first run with a new file or process count benchmarks them and fills it
+      --structure <s>    full (default); symmetric: R = A * A^T, only the lower triangle is computed and
+                         then mirrored; lower / upper: A is triangular and its zero half is skipped.
+                         The output rows are split over the processes by their cost, not by count.
+      --dims <K> <M> <N> <P>
+                         multiply K pairs of M x N and N x P matrices instead of the default 100 x 50 x 50 x 50
+      --verify           compare R with the plain kernel on rank 0
+      --gemv <v>         benchmark batched matrix-vector products instead: K 1024 x 1024 byte matrices,
+                         each times v vectors in one pass, in bytes/s against the STREAM triad
+      --solve <mode>     solve linear systems modulo the prime 65521 instead, by blocked LU: batch solves
+                         and inverts K systems of order M spread over the processes; cyclic solves one
+                         system of order 768 stored block-cyclically on a 2D process grid
+      --2.5d <c>         one 768 x 768 product by the 2.5D algorithm instead, on a q x q x c process grid
+                         (c copies of A and B, c <= q); c = 1 is plain SUMMA
+      --topo-grid        lay the process grids of --solve cyclic and --2.5d out by node locality (library
+                         reordering through MPI_Cart_create / MPI_Dist_graph_create_adjacent, or node
+                         blocks), reporting the share of neighbour bytes that stays on-node before and after
+      --simulate-nodes <n>
+                         treat the processes as placed round-robin on n nodes (rank r on node r % n), to try
+                         --topo-grid and the node-aware collectives on one machine
 */
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
 #include <mpi.h>
+#include "mpi_coll.h"
+
+#define STAGES 4  // Pipeline stages of the staged scatter/multiply/gather
+
+// Progress thread. Many MPI libraries advance nonblocking transfers only while the process is
+// inside an MPI call, so a staged Iscatterv would otherwise stall while the rank multiplies.
+// The thread keeps probing a private communicator, which turns the progress engine.
+static pthread_t progressThread;
+static atomic_int progressStop;
+static MPI_Comm progressComm;
+
+// Body of the progress thread
+void *progress_loop(void *arg) {
+    int flag;
+    while (!atomic_load(&progressStop)) {
+        MPI_Iprobe(MPI_ANY_SOURCE, MPI_ANY_TAG, progressComm, &flag, MPI_STATUS_IGNORE);
+        sched_yield();
+    }
+    return arg;
+}
+
+// Starts the progress thread (local, not collective)
+void start_progress(void) {
+    MPI_Comm_dup(MPI_COMM_SELF, &progressComm);  // Nothing is ever sent on it
+    atomic_store(&progressStop, 0);
+    pthread_create(&progressThread, NULL, progress_loop, NULL);
+}
+
+// Stops and joins the progress thread
+void stop_progress(void) {
+    atomic_store(&progressStop, 1);
+    pthread_join(progressThread, NULL);
+    MPI_Comm_free(&progressComm);
+}
 
 // Function to print a matrix (for debugging purposes)
 void display(int rows, int cols, int matrix[rows][cols]) {
@@ -21,15 +97,993 @@ void display(int rows, int cols, int matrix[rows][cols]) {
     printf("\n");
 }
 
+// Multiplies `count` pairs of matrices; every product and the final sum are taken modulo 100
+void multiply(int count, int M, int N, int P, int A[count][M][N], int B[count][N][P], int R[count][M][P]) {
+    for(int k = 0; k < count; k++) {
+        for(int i = 0; i < M; i++) {         // Iterate over rows of matrix A
+            for(int j = 0; j < P; j++) {     // Iterate over columns of matrix B
+                R[k][i][j] = 0;  // Initialize the result element to 0
+                for(int l = 0; l < N; l++) {  // Perform dot product for multiplication
+                    R[k][i][j] += (A[k][i][l] * B[k][l][j]) % 100;  // Modulo 100
+                }
+                R[k][i][j] %= 100;  // Take modulo 100 for the final result
+            }
+        }
+    }
+}
+
+// Staged version of scatter -> multiply -> gather. Every rank's block of `per` matrices is split
+// into STAGES pieces; all the Iscatterv calls are posted up front, each piece is multiplied as
+// soon as it has arrived and sent back with an Igatherv while the next one is multiplied.
+// With compute = 0 only the transfers run (used by the overlap benchmark).
+void pipelined_multiply(int K, int M, int N, int P, int A[K][M][N], int B[K][N][P], int R[K][M][P], int per,
+                        int localA[per][M][N], int localB[per][N][P], int localR[per][M][P], int size, int compute) {
+    int counts[3][STAGES][size], displs[3][STAGES][size];  // A, B and R element counts per stage and rank
+    int sizes[3] = {M * N, N * P, M * P};
+    MPI_Request scatters[STAGES][2], gathers[STAGES];
+    for(int s = 0; s < STAGES; s++) {
+        int first = per * s / STAGES, count = per * (s + 1) / STAGES - first;  // Matrices of this stage
+        for(int m = 0; m < 3; m++) {
+            for(int r = 0; r < size; r++) {
+                counts[m][s][r] = count * sizes[m];
+                displs[m][s][r] = (r * per + first) * sizes[m];
+            }
+        }
+        MPI_Iscatterv(A, counts[0][s], displs[0][s], MPI_INT, localA[first], count * M * N, MPI_INT, 0, MPI_COMM_WORLD, &scatters[s][0]);
+        MPI_Iscatterv(B, counts[1][s], displs[1][s], MPI_INT, localB[first], count * N * P, MPI_INT, 0, MPI_COMM_WORLD, &scatters[s][1]);
+    }
+    for(int s = 0; s < STAGES; s++) {
+        int first = per * s / STAGES, count = per * (s + 1) / STAGES - first;
+        MPI_Waitall(2, scatters[s], MPI_STATUSES_IGNORE);
+        if(compute) {
+            multiply(count, M, N, P, localA + first, localB + first, localR + first);
+        }
+        MPI_Igatherv(localR[first], count * M * P, MPI_INT, R, counts[2][s], displs[2][s], MPI_INT, 0, MPI_COMM_WORLD, &gathers[s]);
+    }
+    MPI_Waitall(STAGES, gathers, MPI_STATUSES_IGNORE);
+}
+
+// Structure of the operands (--structure). SYMMETRIC computes R = A * A^T, whose lower triangle is
+// computed and mirrored; LOWER and UPPER take A as a square triangular matrix and skip its zeros.
+enum { FULL, SYMMETRIC, LOWER, UPPER };
+static const char *structureNames[] = {"full", "symmetric", "lower", "upper"};
+
+// Multiply-adds needed for output row i under the structure
+long row_cost(int structure, int i, int M, int N, int P) {
+    if(structure == SYMMETRIC) return (long)(i + 1) * N;  // Columns j <= i only
+    if(structure == LOWER) return (long)(i + 1) * P;      // A[i][l] = 0 for l > i
+    if(structure == UPPER) return (long)(M - i) * P;      // A[i][l] = 0 for l < i
+    return (long)N * P;
+}
+
+// First output row of run r when the output rows of all K matrices, numbered k * M + i, are cut
+// into `size` consecutive runs of about equal cost
+int run_start(int structure, int K, int M, int N, int P, int size, int r) {
+    long total = 0, done = 0;
+    for(int i = 0; i < M; i++) total += K * row_cost(structure, i, M, N, P);
+    int g = 0;
+    while(g < K * M && done < total * r / size) done += row_cost(structure, g++ % M, M, N, P);
+    return g;
+}
+
+// The run of output rows [*first, *last) that `rank` computes
+void balanced_rows(int structure, int K, int M, int N, int P, int size, int rank, int *first, int *last) {
+    *first = run_start(structure, K, M, N, P, size, rank);
+    *last = rank + 1 < size ? run_start(structure, K, M, N, P, size, rank + 1) : K * M;
+}
+
+// Rows of A and B a band of output rows [first, last) reads: [*a0, *a1) and [*b0, *b1)
+void band_inputs(int structure, int first, int last, int M, int *a0, int *a1, int *b0, int *b1) {
+    *a0 = structure == SYMMETRIC ? 0 : first;  // Row j <= i of A serves as column j of A^T
+    *a1 = last;
+    *b0 = structure == UPPER ? first : 0;
+    *b1 = structure == UPPER ? M : structure == LOWER ? last : 0;
+}
+
+// Output values of rows [first, last): the lower triangle only when symmetric
+long band_outputs(int structure, int first, int last, int P) {
+    if(structure == SYMMETRIC) return (long)last * (last + 1) / 2 - (long)first * (first + 1) / 2;
+    return (long)(last - first) * P;
+}
+
+// Ints exchanged for a rank's run of rows, split at matrix boundaries into bands: the input
+// rows it needs (inputs) and the output values it returns (outputs)
+void run_sizes(int structure, int K, int M, int N, int P, int size, int rank, long *inputs, long *outputs) {
+    int first, last, a0, a1, b0, b1;
+    balanced_rows(structure, K, M, N, P, size, rank, &first, &last);
+    *inputs = *outputs = 0;
+    for(int g = first; g < last; g = (g / M + 1) * M) {
+        int lo = g % M, hi = last - g / M * M < M ? last - g / M * M : M;  // Band [lo, hi) of matrix g / M
+        band_inputs(structure, lo, hi, M, &a0, &a1, &b0, &b1);
+        *inputs += (long)(a1 - a0) * N + (long)(b1 - b0) * P;
+        *outputs += band_outputs(structure, lo, hi, P);
+    }
+}
+
+// Computes output rows [first, last) of one matrix from A rows starting at a0 and B rows
+// starting at b0, skipping the structural zeros; appends the values to out (mod 100, as in multiply)
+int *multiply_band(int structure, int first, int last, int N, int P, const int *a, int a0, const int *b, int b0, int *out) {
+    for(int i = first; i < last; i++) {
+        const int *rowA = a + (long)(i - a0) * N;
+        int columns = structure == SYMMETRIC ? i + 1 : P;
+        for(int j = 0; j < columns; j++) {
+            int sum = 0;
+            if(structure == SYMMETRIC) {
+                const int *rowJ = a + (long)(j - a0) * N;
+                for(int l = 0; l < N; l++) sum += (rowA[l] * rowJ[l]) % 100;
+            } else {
+                int from = structure == UPPER ? i : 0, to = structure == LOWER ? i + 1 : N;
+                for(int l = from; l < to; l++) sum += (rowA[l] * b[(long)(l - b0) * P + j]) % 100;
+            }
+            *out++ = sum % 100;
+        }
+    }
+    return out;
+}
+
+// Structure-aware multiplication of all K matrices: rank 0 sends every rank the input rows of its
+// balanced run of output rows, each rank computes its run, and rank 0 assembles R (mirroring the
+// symmetric triangle). Returns the time of the local computation.
+double structured_multiply(coll_ctx *coll, int structure, int K, int M, int N, int P, int A[K][M][N], int B[K][N][P],
+                           int R[K][M][P], int rank, int size) {
+    int inCounts[size], inDispls[size], outCounts[size], outDispls[size];
+    long totalIn = 0, totalOut = 0;
+    for(int r = 0; r < size; r++) {
+        long inputs, outputs;
+        run_sizes(structure, K, M, N, P, size, r, &inputs, &outputs);
+        inCounts[r] = inputs * sizeof(int);
+        outCounts[r] = outputs * sizeof(int);
+        inDispls[r] = totalIn * sizeof(int);
+        outDispls[r] = totalOut * sizeof(int);
+        totalIn += inputs;
+        totalOut += outputs;
+    }
+
+    // Rank 0 packs the needed rows of every band, rank by rank
+    int *packed = malloc((rank == 0 ? totalIn : 1) * sizeof(int)), *results = malloc((rank == 0 ? totalOut : 1) * sizeof(int));
+    int *mine = malloc((inCounts[rank] / sizeof(int) + 1) * sizeof(int)), *computed = malloc(outCounts[rank] + sizeof(int));
+    int first, last, a0, a1, b0, b1;
+    if(rank == 0) {
+        int *p = packed;
+        for(int r = 0; r < size; r++) {
+            balanced_rows(structure, K, M, N, P, size, r, &first, &last);
+            for(int g = first; g < last; g = (g / M + 1) * M) {
+                int k = g / M, lo = g % M, hi = last - k * M < M ? last - k * M : M;
+                band_inputs(structure, lo, hi, M, &a0, &a1, &b0, &b1);
+                memcpy(p, A[k][a0], (long)(a1 - a0) * N * sizeof(int));
+                p += (long)(a1 - a0) * N;
+                if(b1 > b0) memcpy(p, B[k][b0], (long)(b1 - b0) * P * sizeof(int));
+                p += (long)(b1 - b0) * P;
+            }
+        }
+    }
+    coll_scatterv(coll, packed, inCounts, inDispls, mine, 0);
+
+    // Multiply the bands of this rank's run
+    double start = MPI_Wtime();
+    balanced_rows(structure, K, M, N, P, size, rank, &first, &last);
+    const int *in = mine;
+    int *out = computed;
+    for(int g = first; g < last; g = (g / M + 1) * M) {
+        int lo = g % M, hi = last - g / M * M < M ? last - g / M * M : M;
+        band_inputs(structure, lo, hi, M, &a0, &a1, &b0, &b1);
+        const int *b = in + (long)(a1 - a0) * N;
+        out = multiply_band(structure, lo, hi, N, P, in, a0, b, b0, out);
+        in = b + (long)(b1 - b0) * P;
+    }
+    double took = MPI_Wtime() - start;
+    coll_gatherv(coll, computed, outCounts, results, outDispls, 0);
+
+    // Rank 0 unpacks the bands into R
+    if(rank == 0) {
+        const int *p = results;
+        for(int r = 0; r < size; r++) {
+            balanced_rows(structure, K, M, N, P, size, r, &first, &last);
+            for(int g = first; g < last; g++) {
+                int k = g / M, i = g % M;
+                for(int j = 0; j < (structure == SYMMETRIC ? i + 1 : P); j++) {
+                    R[k][i][j] = *p++;
+                    if(structure == SYMMETRIC) R[k][j][i] = R[k][i][j];
+                }
+            }
+        }
+    }
+    free(packed);
+    free(results);
+    free(mine);
+    free(computed);
+    return took;
+}
+
+// Batched matrix-vector products (--gemv). Every matrix is multiplied by a batch of v vectors,
+// the shape of inference-style jobs. The weights live where they are used: each process
+// generates its own share of the K matrices. Values are 0..99 as in the main program, so they
+// are stored in bytes, a quarter of the memory traffic of ints.
+#define GEMV_ROWS 1024        // Rows of every matrix
+#define GEMV_COLS 1024        // Columns of every matrix (= vector length)
+#define GEMV_BLOCK 8          // Vectors that share one pass over a row
+#define GEMV_LANES 16         // Byte products summed side by side in the dot product
+#define GEMV_PREFETCH 4       // Rows ahead whose lines are prefetched with a non-temporal hint
+#define STREAM_ELEMENTS (1L << 25)  // Doubles per STREAM array, split over all processes
+
+// Deterministic pseudo-random value 0..modulus-1 for element `i` of stream `seed` (same on every rank)
+int seeded_value(long seed, long i, int modulus) {
+    unsigned long x = (seed * 0x9E3779B97F4A7C15UL) ^ (i * 0xBF58476D1CE4E5B9UL);
+    x ^= x >> 31;
+    x *= 0x94D049BB133111EBUL;
+    return (int)((x >> 33) % modulus);
+}
+
+// Dot product of two byte vectors. Products are at most 99 * 99, so 32 bits hold any row. The
+// fixed-width lanes are what lets the compiler use SIMD multiply-adds at -O2.
+static inline unsigned gemv_dot(int N, const unsigned char *a, const unsigned char *x) {
+    unsigned lane[GEMV_LANES] = {0}, acc = 0;
+    int l = 0;
+    for(; l + GEMV_LANES <= N; l += GEMV_LANES) {
+        for(int j = 0; j < GEMV_LANES; j++) lane[j] += a[l + j] * x[l + j];
+    }
+    for(; l < N; l++) acc += a[l] * x[l];
+    for(int j = 0; j < GEMV_LANES; j++) acc += lane[j];
+    return acc;
+}
+
+// Y = A * X for one M x N byte matrix and v vectors of N bytes stored one after another
+// (x + c * N is vector c); y[i * v + c] as multiply() would compute it with P = v. A streams
+// from memory once, row by row, with the rows GEMV_PREFETCH ahead requested under a
+// non-temporal hint; each row is then reused from L1 for GEMV_BLOCK vectors at a time, so the
+// batch costs one pass over A instead of v. Since the sum of (p % 100) is congruent to the sum
+// of p, every product is reduced once at the end instead of per term.
+void gemv_narrow(int M, int N, int v, const unsigned char *A, const unsigned char *x, int *y) {
+    for(int i = 0; i < M; i++) {
+        const unsigned char *row = A + (long)i * N;
+        if(i + GEMV_PREFETCH < M) {
+            for(int l = 0; l < N; l += 64) __builtin_prefetch(row + (long)GEMV_PREFETCH * N + l, 0, 0);
+        }
+        for(int c0 = 0; c0 < v; c0 += GEMV_BLOCK) {
+            int end = c0 + GEMV_BLOCK < v ? c0 + GEMV_BLOCK : v;
+            for(int c = c0; c < end; c++) y[(long)i * v + c] = gemv_dot(N, row, x + (long)c * N) % 100;
+        }
+    }
+}
+
+// STREAM triad a = b + s * c on every process at once; returns the job's bandwidth in bytes/s
+// (24 bytes per element, counted as STREAM does), best of 5
+double stream_triad(int size) {
+    long n = STREAM_ELEMENTS / size;
+    double *a = malloc(n * sizeof(double)), *b = malloc(n * sizeof(double)), *c = malloc(n * sizeof(double));
+    for(long i = 0; i < n; i++) {
+        a[i] = 0;
+        b[i] = 1;
+        c[i] = 2;
+    }
+    double best = 1e30;
+    for(int t = 0; t < 5; t++) {
+        MPI_Barrier(MPI_COMM_WORLD);
+        double t0 = MPI_Wtime();
+        for(long i = 0; i < n; i++) a[i] = b[i] + 3.0 * c[i];
+        double mine = MPI_Wtime() - t0, slowest;
+        MPI_Allreduce(&mine, &slowest, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+        if(slowest < best) best = slowest;
+    }
+    volatile double sink = a[n / 2];          // Keep the triad from being optimized away
+    (void)sink;
+    free(a);
+    free(b);
+    free(c);
+    return 24.0 * n * size / best;
+}
+
+// GEMV benchmark: the byte kernel against the general kernel run with P = v on int copies of the
+// same data, both checked against each other, and against the STREAM triad bandwidth. Reports
+// bytes/s over the whole job (matrix bytes read per pass / slowest process), best of 3.
+void gemv_benchmark(coll_ctx *coll, int K, int v, int rank, int size) {
+    int M = GEMV_ROWS, N = GEMV_COLS, first = K * rank / size, count = K * (rank + 1) / size - first;
+    long matrix = (long)M * N;
+    unsigned char *A = malloc(count * matrix + 1), *X = malloc((long)count * N * v + 1);
+    int *Y = malloc((long)count * M * v * sizeof(int) + 1), *Yint = malloc((long)count * M * v * sizeof(int) + 1);
+    for(int k = 0; k < count; k++) {
+        for(long i = 0; i < matrix; i++) A[k * matrix + i] = seeded_value(first + k, i, 100);
+        for(long i = 0; i < (long)N * v; i++) X[(long)k * N * v + i] = seeded_value(-1 - first - k, i, 100);
+    }
+
+    // Narrow kernel
+    double narrow = 1e30, general = 1e30;
+    for(int t = 0; t < 3; t++) {
+        MPI_Barrier(MPI_COMM_WORLD);
+        double t0 = MPI_Wtime(), slowest;
+        for(int k = 0; k < count; k++) gemv_narrow(M, N, v, A + k * matrix, X + (long)k * N * v, Y + (long)k * M * v);
+        double mine = MPI_Wtime() - t0;
+        MPI_Allreduce(&mine, &slowest, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+        if(slowest < narrow) narrow = slowest;
+    }
+
+    // The same products through multiply() on ints, one matrix at a time to bound the memory
+    int (*Ai)[M][N] = malloc(sizeof(int[1][M][N])), (*Xi)[N][v] = malloc(sizeof(int[1][N][v]));
+    long wrong = 0;
+    for(int t = 0; t < 3; t++) {
+        double spent = 0, slowest;
+        for(int k = 0; k < count; k++) {
+            for(long i = 0; i < matrix; i++) Ai[0][i / N][i % N] = A[k * matrix + i];
+            for(long i = 0; i < (long)N * v; i++) Xi[0][i % N][i / N] = X[(long)k * N * v + i];
+            double t0 = MPI_Wtime();
+            multiply(1, M, N, v, Ai, Xi, (int (*)[M][v])(Yint + (long)k * M * v));
+            spent += MPI_Wtime() - t0;
+        }
+        MPI_Allreduce(&spent, &slowest, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+        if(slowest < general) general = slowest;
+    }
+    for(long i = 0; i < (long)count * M * v; i++) wrong += Y[i] != Yint[i];
+    long allWrong;
+    MPI_Reduce(&wrong, &allWrong, 1, MPI_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+    free(Ai);
+    free(Xi);
+    free(Yint);
+
+    // Results to rank 0, as the other modes do
+    int counts[size], displs[size];
+    for(int r = 0; r < size; r++) {
+        counts[r] = (K * (r + 1) / size - K * r / size) * M * v * sizeof(int);
+        displs[r] = K * r / size * M * v * sizeof(int);
+    }
+    int *all = rank == 0 ? malloc((long)K * M * v * sizeof(int)) : NULL;
+    coll_gatherv(coll, Y, counts, all, displs, 0);
+    free(all);
+    free(A);
+    free(X);
+    free(Y);
+
+    double stream = stream_triad(size);
+    if(rank == 0) {
+        double bytes = (double)K * matrix, vectors = (double)K * (N + M) * v;  // Matrix bytes, vector elements
+        printf("GEMV: %d processes, %d matrices of %d x %d, %d vector(s) each\n", size, K, M, N, v);
+        printf("  STREAM triad              %8.2f GB/s\n", stream / 1e9);
+        printf("  general kernel (int)      %8.2f GB/s  %8.3f ms\n", (4 * bytes + 4 * vectors) / general / 1e9, general * 1e3);
+        printf("  byte kernel               %8.2f GB/s  %8.3f ms   %3.0f%% of STREAM, %.1fx faster\n",
+               (bytes + vectors) / narrow / 1e9, narrow * 1e3, 100 * (bytes + vectors) / narrow / stream, general / narrow);
+        printf(allWrong ? "  results differ in %ld elements\n" : "  results identical\n", allWrong);
+    }
+}
+
+// Process grids (--topo-grid). By default grid position p is played by rank p, so whether grid
+// neighbours share a node depends on how the launcher numbered the ranks. With --topo-grid the
+// grid is offered to the MPI library as a Cartesian topology and as a graph weighted by the
+// traffic along each dimension, both with reordering allowed. A placement of our own is built
+// from the node of every rank (MPI_Comm_split_type, in coll_open): node after node takes
+// consecutive positions in an order where the busiest dimension varies fastest. Whichever
+// keeps the most neighbour bytes on-node is used.
+#define GRID_MAX_DIMS 3
+
+// Coordinates of row-major grid position p
+void grid_coords(int ndims, const int dims[], int p, int coords[]) {
+    for(int d = ndims - 1; d >= 0; d--) {
+        coords[d] = p % dims[d];
+        p /= dims[d];
+    }
+}
+
+// Share of the neighbour traffic that stays on a node when position p is played by rank
+// rankAt[p]. Neighbours are positions one step apart along dimension d and exchange bytes[d].
+double grid_on_node(const coll_ctx *coll, int ndims, const int dims[], const double bytes[], const int rankAt[]) {
+    double all = 0, local = 0;
+    for(int p = 0; p < coll->size; p++) {
+        int coords[GRID_MAX_DIMS];
+        grid_coords(ndims, dims, p, coords);
+        for(int d = 0, stride = coll->size; d < ndims; d++) {
+            stride /= dims[d];
+            if(coords[d] + 1 == dims[d]) continue;
+            all += bytes[d];
+            if(coll->node_of[rankAt[p]] == coll->node_of[rankAt[p + stride]]) local += bytes[d];
+        }
+    }
+    return all > 0 ? local / all : 1;
+}
+
+// Chooses the rank that plays each position of a grid (at most GRID_MAX_DIMS dimensions) over
+// all processes of coll: posOf[r] is the position of rank r. Rank order unless `topo`; then the
+// placement above that keeps the most neighbour bytes on-node, if it beats rank order, and rank 0
+// reports the on-node share before and after.
+void grid_layout(coll_ctx *coll, int ndims, int dims[], const double bytes[], int topo, int posOf[]) {
+    int size = coll->size, rank = coll->rank, candidates[3][size], rankAt[size];
+    const char *names[3] = {"MPI_Cart_create", "MPI_Dist_graph_create_adjacent", "node blocks"};
+    for(int r = 0; r < size; r++) posOf[r] = r;
+    if(!topo) return;
+
+    // The library's Cartesian placement: a process's Cartesian rank is its position
+    int periods[GRID_MAX_DIMS] = {0}, mine;
+    MPI_Comm cart, graph;
+    MPI_Cart_create(coll->user, ndims, dims, periods, 1, &cart);
+    MPI_Comm_rank(cart, &mine);
+    MPI_Allgather(&mine, 1, MPI_INT, candidates[0], 1, MPI_INT, coll->user);
+    MPI_Comm_free(&cart);
+
+    // The library's placement of the weighted neighbour graph (weights relative to the busiest dimension)
+    int coords[GRID_MAX_DIMS], neighbours[2 * GRID_MAX_DIMS], weights[2 * GRID_MAX_DIMS], degree = 0;
+    double heaviest = 0;
+    for(int d = 0; d < ndims; d++) heaviest = bytes[d] > heaviest ? bytes[d] : heaviest;
+    grid_coords(ndims, dims, rank, coords);
+    for(int d = 0, stride = size; d < ndims; d++) {
+        stride /= dims[d];
+        int weight = heaviest > 0 ? 1 + (int)(1000 * bytes[d] / heaviest) : 1;
+        if(coords[d] > 0) {
+            neighbours[degree] = rank - stride;
+            weights[degree++] = weight;
+        }
+        if(coords[d] + 1 < dims[d]) {
+            neighbours[degree] = rank + stride;
+            weights[degree++] = weight;
+        }
+    }
+    MPI_Dist_graph_create_adjacent(coll->user, degree, neighbours, weights, degree, neighbours, weights, MPI_INFO_NULL, 1, &graph);
+    MPI_Comm_rank(graph, &mine);
+    MPI_Allgather(&mine, 1, MPI_INT, candidates[1], 1, MPI_INT, coll->user);
+    MPI_Comm_free(&graph);
+
+    // Node blocks: dimensions ordered by traffic, lightest outermost
+    int dimOrder[GRID_MAX_DIMS], k = 0;
+    for(int d = 0; d < ndims; d++) {
+        int at = d;
+        while(at > 0 && bytes[dimOrder[at - 1]] > bytes[d]) {
+            dimOrder[at] = dimOrder[at - 1];
+            at--;
+        }
+        dimOrder[at] = d;
+    }
+    for(int node = 0; node < coll->nodes; node++) {
+        for(int r = 0; r < size; r++) {
+            if(coll->node_of[r] != node) continue;
+            int rest = k++, p = 0;
+            for(int x = ndims - 1; x >= 0; x--) {
+                coords[dimOrder[x]] = rest % dims[dimOrder[x]];
+                rest /= dims[dimOrder[x]];
+            }
+            for(int d = 0; d < ndims; d++) p = p * dims[d] + coords[d];
+            candidates[2][r] = p;
+        }
+    }
+
+    // Rank order stays unless a placement is strictly better; every process computes the same choice
+    double before, best;
+    int chosen = -1;
+    for(int r = 0; r < size; r++) rankAt[r] = r;
+    before = best = grid_on_node(coll, ndims, dims, bytes, rankAt);
+    for(int c = 0; c < 3; c++) {
+        for(int r = 0; r < size; r++) rankAt[candidates[c][r]] = r;
+        double share = grid_on_node(coll, ndims, dims, bytes, rankAt);
+        if(share > best + 1e-9) {
+            best = share;
+            chosen = c;
+        }
+    }
+    if(chosen >= 0) memcpy(posOf, candidates[chosen], size * sizeof(int));
+    if(rank == 0) {
+        printf("Grid layout: %d node(s), %.0f%% of the neighbour bytes on-node in rank order, %.0f%% with %s\n",
+               coll->nodes, 100 * before, 100 * best, chosen < 0 ? "rank order" : names[chosen]);
+    }
+}
+
+// Linear systems over GF(p) (--solve). Elimination divides, so these work modulo a prime instead
+// of 100: 65521, the largest below 2^16, keeps every product of two elements below 2^32.
+#define GF_PRIME 65521
+#define GF_BLOCK 32           // Panel width of the blocked LU, and block size of the 2D layout
+#define GF_CYCLIC_N 768       // Order of the single system of --solve cyclic
+#define GF_SEED 123           // Stream of seeded_value() the systems are drawn from
+
+// a^-1 mod GF_PRIME by Fermat's little theorem (a != 0)
+unsigned gf_inverse(unsigned a) {
+    unsigned long r = 1, b = a;
+    for(unsigned e = GF_PRIME - 2; e; e >>= 1) {
+        if(e & 1) r = r * b % GF_PRIME;
+        b = b * b % GF_PRIME;
+    }
+    return r;
+}
+
+// C -= A * B (mod GF_PRIME) for an M x N by N x P product inside larger row-major arrays with
+// leading dimensions lda, ldb and ldc. Products are below 2^32, so the sums run in 64 bits and
+// every element is reduced once instead of once per term; the inner j loop vectorizes.
+void gf_gemm_sub(int M, int N, int P, const unsigned *A, int lda, const unsigned *B, int ldb, unsigned *C, int ldc) {
+    if(P <= 0) return;
+    unsigned long acc[P];
+    for(int i = 0; i < M; i++) {
+        for(int j = 0; j < P; j++) acc[j] = 0;
+        for(int l = 0; l < N; l++) {
+            unsigned long a = A[(long)i * lda + l];
+            const unsigned *b = B + (long)l * ldb;
+            for(int j = 0; j < P; j++) acc[j] += a * b[j];
+        }
+        unsigned *c = C + (long)i * ldc;
+        for(int j = 0; j < P; j++) c[j] = (c[j] + GF_PRIME - acc[j] % GF_PRIME) % GF_PRIME;
+    }
+}
+
+// B = L^-1 B for the unit lower triangle of an m x m block L and an m x P block B: row i only
+// needs the rows above it, so each row is one GEMM update by the finished ones
+void gf_trsm_lower(int m, int P, const unsigned *L, int ldl, unsigned *B, int ldb) {
+    for(int i = 1; i < m; i++) gf_gemm_sub(1, i, P, L + (long)i * ldl, ldl, B, ldb, B + (long)i * ldb, ldb);
+}
+
+// Blocked right-looking LU of an n x n matrix in place: P A = L U with L unit lower triangular.
+// In a field every nonzero pivot is exact, so the first one found is taken; perm[j] is the row
+// swapped with row j at step j. Each panel of GF_BLOCK columns is eliminated column by column,
+// then U12 = L11^-1 A12 and the trailing matrix gets A22 -= L21 U12. Returns 0 if A is singular.
+int gf_lu(int n, unsigned *a, int *perm) {
+    for(int k0 = 0; k0 < n; k0 += GF_BLOCK) {
+        int k1 = k0 + GF_BLOCK < n ? k0 + GF_BLOCK : n;
+        for(int j = k0; j < k1; j++) {
+            int piv = j;
+            while(piv < n && a[(long)piv * n + j] == 0) piv++;
+            if(piv == n) return 0;
+            perm[j] = piv;
+            for(int c = 0; piv != j && c < n; c++) {
+                unsigned t = a[(long)j * n + c];
+                a[(long)j * n + c] = a[(long)piv * n + c];
+                a[(long)piv * n + c] = t;
+            }
+            unsigned long inv = gf_inverse(a[(long)j * n + j]);
+            for(int i = j + 1; i < n; i++) {
+                unsigned *row = a + (long)i * n;
+                unsigned long l = row[j] * inv % GF_PRIME;
+                row[j] = l;
+                for(int c = j + 1; c < k1; c++) row[c] = (row[c] + GF_PRIME - l * a[(long)j * n + c] % GF_PRIME) % GF_PRIME;
+            }
+        }
+        gf_trsm_lower(k1 - k0, n - k1, a + (long)k0 * n + k0, n, a + (long)k0 * n + k1, n);
+        gf_gemm_sub(n - k1, k1 - k0, n - k1, a + (long)k1 * n + k0, n, a + (long)k0 * n + k1, n, a + (long)k1 * n + k1, n);
+    }
+    return 1;
+}
+
+// Solves A X = B for the n x nrhs matrix B with the factors of gf_lu; B is overwritten by X
+void gf_lu_solve(int n, const unsigned *lu, const int *perm, int nrhs, unsigned *b) {
+    for(int i = 0; i < n; i++) {
+        for(int c = 0; perm[i] != i && c < nrhs; c++) {
+            unsigned t = b[(long)i * nrhs + c];
+            b[(long)i * nrhs + c] = b[(long)perm[i] * nrhs + c];
+            b[(long)perm[i] * nrhs + c] = t;
+        }
+    }
+    gf_trsm_lower(n, nrhs, lu, n, b, nrhs);  // L Y = P B
+    for(int i = n - 1; i >= 0; i--) {        // U X = Y, bottom row first
+        gf_gemm_sub(1, n - 1 - i, nrhs, lu + (long)i * n + i + 1, n, b + (long)(i + 1) * nrhs, nrhs, b + (long)i * nrhs, nrhs);
+        unsigned long inv = gf_inverse(lu[(long)i * n + i]);
+        for(int c = 0; c < nrhs; c++) b[(long)i * nrhs + c] = b[(long)i * nrhs + c] * inv % GF_PRIME;
+    }
+}
+
+// Counts the nonzero elements of B - A X for an n x n matrix A and n x P matrices X and B
+long gf_residual(int n, int P, const unsigned *A, int lda, const unsigned *X, const unsigned *B) {
+    unsigned *r = malloc((long)n * P * sizeof(unsigned));
+    long wrong = 0;
+    memcpy(r, B, (long)n * P * sizeof(unsigned));
+    gf_gemm_sub(n, n, P, A, lda, X, P, r, P);
+    for(long i = 0; i < (long)n * P; i++) wrong += r[i] != 0;
+    free(r);
+    return wrong;
+}
+
+// Batch mode: K independent n x n systems A x = b, split over the processes like the matrix
+// products. Every process draws, factors, solves and inverts its own systems and checks
+// A x = b and A A^-1 = I; the solutions are gathered on rank 0.
+void gf_solve_batch(coll_ctx *coll, int K, int n, int rank, int size) {
+    int first = K * rank / size, count = K * (rank + 1) / size - first, perm[n];
+    unsigned *a = malloc((long)n * n * sizeof(unsigned)), *lu = malloc((long)n * n * sizeof(unsigned));
+    unsigned *inv = malloc((long)n * n * sizeof(unsigned)), *id = calloc((long)n * n, sizeof(unsigned));
+    unsigned *b = malloc(n * sizeof(unsigned)), *x = calloc((long)count * n + 1, sizeof(unsigned));
+    for(int i = 0; i < n; i++) id[(long)i * n + i] = 1;
+    long singular = 0, wrong = 0;
+    double spent = 0, slowest;
+    for(int k = 0; k < count; k++) {
+        long seed = GF_SEED + first + k;
+        for(long i = 0; i < (long)n * n; i++) a[i] = seeded_value(seed, i, GF_PRIME);
+        for(int i = 0; i < n; i++) b[i] = seeded_value(-seed, i, GF_PRIME);
+        memcpy(lu, a, (long)n * n * sizeof(unsigned));
+        memcpy(inv, id, (long)n * n * sizeof(unsigned));
+        unsigned *xk = x + (long)k * n;
+        memcpy(xk, b, n * sizeof(unsigned));
+        double t0 = MPI_Wtime();
+        int regular = gf_lu(n, lu, perm);
+        if(regular) {
+            gf_lu_solve(n, lu, perm, 1, xk);
+            gf_lu_solve(n, lu, perm, n, inv);
+        }
+        spent += MPI_Wtime() - t0;
+        if(!regular) {
+            singular++;
+            memset(xk, 0, n * sizeof(unsigned));
+            continue;
+        }
+        wrong += gf_residual(n, 1, a, n, xk, b) + gf_residual(n, n, a, n, inv, id);
+    }
+    MPI_Allreduce(&spent, &slowest, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+    MPI_Allreduce(MPI_IN_PLACE, &singular, 1, MPI_LONG, MPI_SUM, MPI_COMM_WORLD);
+    MPI_Allreduce(MPI_IN_PLACE, &wrong, 1, MPI_LONG, MPI_SUM, MPI_COMM_WORLD);
+
+    // Solutions to rank 0, as the products are (byte counts)
+    int counts[size], displs[size];
+    for(int r = 0; r < size; r++) {
+        counts[r] = (K * (r + 1) / size - K * r / size) * n * sizeof(unsigned);
+        displs[r] = K * r / size * n * sizeof(unsigned);
+    }
+    unsigned *all = rank == 0 ? malloc((long)K * n * sizeof(unsigned)) : NULL;
+    coll_gatherv(coll, x, counts, all, displs, 0);
+    if(rank == 0) {
+        printf("GF(%d) batch: %d systems of order %d on %d processes, %.3f ms (slowest process)\n",
+               GF_PRIME, K, n, size, slowest * 1e3);
+        printf("  solved and inverted %ld, singular %ld; %s\n", K - singular, singular,
+               wrong ? "CHECK FAILED" : "A x = b and A A^-1 = I hold for all of them");
+        if(wrong) printf("  %ld wrong elements\n", wrong);
+    }
+    free(all);
+    free(a);
+    free(lu);
+    free(inv);
+    free(id);
+    free(b);
+    free(x);
+}
+
+// 2D block-cyclic layout: GF_BLOCK x GF_BLOCK blocks dealt round-robin over a grid of processes.
+// Along one dimension with `procs` grid positions, global index g lives at position
+// cyclic_owner(g) under local index cyclic_local(g); local indices keep the global order.
+int cyclic_owner(int g, int procs) {
+    return g / GF_BLOCK % procs;
+}
+
+int cyclic_local(int g, int procs) {
+    return g / GF_BLOCK / procs * GF_BLOCK + g % GF_BLOCK;
+}
+
+int cyclic_global(int l, int procs, int p) {
+    return (l / GF_BLOCK * procs + p) * GF_BLOCK + l % GF_BLOCK;
+}
+
+// Number of the global indices below n held by position p (so also the first local index >= n)
+int cyclic_count(int n, int procs, int p) {
+    int count = 0;
+    for(int b = p; b * GF_BLOCK < n; b += procs) count += n - b * GF_BLOCK < GF_BLOCK ? n - b * GF_BLOCK : GF_BLOCK;
+    return count;
+}
+
+// Swaps global rows j and g across the whole local matrix; the grid rows holding them trade
+// their pieces within each grid column
+void cyclic_swap_rows(unsigned *a, int lc, int j, int g, int pr, int myr, MPI_Comm colComm) {
+    int rj = cyclic_owner(j, pr), rg = cyclic_owner(g, pr);
+    if(j == g || (myr != rj && myr != rg)) return;
+    if(rj == rg) {
+        unsigned *x = a + (long)cyclic_local(j, pr) * lc, *y = a + (long)cyclic_local(g, pr) * lc;
+        for(int c = 0; c < lc; c++) {
+            unsigned t = x[c];
+            x[c] = y[c];
+            y[c] = t;
+        }
+        return;
+    }
+    unsigned *row = a + (long)cyclic_local(myr == rj ? j : g, pr) * lc;
+    int other = myr == rj ? rg : rj;
+    MPI_Sendrecv_replace(row, lc, MPI_UNSIGNED, other, 0, other, 0, colComm, MPI_STATUS_IGNORE);
+}
+
+// Cyclic mode: one n x n system on a 2D process grid, the ScaLAPACK way. The augmented matrix
+// [A | b] is stored block-cyclically. For each panel the owning grid column picks pivots and
+// eliminates it, the panel goes along the grid rows, the owning grid row computes U12 and
+// sends it down the grid columns, and every process updates its part of the trailing matrix
+// with the modular GEMM. Rank 0 collects [U | c] and back-substitutes.
+void gf_solve_cyclic(coll_ctx *coll, int n, int topo, int rank, int size) {
+    int dims[2] = {0, 0}, posOf[size];
+    MPI_Dims_create(size, 2, dims);
+    // Per neighbour pair: U12 rows travel down the grid columns, L panels along the grid rows
+    double bytes[2] = {2.0 * n * n / dims[1], 2.0 * n * n / dims[0]};
+    grid_layout(coll, 2, dims, bytes, topo, posOf);
+    int pr = dims[0], pc = dims[1], myr = posOf[rank] / pc, myc = posOf[rank] % pc, cols = n + 1;
+    MPI_Comm rowComm, colComm;  // My grid row ranked by grid column, my grid column ranked by grid row
+    MPI_Comm_split(MPI_COMM_WORLD, myr, myc, &rowComm);
+    MPI_Comm_split(MPI_COMM_WORLD, myc, myr, &colComm);
+    int lr = cyclic_count(n, pr, myr), lc = cyclic_count(cols, pc, myc);
+    unsigned *a = malloc((long)lr * lc * sizeof(unsigned) + 1);
+    unsigned *L = malloc((long)lr * GF_BLOCK * sizeof(unsigned) + 1), *U = malloc((long)GF_BLOCK * lc * sizeof(unsigned) + 1);
+    unsigned pivot[GF_BLOCK];
+    for(int i = 0; i < lr; i++) {
+        for(int j = 0; j < lc; j++) {
+            a[(long)i * lc + j] = seeded_value(GF_SEED, (long)cyclic_global(i, pr, myr) * cols + cyclic_global(j, pc, myc), GF_PRIME);
+        }
+    }
+
+    int singular = 0;
+    MPI_Barrier(MPI_COMM_WORLD);
+    double t0 = MPI_Wtime();
+    for(int k0 = 0; k0 < n && !singular; k0 += GF_BLOCK) {
+        int k1 = k0 + GF_BLOCK < n ? k0 + GF_BLOCK : n, nb = k1 - k0;
+        int kr = cyclic_owner(k0, pr), kc = cyclic_owner(k0, pc);
+        int r0 = cyclic_count(k0, pr, myr), r1 = cyclic_count(k1, pr, myr), c0 = cyclic_count(k0, pc, myc), c1 = cyclic_count(k1, pc, myc);
+
+        // Panel, one column at a time: the first nonzero at or below the diagonal is the pivot
+        for(int j = k0; j < k1; j++) {
+            int piv = INT_MAX;
+            if(myc == kc) {
+                int jc = c0 + j - k0;
+                for(int i = cyclic_count(j, pr, myr); i < lr; i++) {
+                    if(a[(long)i * lc + jc] != 0) {
+                        piv = cyclic_global(i, pr, myr);
+                        break;
+                    }
+                }
+                MPI_Allreduce(MPI_IN_PLACE, &piv, 1, MPI_INT, MPI_MIN, colComm);
+            }
+            MPI_Bcast(&piv, 1, MPI_INT, kc, rowComm);
+            if(piv == INT_MAX) {
+                singular = 1;
+                break;
+            }
+            cyclic_swap_rows(a, lc, j, piv, pr, myr, colComm);
+            if(myc == kc) {
+                int jr = cyclic_owner(j, pr);
+                if(myr == jr) memcpy(pivot, a + (long)cyclic_local(j, pr) * lc + c0, nb * sizeof(unsigned));
+                MPI_Bcast(pivot, nb, MPI_UNSIGNED, jr, colComm);
+                unsigned long inv = gf_inverse(pivot[j - k0]);
+                for(int i = cyclic_count(j + 1, pr, myr); i < lr; i++) {
+                    unsigned *row = a + (long)i * lc + c0;
+                    unsigned long l = row[j - k0] * inv % GF_PRIME;
+                    row[j - k0] = l;
+                    for(int c = j - k0 + 1; c < nb; c++) row[c] = (row[c] + GF_PRIME - l * pivot[c] % GF_PRIME) % GF_PRIME;
+                }
+            }
+        }
+        if(singular) break;
+
+        // L11 and L21 along the grid rows
+        if(myc == kc) {
+            for(int i = r0; i < lr; i++) memcpy(L + (long)(i - r0) * nb, a + (long)i * lc + c0, nb * sizeof(unsigned));
+        }
+        MPI_Bcast(L, (lr - r0) * nb, MPI_UNSIGNED, kc, rowComm);
+
+        // U12 = L11^-1 A12 in the grid row of the panel, then down the grid columns
+        if(myr == kr) {
+            gf_trsm_lower(nb, lc - c1, L, nb, a + (long)r0 * lc + c1, lc);
+            for(int t = 0; t < nb; t++) memcpy(U + (long)t * (lc - c1), a + (long)(r0 + t) * lc + c1, (lc - c1) * sizeof(unsigned));
+        }
+        MPI_Bcast(U, nb * (lc - c1), MPI_UNSIGNED, kr, colComm);
+
+        // Trailing update A22 -= L21 U12 on every process
+        gf_gemm_sub(lr - r1, nb, lc - c1, L + (long)(r1 - r0) * nb, nb, U, lc - c1, a + (long)r1 * lc + c1, lc);
+    }
+    double mine = MPI_Wtime() - t0, slowest;
+    MPI_Allreduce(&mine, &slowest, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+
+    // [U | c] to rank 0 (each process's local matrix in turn, byte counts)
+    int counts[size], displs[size];
+    for(int r = 0, at = 0; r < size; r++) {
+        counts[r] = cyclic_count(n, pr, posOf[r] / pc) * cyclic_count(cols, pc, posOf[r] % pc) * sizeof(unsigned);
+        displs[r] = at;
+        at += counts[r];
+    }
+    unsigned *parts = rank == 0 ? malloc((long)n * cols * sizeof(unsigned)) : NULL;
+    coll_gatherv(coll, a, counts, parts, displs, 0);
+    if(rank == 0 && singular) printf("GF(%d) cyclic: the system of order %d is singular\n", GF_PRIME, n);
+    if(rank == 0 && !singular) {
+        unsigned *full = malloc((long)n * cols * sizeof(unsigned)), *x = malloc(n * sizeof(unsigned));
+        for(int r = 0; r < size; r++) {
+            unsigned *part = parts + displs[r] / sizeof(unsigned);
+            int gr = posOf[r] / pc, gc = posOf[r] % pc, rr = cyclic_count(n, pr, gr), rc = cyclic_count(cols, pc, gc);
+            for(int i = 0; i < rr; i++) {
+                for(int j = 0; j < rc; j++) {
+                    full[(long)cyclic_global(i, pr, gr) * cols + cyclic_global(j, pc, gc)] = part[(long)i * rc + j];
+                }
+            }
+        }
+        for(int i = n - 1; i >= 0; i--) {  // U x = c
+            x[i] = full[(long)i * cols + n];
+            gf_gemm_sub(1, n - 1 - i, 1, full + (long)i * cols + i + 1, cols, x + i + 1, 1, x + i, 1);
+            x[i] = (unsigned long)x[i] * gf_inverse(full[(long)i * cols + i]) % GF_PRIME;
+        }
+        // Check against the original system, drawn again
+        unsigned *b = malloc(n * sizeof(unsigned));
+        for(long i = 0; i < (long)n * cols; i++) full[i] = seeded_value(GF_SEED, i, GF_PRIME);
+        for(int i = 0; i < n; i++) b[i] = full[(long)i * cols + n];
+        long wrong = gf_residual(n, 1, full, cols, x, b);
+        printf("GF(%d) cyclic: one system of order %d on a %d x %d grid, blocks of %d\n", GF_PRIME, n, pr, pc, GF_BLOCK);
+        printf("  factorization %.3f ms (slowest process), %.2f G multiply-adds/s; %s\n", slowest * 1e3,
+               (double)n * n * n / 3 / slowest / 1e9, wrong ? "A x = b FAILED" : "A x = b holds");
+        free(b);
+        free(full);
+        free(x);
+    }
+    free(parts);
+    free(a);
+    free(L);
+    free(U);
+    MPI_Comm_free(&rowComm);
+    MPI_Comm_free(&colComm);
+}
+
+// 2.5D multiplication (--2.5d <c>): one large N25D x N25D product on a q x q x c process grid.
+// Layer 0 draws A and B in q x q blocks and replicates them to the c layers; layer l then runs
+// its share of the q SUMMA steps (block column t of A times block row t of B, broadcast along
+// the grid rows and columns), and the c partial products are summed with MPI_Reduce_scatter,
+// which leaves each layer a slice of rows. In the SUMMA steps every process moves 2 N^2 / sqrt(c P)
+// words instead of the 2 N^2 / sqrt(P) of plain SUMMA (c = 1), at c times the memory; replicating
+// and reducing add about 3 c N^2 / P, so the trade pays off on large process counts. Returns 1
+// when the processes do not form such a grid, 0 otherwise.
+#define N25D 768
+
+int multiply_25d(coll_ctx *coll, int c, int verify, int topo, int rank, int size) {
+    int q = 0;
+    while((q + 1) * (q + 1) * c <= size) q++;
+    if(q * q * c != size || c > q || N25D % q != 0) {
+        if(rank == 0) printf("2.5D needs q x q x c processes with c <= q and q dividing %d; %d processes, c = %d do not fit\n", N25D, size, c);
+        return 1;
+    }
+    int n = N25D, b = n / q, dims[3] = {c, q, q}, posOf[size];
+    // Per neighbour pair: replication and reduction across layers, the SUMMA steps within one
+    double block = 4.0 * b * b, bytes[3] = {c > 1 ? 2 * block + block * (c - 1) / c : 0, block * q / c, block * q / c};
+    grid_layout(coll, 3, dims, bytes, topo, posOf);
+    int me = posOf[rank], layer = me / (q * q), i = me % (q * q) / q, j = me % q;
+    MPI_Comm rowComm, colComm, depthComm;  // Ranked by j, by i and by layer
+    MPI_Comm_split(MPI_COMM_WORLD, layer * q + i, j, &rowComm);
+    MPI_Comm_split(MPI_COMM_WORLD, layer * q + j, i, &colComm);
+    MPI_Comm_split(MPI_COMM_WORLD, i * q + j, layer, &depthComm);
+    int (*A)[b][b] = malloc(sizeof(int[1][b][b])), (*B)[b][b] = malloc(sizeof(int[1][b][b]));
+    int (*At)[b][b] = malloc(sizeof(int[1][b][b])), (*Bt)[b][b] = malloc(sizeof(int[1][b][b]));
+    int (*T)[b][b] = malloc(sizeof(int[1][b][b])), (*C)[b][b] = calloc(1, sizeof(int[1][b][b]));
+    if(layer == 0) {
+        for(int r = 0; r < b; r++) {
+            for(int s = 0; s < b; s++) {
+                A[0][r][s] = seeded_value(1, (long)(i * b + r) * n + j * b + s, 100);
+                B[0][r][s] = seeded_value(2, (long)(i * b + r) * n + j * b + s, 100);
+            }
+        }
+    }
+    double phase[3], t0;
+
+    // Replicate A and B to every layer
+    MPI_Barrier(MPI_COMM_WORLD);
+    t0 = MPI_Wtime();
+    MPI_Bcast(A, b * b, MPI_INT, 0, depthComm);
+    MPI_Bcast(B, b * b, MPI_INT, 0, depthComm);
+    phase[0] = MPI_Wtime() - t0;
+
+    // This layer's SUMMA steps
+    t0 = MPI_Wtime();
+    for(int t = q * layer / c; t < q * (layer + 1) / c; t++) {
+        if(j == t) memcpy(At, A, sizeof(int[b][b]));
+        if(i == t) memcpy(Bt, B, sizeof(int[b][b]));
+        MPI_Bcast(At, b * b, MPI_INT, t, rowComm);
+        MPI_Bcast(Bt, b * b, MPI_INT, t, colComm);
+        multiply(1, b, b, b, At, Bt, T);
+        for(int r = 0; r < b; r++) {
+            for(int s = 0; s < b; s++) C[0][r][s] = (C[0][r][s] + T[0][r][s]) % 100;
+        }
+    }
+    phase[1] = MPI_Wtime() - t0;
+
+    // Sum the layers' partial products; layer l keeps rows b*l/c .. b*(l+1)/c of the block
+    int counts[c], first = b * layer / c, rows = b * (layer + 1) / c - first;
+    for(int l = 0; l < c; l++) counts[l] = (b * (l + 1) / c - b * l / c) * b;
+    int *slice = malloc(rows * b * sizeof(int) + 1);
+    t0 = MPI_Wtime();
+    MPI_Reduce_scatter(C, slice, counts, MPI_INT, MPI_SUM, depthComm);
+    for(int e = 0; e < rows * b; e++) slice[e] %= 100;
+    phase[2] = MPI_Wtime() - t0;
+    MPI_Allreduce(MPI_IN_PLACE, phase, 3, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+
+    // Result slices to rank 0 (byte counts), placed by their block and rows
+    int sizes[size], displs[size];
+    for(int r = 0, at = 0; r < size; r++) {
+        int l = posOf[r] / (q * q);
+        sizes[r] = (b * (l + 1) / c - b * l / c) * b * sizeof(int);
+        displs[r] = at;
+        at += sizes[r];
+    }
+    int *parts = rank == 0 ? malloc((long)n * n * sizeof(int)) : NULL;
+    coll_gatherv(coll, slice, sizes, parts, displs, 0);
+    if(rank == 0) {
+        printf("2.5D multiply: %d x %d on a %d x %d x %d grid (%d processes)\n", n, n, q, q, c, size);
+        printf("  replicate %9.3f ms   SUMMA steps %9.3f ms   reduce-scatter %9.3f ms\n", phase[0] * 1e3, phase[1] * 1e3, phase[2] * 1e3);
+        double words = (double)b * b, steps = 2.0 * q / c * words, extra = c > 1 ? 2 * words + words * (c - 1) / c : 0;
+        printf("  words per process: %.0f in the SUMMA steps (%.2fx plain SUMMA's 2 N^2 / sqrt(P)), %.0f to replicate and reduce\n",
+               steps, steps / (2.0 * n * n / sqrt(size)), extra);
+    }
+    if(rank == 0 && verify) {
+        int (*full)[n][n] = malloc(sizeof(int[1][n][n])), (*fa)[n][n] = malloc(sizeof(int[1][n][n]));
+        int (*fb)[n][n] = malloc(sizeof(int[1][n][n])), (*fr)[n][n] = malloc(sizeof(int[1][n][n]));
+        for(int r = 0; r < size; r++) {
+            int l = posOf[r] / (q * q), bi = posOf[r] % (q * q) / q, bj = posOf[r] % q, lo = b * l / c, hi = b * (l + 1) / c;
+            int *part = parts + displs[r] / sizeof(int);
+            for(int x = lo; x < hi; x++) memcpy(&full[0][bi * b + x][bj * b], part + (x - lo) * b, b * sizeof(int));
+        }
+        for(long e = 0; e < (long)n * n; e++) {
+            fa[0][e / n][e % n] = seeded_value(1, e, 100);
+            fb[0][e / n][e % n] = seeded_value(2, e, 100);
+        }
+        multiply(1, n, n, n, fa, fb, fr);
+        long wrong = 0;
+        for(long e = 0; e < (long)n * n; e++) wrong += full[0][e / n][e % n] != fr[0][e / n][e % n];
+        printf(wrong ? "Verify: %ld elements differ from the plain kernel\n" : "Verify: R matches the plain kernel\n", wrong);
+        free(full);
+        free(fa);
+        free(fb);
+        free(fr);
+    }
+    free(parts);
+    free(slice);
+    free(A);
+    free(B);
+    free(At);
+    free(Bt);
+    free(T);
+    free(C);
+    MPI_Comm_free(&rowComm);
+    MPI_Comm_free(&colComm);
+    MPI_Comm_free(&depthComm);
+    return 0;
+}
+
 int main(int argc, char **argv) {
-    MPI_Init(&argc, &argv);  // Initialize the MPI environment
+    // Command line flags
+    int useProgress = 0, overlapBench = 0;
+    const char *tuneFile = NULL, *solveMode = NULL;
+    const char *structureArg = NULL;
+    int structure = FULL, verify = 0, gemvVectors = 0, layers = 0, topoGrid = 0, simNodes = 0;
+
+    // Matrix dimensions
+    int K = 100, M = 50, N = 50, P = 50;
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "--progress-thread") == 0) useProgress = 1;
+        else if(strcmp(argv[i], "--overlap-bench") == 0) overlapBench = 1;
+        else if(strcmp(argv[i], "--coll-tune") == 0 && i + 1 < argc) tuneFile = argv[++i];
+        else if(strcmp(argv[i], "--verify") == 0) verify = 1;
+        else if(strcmp(argv[i], "--gemv") == 0 && i + 1 < argc) gemvVectors = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--solve") == 0 && i + 1 < argc) solveMode = argv[++i];
+        else if(strcmp(argv[i], "--2.5d") == 0 && i + 1 < argc) layers = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--topo-grid") == 0) topoGrid = 1;
+        else if(strcmp(argv[i], "--simulate-nodes") == 0 && i + 1 < argc) simNodes = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--dims") == 0 && i + 4 < argc) {
+            K = atoi(argv[i + 1]);
+            M = atoi(argv[i + 2]);
+            N = atoi(argv[i + 3]);
+            P = atoi(argv[i + 4]);
+            i += 4;
+        }
+        else if(strcmp(argv[i], "--structure") == 0 && i + 1 < argc) {
+            structureArg = argv[++i];
+            structure = -1;  // Until the name is recognised
+            for(int s = FULL; s <= UPPER; s++) {
+                if(strcmp(structureArg, structureNames[s]) == 0) structure = s;
+            }
+        }
+    }
+
+    // Initialize the MPI environment, with full thread support when a progress thread may run
+    int provided = MPI_THREAD_SINGLE;
+    if(useProgress || overlapBench) {
+        MPI_Init_thread(&argc, &argv, MPI_THREAD_MULTIPLE, &provided);
+    } else {
+        MPI_Init(&argc, &argv);
+    }
+    int threads = provided == MPI_THREAD_MULTIPLE;
 
     int rank, size;
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);  // Get the process ID
     MPI_Comm_size(MPI_COMM_WORLD, &size);  // Get the total number of processes
+    if(structure < 0) {
+        if(rank == 0) printf("Unknown structure %s (full, symmetric, lower or upper)\n", structureArg);
+        MPI_Finalize();
+        return 1;
+    }
+    if(K < 1 || M < 1 || N < 1 || P < 1) {
+        if(rank == 0) printf("Matrix dimensions must be positive.\n");
+        MPI_Finalize();
+        return 1;
+    }
+    if(simNodes < 0 || simNodes > size) {
+        if(rank == 0) printf("--simulate-nodes needs 1 to %d nodes.\n", size);
+        MPI_Finalize();
+        return 1;
+    }
 
-    // Matrix dimensions
-    int K = 100, M = 50, N = 50, P = 50;
+    // Tuned scatter/gather algorithms (the MPI library's own ones without a tuning file)
+    coll_ctx coll;
+    coll_open(&coll, MPI_COMM_WORLD, tuneFile, rank == 0);
+    if(simNodes > 0) coll_simulate_nodes(&coll, simNodes);
 
     // Broadcasting the matrix dimensions to all processes
     MPI_Bcast(&K, 1, MPI_INT, 0, MPI_COMM_WORLD);
@@ -37,13 +1091,62 @@ int main(int argc, char **argv) {
     MPI_Bcast(&N, 1, MPI_INT, 0, MPI_COMM_WORLD);
     MPI_Bcast(&P, 1, MPI_INT, 0, MPI_COMM_WORLD);
 
-    // Ensure the number of matrices is divisible by the number of processes
-    if(K % size != 0) {
+    // Batched GEMV benchmark: its own data, generated where it is used
+    if(gemvVectors > 0) {
+        gemv_benchmark(&coll, K, gemvVectors, rank, size);
+        coll_close(&coll);
+        MPI_Finalize();
+        return 0;
+    }
+
+    // One large product, communication traded for memory
+    if(layers > 0) {
+        int status = multiply_25d(&coll, layers, verify, topoGrid, rank, size);
+        coll_close(&coll);
+        MPI_Finalize();
+        return status;
+    }
+
+    // Linear systems over GF(p): many small ones, or one large one on a 2D process grid
+    if(solveMode) {
+        if(strcmp(solveMode, "batch") == 0) {
+            gf_solve_batch(&coll, K, M, rank, size);
+        } else if(strcmp(solveMode, "cyclic") == 0) {
+            gf_solve_cyclic(&coll, GF_CYCLIC_N, topoGrid, rank, size);
+        } else {
+            if(rank == 0) printf("Unknown solve mode %s (batch or cyclic)\n", solveMode);
+            coll_close(&coll);
+            MPI_Finalize();
+            return 1;
+        }
+        coll_close(&coll);
+        MPI_Finalize();
+        return 0;
+    }
+
+    // Structured products: R = A * A^T is M x M; triangular operands are square
+    if(structure == SYMMETRIC) P = M;
+    if((structure == LOWER || structure == UPPER) && M != N) {
+        if(rank == 0) printf("Triangular operands must be square.\n");
+        coll_close(&coll);
+        MPI_Finalize();
+        return 1;
+    }
+
+    // Ensure the number of matrices is divisible by the number of processes (the structured path
+    // splits rows instead)
+    if(structure == FULL && K % size != 0) {
         printf("Number of matrices must be divisible by the number of processes.\n");
+        coll_close(&coll);
         MPI_Finalize();
         return 1;
     }
 
+    if(useProgress && !threads) {
+        if(rank == 0) printf("The MPI library does not provide MPI_THREAD_MULTIPLE; running without a progress thread.\n");
+        useProgress = 0;
+    }
+
     // Declare matrices: A (K x M x N), B (K x N x P), and result R (K x M x P)
     int A[K][M][N], B[K][N][P], R[K][M][P];
 
@@ -65,36 +1168,125 @@ int main(int argc, char **argv) {
                 }
             }
         }
+        // Structured inputs: zero the unused half of a triangular A; for A * A^T, B is A^T
+        for(int k = 0; k < K; k++) {
+            for(int i = 0; i < M; i++) {
+                for(int j = 0; j < N; j++) {
+                    if((structure == LOWER && j > i) || (structure == UPPER && j < i)) A[k][i][j] = 0;
+                    if(structure == SYMMETRIC) B[k][j][i] = A[k][i][j];
+                }
+            }
+        }
     }
 
     // Buffers to store portions of the matrices that each process will work on
     int localA[K / size][M][N], localB[K / size][N][P], localR[K / size][M][P];
-    
-    // Scatter matrices A and B to all processes
-    MPI_Scatter(A, (K / size) * M * N, MPI_INT, localA, (K / size) * M * N, MPI_INT, 0, MPI_COMM_WORLD);
-    MPI_Scatter(B, (K / size) * N * P, MPI_INT, localB, (K / size) * N * P, MPI_INT, 0, MPI_COMM_WORLD);
-
-    // Start the timer for performance measurement
-    double startTime = MPI_Wtime();
+    int per = K / size;  // Matrices handled by each process
 
-    // Perform matrix multiplication (local computation for each process)
-    for(int k = 0; k < (K / size); k++) {  // Each process handles a portion of K matrices
-        for(int i = 0; i < M; i++) {         // Iterate over rows of matrix A
-            for(int j = 0; j < P; j++) {     // Iterate over columns of matrix B
-                localR[k][i][j] = 0;  // Initialize the result element to 0
-                for(int l = 0; l < N; l++) {  // Perform dot product for multiplication
-                    localR[k][i][j] += (localA[k][i][l] * localB[k][l][j]) % 100;  // Modulo 100
+    // Overlap benchmark: transfers alone, multiplication alone, and the staged pipeline without and
+    // with the progress thread. Each case is the best of a few trials of the slowest rank.
+    if(overlapBench) {
+        const char *names[4] = {"scatter + gather alone", "multiply alone", "pipelined", "pipelined, progress thread"};
+        double best[4] = {1e30, 1e30, 1e30, 1e30};
+        for(int c = 0; c < (threads ? 4 : 3); c++) {
+            if(c == 3) start_progress();
+            for(int t = 0; t < 5; t++) {
+                MPI_Barrier(MPI_COMM_WORLD);
+                double t0 = MPI_Wtime();
+                if(c == 1) {
+                    multiply(per, M, N, P, localA, localB, localR);
+                } else {
+                    pipelined_multiply(K, M, N, P, A, B, R, per, localA, localB, localR, size, c != 0);
                 }
-                localR[k][i][j] %= 100;  // Take modulo 100 for the final result
+                double mine = MPI_Wtime() - t0, slowest;
+                MPI_Allreduce(&mine, &slowest, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+                if(slowest < best[c]) best[c] = slowest;
             }
+            if(c == 3) stop_progress();
         }
+        if(rank == 0) {
+            printf("Overlap benchmark: %d processes, %d matrix pairs, %d stages, best of 5 trials\n", size, K, STAGES);
+            for(int c = 0; c < (threads ? 4 : 3); c++) {
+                printf("  %-28s %9.3f ms", names[c], best[c] * 1e3);
+                if(c >= 2) {  // Share of the shorter phase that disappeared when both ran together
+                    double hidden = (best[0] + best[1] - best[c]) / (best[0] < best[1] ? best[0] : best[1]);
+                    printf("   overlap %3.0f%%", 100 * (hidden < 0 ? 0 : hidden > 1 ? 1 : hidden));
+                }
+                printf("\n");
+            }
+            if(!threads) printf("  (the MPI library does not provide MPI_THREAD_MULTIPLE; no progress thread)\n");
+        }
+        coll_close(&coll);
+        MPI_Finalize();
+        return 0;
     }
 
-    // End the timer for performance measurement
-    double endTime = MPI_Wtime();
+    double startTime, endTime;
+    if(structure != FULL) {
+        // Balanced rows, structural zeros skipped; the time covers the local computation
+        startTime = 0;
+        endTime = structured_multiply(&coll, structure, K, M, N, P, A, B, R, rank, size);
+        if(rank == 0) {
+            long work = 0, heaviest = 0;
+            for(int r = 0; r < size; r++) {
+                int first, last;
+                long mine = 0;
+                balanced_rows(structure, K, M, N, P, size, r, &first, &last);
+                for(int g = first; g < last; g++) mine += row_cost(structure, g % M, M, N, P);
+                work += mine;
+                if(mine > heaviest) heaviest = mine;
+            }
+            printf("Structure %s: %ld of %ld multiply-adds (%.0f%%), busiest process %.2fx the average\n",
+                   structureNames[structure], work, (long)K * M * N * P, 100.0 * work / ((long)K * M * N * P),
+                   (double)heaviest * size / work);
+        }
+    } else if(useProgress) {
+        // Staged scatter/multiply/gather, kept moving by the progress thread; the time covers all of it
+        start_progress();
+        startTime = MPI_Wtime();
+        pipelined_multiply(K, M, N, P, A, B, R, per, localA, localB, localR, size, 1);
+        endTime = MPI_Wtime();
+        stop_progress();
+    } else {
+        // Scatter matrices A and B to all processes (byte counts, as the tuned collectives take them)
+        int countsA[size], countsB[size], countsR[size], displsA[size], displsB[size], displsR[size];
+        for(int r = 0; r < size; r++) {
+            countsA[r] = per * M * N * sizeof(int);
+            countsB[r] = per * N * P * sizeof(int);
+            countsR[r] = per * M * P * sizeof(int);
+            displsA[r] = r * countsA[r];
+            displsB[r] = r * countsB[r];
+            displsR[r] = r * countsR[r];
+        }
+        coll_scatterv(&coll, A, countsA, displsA, localA, 0);
+        coll_scatterv(&coll, B, countsB, displsB, localB, 0);
+
+        // Start the timer for performance measurement
+        startTime = MPI_Wtime();
+
+        // Perform matrix multiplication (local computation for each process)
+        multiply(per, M, N, P, localA, localB, localR);
 
-    // Gather the result matrices from all processes to the root process
-    MPI_Gather(localR, (K / size) * M * P, MPI_INT, R, (K / size) * M * P, MPI_INT, 0, MPI_COMM_WORLD);
+        // End the timer for performance measurement
+        endTime = MPI_Wtime();
+
+        // Gather the result matrices from all processes to the root process
+        coll_gatherv(&coll, localR, countsR, R, displsR, 0);
+    }
+
+    // Check the result against the plain kernel
+    if(verify && rank == 0) {
+        int (*full)[M][P] = malloc(sizeof(int[K][M][P]));
+        long wrong = 0;
+        multiply(K, M, N, P, A, B, full);
+        for(int k = 0; k < K; k++) {
+            for(int i = 0; i < M; i++) {
+                for(int j = 0; j < P; j++) wrong += full[k][i][j] != R[k][i][j];
+            }
+        }
+        printf(wrong ? "Verify: %ld elements differ from the plain kernel\n" : "Verify: R matches the plain kernel\n", wrong);
+        free(full);
+    }
 
     // Remove the comment to print result matrices for debugging (in root process)
     // if(rank == 0) {
@@ -110,6 +1302,7 @@ int main(int argc, char **argv) {
     // Print time taken by each process (useful for performance analysis)
     printf("Process %d: Time taken = %f seconds\n", rank, endTime - startTime);
 
+    coll_close(&coll);
     MPI_Finalize();  // Finalize the MPI environment
     return 0;
 }
@@ -0,0 +1,443 @@
+/*
+    Self-tuning scatter, gather and broadcast for matrix_mul_mpi.c and phonebook_mpi.cpp
+    (--coll-tune <file>).
+
+    The MPI library picks one algorithm per collective from built-in thresholds, which are often
+    wrong for a given interconnect. This header implements the usual alternatives over plain
+    point-to-point messages:
+
+        linear             the root talks to every rank in turn
+        binomial           a binomial tree: log2(p) rounds, subtrees forward their share
+        chain              a pipeline through all ranks in 64 KB pieces
+        scatter-allgather  (broadcast only) scatter the message in p pieces, then a ring allgather
+        hierarchical       one leader per node: a tree between the leaders, then a tree per node
+
+    plus "library", the MPI library's own call. On first use with a tuning file that has no
+    entries for the current number of processes and nodes, a short microbenchmark times every
+    algorithm at message sizes from 16 bytes to 1 MB (per rank) and appends the fastest to the
+    file. Later runs just read it. A call uses the entry with the largest size not above its
+    message size. Delete the file's lines to re-tune, or edit them to force a choice.
+
+    File format, one rule per line:   <scatter|gather|bcast> <processes> <nodes> <bytes> <algorithm>
+
+        coll_ctx coll;
+        coll_open(&coll, MPI_COMM_WORLD, "coll.tune", rank == 0);  // Collective; may benchmark
+        coll_scatterv(&coll, send, counts, displs, recv, 0);        // Counts and displacements in bytes
+        coll_close(&coll);
+
+    Every call is collective over the communicator passed to coll_open, and its messages travel on
+    a private duplicate of it, so they never mix with the program's own traffic. Unlike with
+    MPI_Scatterv and MPI_Gatherv, every rank passes the counts of all ranks: the tree and chain
+    algorithms forward other ranks' blocks and need their sizes. The header compiles as C or C++.
+*/
+
+#ifndef MPI_COLL_H
+#define MPI_COLL_H
+
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum { COLL_SCATTER, COLL_GATHER, COLL_BCAST, COLL_OPS };
+enum { COLL_LIBRARY, COLL_LINEAR, COLL_BINOMIAL, COLL_CHAIN, COLL_SCATTER_ALLGATHER, COLL_HIERARCHICAL, COLL_ALGORITHMS };
+
+#define COLL_SEGMENT 65536   /* Piece size of the chain pipeline */
+#define COLL_MAX_RULES 256   /* Rules kept for one communicator shape */
+#define COLL_TAG 7           /* Tag of all messages on the private communicator */
+#define COLL_TRIALS 3        /* Timed repetitions per algorithm and size (after one warm-up) */
+
+static const char *const coll_op_names[COLL_OPS] = {"scatter", "gather", "bcast"};
+static const char *const coll_algorithm_names[COLL_ALGORITHMS] = {"library", "linear", "binomial", "chain",
+                                                                  "scatter-allgather", "hierarchical"};
+static const int coll_implements[COLL_OPS][COLL_ALGORITHMS] = {  /* Algorithms available per operation */
+    {1, 1, 1, 1, 0, 1}, {1, 1, 1, 1, 0, 1}, {1, 1, 1, 1, 1, 1}};
+
+// One tuning decision: from `bytes` per rank upwards, use `algorithm`
+typedef struct {
+    int op, procs, nodes;
+    long bytes;
+    int algorithm;
+} coll_rule;
+
+// Collective state of one communicator
+typedef struct {
+    MPI_Comm user, comm;                      // The program's communicator and the private duplicate
+    int rank, size, nodes;
+    int *node_of;                             // Node number of every rank; nodes numbered by their lowest rank
+    int nrules;
+    coll_rule rules[COLL_MAX_RULES];          // Rules for this number of processes and nodes
+    int force[COLL_OPS];                      // Algorithm forced by the tuner, or -1
+} coll_ctx;
+
+// Size of the binomial subtree rooted at position `me` of an n-position tree
+static inline int coll_span(int me, int n) {
+    int mask = 1;
+    if (me > 0) return me & -me;
+    while (mask < n) mask <<= 1;
+    return mask;
+}
+
+// Smaller of two ints
+static inline int coll_min(int a, int b) {
+    return a < b ? a : b;
+}
+
+// The primitives below run over a group of n positions (group[j] = communicator rank, position 0
+// is the root). Block j occupies [off[j], off[j+1]) of the packed data, and `buf` of position me
+// holds the packed data from off[me] on, as far as its part of the algorithm needs.
+
+// Binomial-tree scatter: each position receives its subtree's blocks and passes on the children's
+static inline void coll_tree_scatter(MPI_Comm comm, const int *group, int n, int me, const long *off, char *buf) {
+    int span = coll_span(me, n);
+    if (me > 0)
+        MPI_Recv(buf, (int)(off[coll_min(me + span, n)] - off[me]), MPI_BYTE, group[me - span], COLL_TAG, comm,
+                 MPI_STATUS_IGNORE);
+    for (int m = span >> 1; m > 0; m >>= 1) {
+        if (me + m >= n) continue;
+        MPI_Send(buf + (off[me + m] - off[me]), (int)(off[coll_min(me + 2 * m, n)] - off[me + m]), MPI_BYTE,
+                 group[me + m], COLL_TAG, comm);
+    }
+}
+
+// Binomial-tree gather: the mirror image of coll_tree_scatter
+static inline void coll_tree_gather(MPI_Comm comm, const int *group, int n, int me, const long *off, char *buf) {
+    int span = coll_span(me, n);
+    for (int m = 1; m < span && me + m < n; m <<= 1)
+        MPI_Recv(buf + (off[me + m] - off[me]), (int)(off[coll_min(me + 2 * m, n)] - off[me + m]), MPI_BYTE,
+                 group[me + m], COLL_TAG, comm, MPI_STATUS_IGNORE);
+    if (me > 0)
+        MPI_Send(buf, (int)(off[coll_min(me + span, n)] - off[me]), MPI_BYTE, group[me - span], COLL_TAG, comm);
+}
+
+// Chain scatter: blocks me..n-1 flow down the chain piece by piece; each position keeps its own
+static inline void coll_chain_scatter(MPI_Comm comm, const int *group, int n, int me, const long *off, char *buf) {
+    for (int j = me; j < n; j++) {
+        for (long at = off[j]; at < off[j + 1]; at += COLL_SEGMENT) {
+            int len = (int)(off[j + 1] - at < COLL_SEGMENT ? off[j + 1] - at : COLL_SEGMENT);
+            char *p = buf + (at - off[me]);
+            if (me > 0) MPI_Recv(p, len, MPI_BYTE, group[me - 1], COLL_TAG, comm, MPI_STATUS_IGNORE);
+            if (j > me && me + 1 < n) MPI_Send(p, len, MPI_BYTE, group[me + 1], COLL_TAG, comm);
+        }
+    }
+}
+
+// Chain gather: each position sends its own block up the chain, then forwards what comes from below
+static inline void coll_chain_gather(MPI_Comm comm, const int *group, int n, int me, const long *off, char *buf) {
+    for (int j = me; j < n; j++) {
+        for (long at = off[j]; at < off[j + 1]; at += COLL_SEGMENT) {
+            int len = (int)(off[j + 1] - at < COLL_SEGMENT ? off[j + 1] - at : COLL_SEGMENT);
+            char *p = buf + (at - off[me]);
+            if (j > me) MPI_Recv(p, len, MPI_BYTE, group[me + 1], COLL_TAG, comm, MPI_STATUS_IGNORE);
+            if (me > 0) MPI_Send(p, len, MPI_BYTE, group[me - 1], COLL_TAG, comm);
+        }
+    }
+}
+
+// Linear scatter or gather: the root exchanges every block directly with the caller's buffers,
+// so unlike the staged algorithms it packs nothing
+static inline void coll_linear(const coll_ctx *c, char *data, const int *cnt, const int *displs, char *mine, int root,
+                               int gather) {
+    if (c->rank != root) {
+        if (gather) MPI_Send(mine, cnt[c->rank], MPI_BYTE, root, COLL_TAG, c->comm);
+        else MPI_Recv(mine, cnt[c->rank], MPI_BYTE, root, COLL_TAG, c->comm, MPI_STATUS_IGNORE);
+        return;
+    }
+    for (int r = 0; r < c->size; r++) {
+        if (r == root && gather) memcpy(data + displs[r], mine, cnt[r]);
+        else if (r == root) memcpy(mine, data + displs[r], cnt[r]);
+        else if (gather) MPI_Recv(data + displs[r], cnt[r], MPI_BYTE, r, COLL_TAG, c->comm, MPI_STATUS_IGNORE);
+        else MPI_Send(data + displs[r], cnt[r], MPI_BYTE, r, COLL_TAG, c->comm);
+    }
+}
+
+// Broadcast of the whole buffer down a binomial tree, a pipelined chain or directly from the root
+static inline void coll_plain_bcast(MPI_Comm comm, const int *group, int n, int me, char *buf, long bytes, int algorithm) {
+    if (algorithm == COLL_CHAIN) {
+        for (long at = 0; at < bytes; at += COLL_SEGMENT) {
+            int len = (int)(bytes - at < COLL_SEGMENT ? bytes - at : COLL_SEGMENT);
+            if (me > 0) MPI_Recv(buf + at, len, MPI_BYTE, group[me - 1], COLL_TAG, comm, MPI_STATUS_IGNORE);
+            if (me + 1 < n) MPI_Send(buf + at, len, MPI_BYTE, group[me + 1], COLL_TAG, comm);
+        }
+    } else if (algorithm == COLL_LINEAR) {
+        if (me > 0) MPI_Recv(buf, (int)bytes, MPI_BYTE, group[0], COLL_TAG, comm, MPI_STATUS_IGNORE);
+        else for (int j = 1; j < n; j++) MPI_Send(buf, (int)bytes, MPI_BYTE, group[j], COLL_TAG, comm);
+    } else {
+        int span = coll_span(me, n);
+        if (me > 0) MPI_Recv(buf, (int)bytes, MPI_BYTE, group[me - span], COLL_TAG, comm, MPI_STATUS_IGNORE);
+        for (int m = span >> 1; m > 0; m >>= 1)
+            if (me + m < n) MPI_Send(buf, (int)bytes, MPI_BYTE, group[me + m], COLL_TAG, comm);
+    }
+}
+
+// Position order of the ranks. Flat algorithms use root, root+1, ...; the hierarchical one groups
+// the ranks by node, the root's node first, each node led by its lowest rank (or the root).
+// nodes_at[k] is the first position of the k-th node in that order (nodes + 1 entries).
+static inline void coll_order(const coll_ctx *c, int root, int hierarchical, int *order, int *nodes_at) {
+    if (!hierarchical) {
+        for (int j = 0; j < c->size; j++) order[j] = (root + j) % c->size;
+        return;
+    }
+    int n = 0, k = 0;
+    for (int pass = 0; pass < c->nodes; pass++) {
+        int node = (c->node_of[root] + pass) % c->nodes;
+        nodes_at[k++] = n;
+        if (node == c->node_of[root]) order[n++] = root;
+        for (int r = 0; r < c->size; r++)
+            if (c->node_of[r] == node && r != root) order[n++] = r;
+    }
+    nodes_at[k] = n;
+}
+
+// Runs a scatter (gather = 0) or gather over the packed data with a hierarchical tree: between
+// the node leaders first (last for a gather), then inside every node
+static inline void coll_hier(const coll_ctx *c, const int *order, const int *nodes_at, int me, const long *off, char *buf,
+                             int gather) {
+    int k = 0;
+    while (nodes_at[k + 1] <= me) k++;                             // My node's index in the order
+    int *leaders = (int *)malloc(c->nodes * sizeof(int));
+    long *leader_off = (long *)malloc((c->nodes + 1) * sizeof(long));
+    for (int j = 0; j <= c->nodes; j++) {
+        leader_off[j] = off[nodes_at[j]];
+        if (j < c->nodes) leaders[j] = order[nodes_at[j]];
+    }
+    int first = nodes_at[k], members = nodes_at[k + 1] - first;
+    if (!gather && me == first) coll_tree_scatter(c->comm, leaders, c->nodes, k, leader_off, buf);
+    if (gather) coll_tree_gather(c->comm, order + first, members, me - first, off + first, buf);
+    else coll_tree_scatter(c->comm, order + first, members, me - first, off + first, buf);
+    if (gather && me == first) coll_tree_gather(c->comm, leaders, c->nodes, k, leader_off, buf);
+    free(leaders);
+    free(leader_off);
+}
+
+// Algorithm for an operation of `bytes` per rank: the rule with the largest size not above it
+static inline int coll_choose(const coll_ctx *c, int op, long bytes) {
+    if (c->force[op] >= 0) return c->force[op];
+    int best = -1, smallest = -1;
+    for (int i = 0; i < c->nrules; i++) {
+        const coll_rule *r = &c->rules[i];
+        if (r->op != op) continue;
+        if (r->bytes <= bytes && (best < 0 || r->bytes > c->rules[best].bytes)) best = i;
+        if (smallest < 0 || r->bytes < c->rules[smallest].bytes) smallest = i;
+    }
+    if (best < 0) best = smallest;                                 // Smaller than anything tuned
+    return best < 0 ? COLL_LIBRARY : c->rules[best].algorithm;
+}
+
+// Scatter or gather of byte blocks; counts (bytes) on every rank, displs (bytes) at the root
+static inline void coll_transfer(coll_ctx *c, void *data, const int *cnt, const int *displs, void *mine, int root,
+                                 int gather) {
+    long total = 0;
+    for (int r = 0; r < c->size; r++) total += cnt[r];
+    int op = gather ? COLL_GATHER : COLL_SCATTER, algorithm = coll_choose(c, op, total / c->size);
+    if (algorithm == COLL_LIBRARY) {
+        if (gather) MPI_Gatherv(mine, cnt[c->rank], MPI_BYTE, data, cnt, displs, MPI_BYTE, root, c->user);
+        else MPI_Scatterv(data, cnt, displs, MPI_BYTE, mine, cnt[c->rank], MPI_BYTE, root, c->user);
+        return;
+    }
+    if (algorithm == COLL_LINEAR) {
+        coll_linear(c, (char *)data, cnt, displs, (char *)mine, root, gather);
+        return;
+    }
+
+    // Pack the blocks in position order: position me owns [off[me], off[me + 1]) and stages the
+    // blocks from its own up to the end of its binomial subtree, or of the chain / node tree
+    int hier = algorithm == COLL_HIERARCHICAL, me = 0;
+    int *order = (int *)malloc(c->size * sizeof(int)), *nodes_at = (int *)malloc((c->nodes + 1) * sizeof(int));
+    long *off = (long *)malloc((c->size + 1) * sizeof(long));
+    coll_order(c, root, hier, order, nodes_at);
+    off[0] = 0;
+    for (int j = 0; j < c->size; j++) {
+        off[j + 1] = off[j] + cnt[order[j]];
+        if (order[j] == c->rank) me = j;
+    }
+    long end = algorithm == COLL_BINOMIAL ? off[coll_min(me + coll_span(me, c->size), c->size)] : off[c->size];
+    char *buf = (char *)malloc(end - off[me] + 1);
+    if (!gather && me == 0)
+        for (int j = 0; j < c->size; j++) memcpy(buf + off[j], (char *)data + displs[order[j]], cnt[order[j]]);
+    if (gather) memcpy(buf, mine, cnt[c->rank]);
+
+    if (hier) coll_hier(c, order, nodes_at, me, off, buf, gather);
+    else if (algorithm == COLL_BINOMIAL && gather) coll_tree_gather(c->comm, order, c->size, me, off, buf);
+    else if (algorithm == COLL_BINOMIAL) coll_tree_scatter(c->comm, order, c->size, me, off, buf);
+    else if (algorithm == COLL_CHAIN && gather) coll_chain_gather(c->comm, order, c->size, me, off, buf);
+    else coll_chain_scatter(c->comm, order, c->size, me, off, buf);
+
+    if (!gather) memcpy(mine, buf, cnt[c->rank]);
+    if (gather && me == 0)
+        for (int j = 0; j < c->size; j++) memcpy((char *)data + displs[order[j]], buf + off[j], cnt[order[j]]);
+    free(buf);
+    free(off);
+    free(order);
+    free(nodes_at);
+}
+
+// Like MPI_Scatterv on bytes; recv receives this rank's block
+static inline void coll_scatterv(coll_ctx *c, const void *send, const int *counts, const int *displs, void *recv, int root) {
+    coll_transfer(c, (void *)send, counts, displs, recv, root, 0);
+}
+
+// Like MPI_Gatherv on bytes; send holds this rank's block of counts[rank] bytes
+static inline void coll_gatherv(coll_ctx *c, const void *send, const int *counts, void *recv, const int *displs, int root) {
+    coll_transfer(c, recv, counts, displs, (void *)send, root, 1);
+}
+
+// Like MPI_Bcast on bytes (every rank passes the same length)
+static inline void coll_bcast(coll_ctx *c, void *data, long bytes, int root) {
+    int algorithm = coll_choose(c, COLL_BCAST, bytes);
+    if (algorithm == COLL_LIBRARY) {
+        MPI_Bcast(data, (int)bytes, MPI_BYTE, root, c->user);
+        return;
+    }
+    int hier = algorithm == COLL_HIERARCHICAL, me = 0, n = c->size;
+    int *order = (int *)malloc(n * sizeof(int)), *nodes_at = (int *)malloc((c->nodes + 1) * sizeof(int));
+    coll_order(c, root, hier, order, nodes_at);
+    for (int j = 0; j < n; j++)
+        if (order[j] == c->rank) me = j;
+    char *buf = (char *)data;
+    if (algorithm == COLL_SCATTER_ALLGATHER) {
+        // Scatter n pieces down a binomial tree, then pass them around a ring
+        long *off = (long *)malloc((n + 1) * sizeof(long));
+        for (int j = 0; j <= n; j++) off[j] = bytes * j / n;
+        coll_tree_scatter(c->comm, order, n, me, off, buf + off[me]);
+        for (int s = 0; s < n - 1; s++) {
+            int out = (me - s + n) % n, in = (me - s - 1 + n) % n;
+            MPI_Sendrecv(buf + off[out], (int)(off[out + 1] - off[out]), MPI_BYTE, order[(me + 1) % n], COLL_TAG,
+                         buf + off[in], (int)(off[in + 1] - off[in]), MPI_BYTE, order[(me - 1 + n) % n], COLL_TAG,
+                         c->comm, MPI_STATUS_IGNORE);
+        }
+        free(off);
+    } else if (hier) {
+        int k = 0;
+        while (nodes_at[k + 1] <= me) k++;
+        int *leaders = (int *)malloc(c->nodes * sizeof(int));
+        for (int j = 0; j < c->nodes; j++) leaders[j] = order[nodes_at[j]];
+        if (me == nodes_at[k]) coll_plain_bcast(c->comm, leaders, c->nodes, k, buf, bytes, COLL_BINOMIAL);
+        coll_plain_bcast(c->comm, order + nodes_at[k], nodes_at[k + 1] - nodes_at[k], me - nodes_at[k], buf, bytes,
+                         COLL_BINOMIAL);
+        free(leaders);
+    } else {
+        coll_plain_bcast(c->comm, order, n, me, buf, bytes, algorithm);
+    }
+    free(order);
+    free(nodes_at);
+}
+
+// Reads the rules for this communicator's shape from the tuning file (rank 0 reads, all ranks get
+// them); returns how many there are
+static inline int coll_load(coll_ctx *c, const char *path) {
+    c->nrules = 0;
+    if (c->rank == 0) {
+        FILE *f = fopen(path, "r");
+        char line[256], op[32], algorithm[32];
+        coll_rule r;
+        while (f && fgets(line, sizeof line, f) && c->nrules < COLL_MAX_RULES) {
+            if (sscanf(line, "%31s %d %d %ld %31s", op, &r.procs, &r.nodes, &r.bytes, algorithm) != 5) continue;
+            if (r.procs != c->size || r.nodes != c->nodes) continue;
+            r.op = r.algorithm = -1;
+            for (int i = 0; i < COLL_OPS; i++) if (strcmp(op, coll_op_names[i]) == 0) r.op = i;
+            for (int i = 0; i < COLL_ALGORITHMS; i++) if (strcmp(algorithm, coll_algorithm_names[i]) == 0) r.algorithm = i;
+            if (r.op >= 0 && r.algorithm >= 0 && coll_implements[r.op][r.algorithm]) c->rules[c->nrules++] = r;
+        }
+        if (f) fclose(f);
+    }
+    MPI_Bcast(&c->nrules, 1, MPI_INT, 0, c->comm);
+    MPI_Bcast(c->rules, c->nrules * (int)sizeof(coll_rule), MPI_BYTE, 0, c->comm);
+    return c->nrules;
+}
+
+// Times every algorithm of every operation at sizes from 16 bytes to 1 MB per rank (slowest rank,
+// best of COLL_TRIALS), keeps the fastest as rules and appends them to the tuning file
+static inline void coll_tune(coll_ctx *c, const char *path, int verbose) {
+    static const long sizes[] = {16, 256, 4096, 65536, 1 << 20};
+    int nsizes = sizeof sizes / sizeof sizes[0], p = c->size;
+    long most = sizes[nsizes - 1];
+    char *all = (char *)malloc(most * p), *mine = (char *)malloc(most);
+    int *counts = (int *)malloc(p * sizeof(int)), *displs = (int *)malloc(p * sizeof(int));
+    memset(all, 1, most * p);
+    memset(mine, 2, most);
+    FILE *f = c->rank == 0 ? fopen(path, "a") : NULL;
+    if (verbose) printf("Tuning collectives for %d processes on %d node(s):\n", p, c->nodes);
+    c->nrules = 0;
+    for (int op = 0; op < COLL_OPS; op++) {
+        for (int s = 0; s < nsizes; s++) {
+            for (int r = 0; r < p; r++) {
+                counts[r] = (int)sizes[s];
+                displs[r] = (int)(r * sizes[s]);
+            }
+            double best = 1e30;
+            int winner = COLL_LIBRARY;
+            if (verbose) printf("  %-7s %8ld B:", coll_op_names[op], sizes[s]);
+            for (int a = 0; a < COLL_ALGORITHMS; a++) {
+                if (!coll_implements[op][a]) continue;
+                c->force[op] = a;
+                double fastest = 1e30;
+                for (int t = 0; t <= COLL_TRIALS; t++) {
+                    MPI_Barrier(c->comm);
+                    double t0 = MPI_Wtime(), took;
+                    if (op == COLL_SCATTER) coll_scatterv(c, all, counts, displs, mine, 0);
+                    else if (op == COLL_GATHER) coll_gatherv(c, mine, counts, all, displs, 0);
+                    else coll_bcast(c, mine, sizes[s], 0);
+                    double local = MPI_Wtime() - t0;
+                    MPI_Allreduce(&local, &took, 1, MPI_DOUBLE, MPI_MAX, c->comm);
+                    if (t > 0 && took < fastest) fastest = took;   // Trial 0 warms up
+                }
+                if (verbose) printf(" %s %.0f us", coll_algorithm_names[a], fastest * 1e6);
+                if (fastest < best) { best = fastest; winner = a; }
+            }
+            c->force[op] = -1;
+            if (verbose) printf("  -> %s\n", coll_algorithm_names[winner]);
+            coll_rule rule = {op, p, c->nodes, sizes[s], winner};
+            if (c->nrules < COLL_MAX_RULES) c->rules[c->nrules++] = rule;
+            if (f) fprintf(f, "%s %d %d %ld %s\n", coll_op_names[op], p, c->nodes, sizes[s], coll_algorithm_names[winner]);
+        }
+    }
+    if (f) fclose(f);
+    free(all);
+    free(mine);
+    free(counts);
+    free(displs);
+}
+
+// Sets up the collectives for `comm` (collective): finds which ranks share a node, then loads the
+// rules for this shape from `path`, running the tuner first if the file has none. A NULL path
+// keeps the MPI library's choices.
+static inline void coll_open(coll_ctx *c, MPI_Comm comm, const char *path, int verbose) {
+    c->user = comm;
+    MPI_Comm_dup(comm, &c->comm);
+    MPI_Comm_rank(comm, &c->rank);
+    MPI_Comm_size(comm, &c->size);
+    for (int op = 0; op < COLL_OPS; op++) c->force[op] = -1;
+
+    // Every rank learns the lowest rank on its node, which numbers the nodes
+    MPI_Comm node;
+    int lowest, *lowest_of = (int *)malloc(c->size * sizeof(int));
+    MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &node);
+    MPI_Allreduce(&c->rank, &lowest, 1, MPI_INT, MPI_MIN, node);
+    MPI_Comm_free(&node);
+    MPI_Allgather(&lowest, 1, MPI_INT, lowest_of, 1, MPI_INT, comm);
+    c->node_of = (int *)malloc(c->size * sizeof(int));
+    c->nodes = 0;
+    for (int r = 0; r < c->size; r++) c->node_of[r] = lowest_of[r] == r ? c->nodes++ : c->node_of[lowest_of[r]];
+    free(lowest_of);
+
+    c->nrules = 0;
+    if (path != NULL && coll_load(c, path) == 0) coll_tune(c, path, verbose);
+}
+
+// Pretends the processes are spread round-robin over `nodes` nodes (rank r on node r % nodes), as a
+// launcher mapping by node would place them, to try node-aware layouts on one machine. Call it
+// right after coll_open; the rules loaded there stay those of the real node count.
+static inline void coll_simulate_nodes(coll_ctx *c, int nodes) {
+    c->nodes = nodes;
+    for (int r = 0; r < c->size; r++) c->node_of[r] = r % nodes;
+}
+
+// Frees the state of coll_open (collective)
+static inline void coll_close(coll_ctx *c) {
+    MPI_Comm_free(&c->comm);
+    free(c->node_of);
+    c->node_of = NULL;
+}
+
+#endif
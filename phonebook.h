@@ -0,0 +1,101 @@
+/*
+    In-process phonebook search: the loaders, matchers and indexes of phonebook_mpi.cpp as a
+    library with a C API, for services that would otherwise start an mpirun per lookup.
+
+    Build:  g++ -O2 -fPIC -shared -fvisibility=hidden -Wl,--version-script=phonebook.map \
+                -o libphonebook.so phonebook_lib.cpp -lpthread
+    Use:    cc app.c -L. -lphonebook
+
+        #include "phonebook.h"
+
+        const char *files[] = {"phonebook1.txt"};
+        pb_book *book = pb_open_files(files, 1, 0);
+        if (book == NULL) { fprintf(stderr, "%s\n", pb_error()); return 1; }
+
+        pb_result *res = pb_query(book, "HOSSAIN", PB_SUBSTRING);   // iterator results
+        const char *name, *phone;
+        while (pb_result_next(res, &name, &phone)) printf("%s %s\n", name, phone);
+        pb_result_free(res);
+
+        pb_search(book, "01762031", PB_PHONE, print_row, NULL);     // callback results
+        pb_close(book);
+
+    Query modes match the MPI program: PB_SUBSTRING finds names containing the term, PB_GLOB
+    matches whole names against a pattern with * and ?, PB_EXACT_NAME compares full names with
+    case and spacing ignored (like --exact / --lookup name) and PB_PHONE compares phone digits
+    (like --lookup phone).
+
+    Thread safety: a book never changes once opened, so any number of threads may query the same
+    book at once. The exact-key indexes are built on first use, once, by whichever query needs
+    them first. A pb_result belongs to one thread at a time. Name and phone pointers handed out
+    by queries stay valid until the book is closed.
+
+    Errors: functions that fail return NULL or -1 and leave a message for pb_error() in the
+    calling thread.
+*/
+
+#ifndef PHONEBOOK_H
+#define PHONEBOOK_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PB_API_VERSION 1                    /* Bumped only for incompatible changes */
+
+/* Flags of pb_open_files / pb_open_snapshot */
+#define PB_OPEN_NFC 1                       /* Match on NFC-normalized, case-folded names */
+#define PB_OPEN_NFKC 2                      /* Same with NFKC (compatibility characters folded too) */
+
+/* Query modes */
+#define PB_SUBSTRING 0
+#define PB_GLOB 1
+#define PB_EXACT_NAME 2
+#define PB_PHONE 3
+
+typedef struct pb_book pb_book;             /* An opened phonebook */
+typedef struct pb_result pb_result;         /* Matches of one query, read with pb_result_next */
+
+/* Called once per match in record order; return nonzero to stop the search early */
+typedef int (*pb_match_fn)(const char *name, const char *phone, void *user);
+
+/* PB_API_VERSION of the library actually loaded */
+int pb_version(void);
+
+/* Message describing the last failed call in this thread */
+const char *pb_error(void);
+
+/* Loads one or more phonebook files ("name", "phone" lines) into memory */
+pb_book *pb_open_files(const char *const *paths, int count, int flags);
+
+/* Maps a snapshot written by --build-snapshot; exact-name queries use its perfect hash */
+pb_book *pb_open_snapshot(const char *path, int flags);
+
+/* Number of records in the book */
+size_t pb_size(const pb_book *book);
+
+/* Runs a query and calls fn for every match; returns the number of matches delivered, or -1 */
+long pb_search(const pb_book *book, const char *term, int mode, pb_match_fn fn, void *user);
+
+/* Runs a query and returns its matches as an iterator, or NULL */
+pb_result *pb_query(const pb_book *book, const char *term, int mode);
+
+/* Number of matches in the result */
+size_t pb_result_count(const pb_result *res);
+
+/* Advances to the next match; returns 1 and sets name and phone, or 0 at the end */
+int pb_result_next(pb_result *res, const char **name, const char **phone);
+
+/* Frees a result */
+void pb_result_free(pb_result *res);
+
+/* Frees the book; its results and the strings they returned must no longer be used */
+void pb_close(pb_book *book);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
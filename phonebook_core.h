@@ -0,0 +1,1102 @@
+/*
+    Core of the phonebook search, shared by the MPI program (phonebook_mpi.cpp) and the
+    embeddable library (phonebook_lib.cpp, C API in phonebook.h): the loaders, the record table,
+    Unicode name folding, the matchers, snapshot lookups and the exact-key index. Nothing in here
+    talks to MPI or writes files; the collective parts (token dictionary, snapshot building) stay
+    in phonebook_mpi.cpp.
+
+    The definitions are not inline, so include this header in exactly one translation unit of a
+    program.
+*/
+
+#ifndef PHONEBOOK_CORE_H
+#define PHONEBOOK_CORE_H
+
+#include <bits/stdc++.h>
+#ifdef __SSE2__
+#include <immintrin.h>
+#endif
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+using namespace std;
+
+// Struct to represent a contact entry with name and phone number
+struct Contact {
+    string name;
+    string phone;
+};
+
+// Dictionary-encoded names of one rank's records. The dictionary is global (identical IDs on
+// every rank); records and postings are stored in CSR form over local record numbers.
+struct TokenIndex {
+    vector<string> dict;                 // Sorted distinct name tokens across all ranks
+    vector<int> rec_start, rec_tokens;   // Token IDs of local record i: rec_tokens[rec_start[i]..rec_start[i+1])
+    vector<int> post_start, postings;    // Local records containing token t: postings[post_start[t]..post_start[t+1])
+};
+
+// Converts a received string back into a vector of Contact objects
+vector<Contact> string_to_contacts(const string &text) {
+    vector<Contact> contacts;
+    istringstream iss(text);
+    string line;
+    while (getline(iss, line)) {
+        if (line.empty()) continue;
+        int comma = line.find(",");
+        if (comma == string::npos) continue;
+        contacts.push_back({line.substr(0, comma), line.substr(comma + 1)});
+    }
+    return contacts;
+}
+
+// Reads contacts from one or more phonebook files into a vector
+void read_phonebook(const vector<string> &files, vector<Contact> &contacts) {
+    for (const string &file : files) {
+        ifstream f(file);
+        string line;
+        while (getline(f, line)) {
+            if (line.empty()) continue;
+            int comma = line.find(",");
+            if (comma == string::npos) continue;
+            // Clean and extract name and phone
+            contacts.push_back({line.substr(1, comma - 2), line.substr(comma + 2, line.size() - comma - 3)});
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------------------------
+// Staged ingest. A reader thread fills large buffers that always end at a line boundary, parser
+// threads split them into lines and contacts, and the calling thread (the builder) appends the
+// parsed rows in file order. Buffers circulate reader -> parsers -> builder -> reader through
+// bounded lock-free rings, so the pool is allocated once and no stage ever takes a lock.
+// ---------------------------------------------------------------------------------------------
+
+const size_t INGEST_BUFFER_BYTES = 4 << 20;         // Bytes the reader asks for per buffer
+
+// Bounded multi-producer multi-consumer ring of buffer numbers (Vyukov's sequenced cells)
+struct MpmcRing {
+    struct Cell { atomic<size_t> seq; int value; };
+    vector<Cell> cells;
+    size_t mask;
+    alignas(64) atomic<size_t> head{0};             // Next cell to pop
+    alignas(64) atomic<size_t> tail{0};             // Next cell to push
+    explicit MpmcRing(size_t capacity) : cells(capacity), mask(capacity - 1) { // capacity: a power of two
+        for (size_t i = 0; i < capacity; i++) cells[i].seq.store(i, memory_order_relaxed);
+    }
+    bool try_push(int v) {
+        size_t pos = tail.load(memory_order_relaxed);
+        while (true) {
+            Cell &c = cells[pos & mask];
+            intptr_t dif = (intptr_t)c.seq.load(memory_order_acquire) - (intptr_t)pos;
+            if (dif < 0) return false;              // Full
+            if (dif > 0) { pos = tail.load(memory_order_relaxed); continue; }
+            if (tail.compare_exchange_weak(pos, pos + 1, memory_order_relaxed)) {
+                c.value = v;
+                c.seq.store(pos + 1, memory_order_release);
+                return true;
+            }
+        }
+    }
+    bool try_pop(int &v) {
+        size_t pos = head.load(memory_order_relaxed);
+        while (true) {
+            Cell &c = cells[pos & mask];
+            intptr_t dif = (intptr_t)c.seq.load(memory_order_acquire) - (intptr_t)(pos + 1);
+            if (dif < 0) return false;              // Empty
+            if (dif > 0) { pos = head.load(memory_order_relaxed); continue; }
+            if (head.compare_exchange_weak(pos, pos + 1, memory_order_relaxed)) {
+                v = c.value;
+                c.seq.store(pos + mask + 1, memory_order_release);
+                return true;
+            }
+        }
+    }
+    void push(int v) { while (!try_push(v)) this_thread::yield(); }
+    int pop() { int v; while (!try_pop(v)) this_thread::yield(); return v; }
+};
+
+// Bounded single-producer single-consumer ring of buffer numbers
+struct SpscRing {
+    vector<int> slots;
+    size_t mask;
+    alignas(64) atomic<size_t> head{0};             // Written by the consumer only
+    alignas(64) atomic<size_t> tail{0};             // Written by the producer only
+    explicit SpscRing(size_t capacity) : slots(capacity), mask(capacity - 1) {}
+    void push(int v) {
+        size_t t = tail.load(memory_order_relaxed);
+        while (t - head.load(memory_order_acquire) > mask) this_thread::yield(); // Full
+        slots[t & mask] = v;
+        tail.store(t + 1, memory_order_release);
+    }
+    int pop() {
+        size_t h = head.load(memory_order_relaxed);
+        while (tail.load(memory_order_acquire) == h) this_thread::yield();      // Empty
+        int v = slots[h & mask];
+        head.store(h + 1, memory_order_release);
+        return v;
+    }
+};
+
+// One buffer of the ingest pool: raw bytes from the reader, then the rows parsed from them
+struct IngestBuffer {
+    vector<char> data;
+    size_t len = 0;                                 // Valid bytes; always whole lines
+    size_t seq = 0;                                 // Position in the input, for in-order appends
+    vector<Contact> rows;
+};
+
+// Parses whole lines the way read_phonebook does
+void parse_lines(const char *p, size_t n, vector<Contact> &rows) {
+    const char *end = p + n;
+    while (p < end) {
+        const char *nl = (const char *)memchr(p, '\n', end - p);
+        if (nl == nullptr) nl = end;
+        string_view line(p, nl - p);
+        p = nl + 1;
+        if (line.empty()) continue;
+        size_t comma = line.find(',');
+        if (comma == string_view::npos) continue;
+        rows.push_back({string(line.substr(1, comma - 2)), string(line.substr(comma + 2, line.size() - comma - 3))});
+    }
+}
+
+// Reader stage: fills free buffers from the files and cuts each one after its last newline; the
+// cut-off tail starts the next buffer. Ends with one stop marker (-1) per parser.
+void ingest_reader(const vector<string> &files, vector<IngestBuffer> &pool, SpscRing &free_buffers, MpmcRing &full,
+                   int parsers) {
+    size_t seq = 0;
+    for (const string &file : files) {
+        int fd = open(file.c_str(), O_RDONLY);
+        if (fd < 0) continue;                       // Unreadable files add nothing, as with ifstream
+        string carry;
+        bool eof = false;
+        while (!eof) {
+            IngestBuffer &buf = pool[free_buffers.pop()];
+            if (buf.data.size() < carry.size() + INGEST_BUFFER_BYTES) buf.data.resize(carry.size() + INGEST_BUFFER_BYTES);
+            memcpy(buf.data.data(), carry.data(), carry.size());
+            buf.len = carry.size();
+            while (buf.len < buf.data.size()) {
+                ssize_t got = read(fd, buf.data.data() + buf.len, buf.data.size() - buf.len);
+                if (got <= 0) { eof = true; break; }
+                buf.len += got;
+            }
+            size_t cut = buf.len;                   // At end of file the last line needs no newline
+            if (!eof) {
+                const char *last = (const char *)memrchr(buf.data.data(), '\n', buf.len);
+                cut = last ? last - buf.data.data() + 1 : 0; // A line longer than the buffer grows it
+            }
+            carry.assign(buf.data.data() + cut, buf.len - cut);
+            buf.len = cut;
+            buf.seq = seq++;
+            full.push(&buf - pool.data());
+        }
+        close(fd);
+    }
+    for (int i = 0; i < parsers; i++) full.push(-1);
+}
+
+// Reads the files with one reader thread, `parsers` parser threads and the calling thread as the
+// builder; appends the same contacts in the same order as the serial loop
+void ingest_phonebook(const vector<string> &files, vector<Contact> &contacts, int parsers) {
+    vector<IngestBuffer> pool(2 * parsers + 2);     // Enough to keep every stage busy
+    size_t capacity = 1;
+    while (capacity < pool.size() + parsers + 1) capacity <<= 1;
+    SpscRing free_buffers(capacity);                // builder -> reader
+    MpmcRing full(capacity), parsed(capacity);      // reader -> parsers -> builder
+    for (size_t b = 0; b < pool.size(); b++) free_buffers.push(b);
+
+    thread reader(ingest_reader, cref(files), ref(pool), ref(free_buffers), ref(full), parsers);
+    vector<thread> workers;
+    for (int i = 0; i < parsers; i++)
+        workers.emplace_back([&] {
+            while (true) {
+                int b = full.pop();
+                if (b >= 0) parse_lines(pool[b].data.data(), pool[b].len, pool[b].rows);
+                parsed.push(b);
+                if (b < 0) return;
+            }
+        });
+
+    // Builder: buffers finish out of order, so each waits until its predecessors are appended
+    map<size_t, int> waiting;
+    size_t next = 0;
+    for (int stopped = 0; stopped < parsers;) {
+        int b = parsed.pop();
+        if (b < 0) { stopped++; continue; }
+        waiting[pool[b].seq] = b;
+        for (auto it = waiting.begin(); it != waiting.end() && it->first == next; it = waiting.erase(it), next++) {
+            vector<Contact> &rows = pool[it->second].rows;
+            contacts.insert(contacts.end(), make_move_iterator(rows.begin()), make_move_iterator(rows.end()));
+            rows.clear();
+            free_buffers.push(it->second);
+        }
+    }
+    reader.join();
+    for (thread &t : workers) t.join();
+}
+
+// ---------------------------------------------------------------------------------------------
+// Unicode normalization of names for Bengali-script and accented Latin sources. Names are
+// validated as UTF-8 (bad bytes become U+FFFD), decomposed (canonically for NFC, also by
+// compatibility for NFKC), case folded, put in canonical order and recomposed. Once both the
+// names and the term are valid normalized UTF-8, a byte-wise find can only match on character
+// boundaries and canonically equivalent spellings compare equal. Pure-ASCII names skip all of
+// this except a vectorized lowercase. The tables cover Latin-1, Latin Extended-A/B and Additional,
+// Greek (the whole 0x370-0x3FF block, generated from UnicodeData and CaseFolding), Bengali, and
+// the common compatibility characters (spaces, ligatures, fullwidth forms).
+// ---------------------------------------------------------------------------------------------
+
+// Canonical decompositions {composed, base, mark or 0 for singletons, recomposes in NFC}
+const uint16_t CANONICAL_DECOMP[][4] = {
+    {0x00C0, 0x0041, 0x0300, 1}, {0x00C1, 0x0041, 0x0301, 1}, {0x00C2, 0x0041, 0x0302, 1}, {0x00C3, 0x0041, 0x0303, 1},
+    {0x00C4, 0x0041, 0x0308, 1}, {0x00C5, 0x0041, 0x030A, 1}, {0x00C7, 0x0043, 0x0327, 1}, {0x00C8, 0x0045, 0x0300, 1},
+    {0x00C9, 0x0045, 0x0301, 1}, {0x00CA, 0x0045, 0x0302, 1}, {0x00CB, 0x0045, 0x0308, 1}, {0x00CC, 0x0049, 0x0300, 1},
+    {0x00CD, 0x0049, 0x0301, 1}, {0x00CE, 0x0049, 0x0302, 1}, {0x00CF, 0x0049, 0x0308, 1}, {0x00D1, 0x004E, 0x0303, 1},
+    {0x00D2, 0x004F, 0x0300, 1}, {0x00D3, 0x004F, 0x0301, 1}, {0x00D4, 0x004F, 0x0302, 1}, {0x00D5, 0x004F, 0x0303, 1},
+    {0x00D6, 0x004F, 0x0308, 1}, {0x00D9, 0x0055, 0x0300, 1}, {0x00DA, 0x0055, 0x0301, 1}, {0x00DB, 0x0055, 0x0302, 1},
+    {0x00DC, 0x0055, 0x0308, 1}, {0x00DD, 0x0059, 0x0301, 1}, {0x00E0, 0x0061, 0x0300, 1}, {0x00E1, 0x0061, 0x0301, 1},
+    {0x00E2, 0x0061, 0x0302, 1}, {0x00E3, 0x0061, 0x0303, 1}, {0x00E4, 0x0061, 0x0308, 1}, {0x00E5, 0x0061, 0x030A, 1},
+    {0x00E7, 0x0063, 0x0327, 1}, {0x00E8, 0x0065, 0x0300, 1}, {0x00E9, 0x0065, 0x0301, 1}, {0x00EA, 0x0065, 0x0302, 1},
+    {0x00EB, 0x0065, 0x0308, 1}, {0x00EC, 0x0069, 0x0300, 1}, {0x00ED, 0x0069, 0x0301, 1}, {0x00EE, 0x0069, 0x0302, 1},
+    {0x00EF, 0x0069, 0x0308, 1}, {0x00F1, 0x006E, 0x0303, 1}, {0x00F2, 0x006F, 0x0300, 1}, {0x00F3, 0x006F, 0x0301, 1},
+    {0x00F4, 0x006F, 0x0302, 1}, {0x00F5, 0x006F, 0x0303, 1}, {0x00F6, 0x006F, 0x0308, 1}, {0x00F9, 0x0075, 0x0300, 1},
+    {0x00FA, 0x0075, 0x0301, 1}, {0x00FB, 0x0075, 0x0302, 1}, {0x00FC, 0x0075, 0x0308, 1}, {0x00FD, 0x0079, 0x0301, 1},
+    {0x00FF, 0x0079, 0x0308, 1}, {0x0100, 0x0041, 0x0304, 1}, {0x0101, 0x0061, 0x0304, 1}, {0x0102, 0x0041, 0x0306, 1},
+    {0x0103, 0x0061, 0x0306, 1}, {0x0104, 0x0041, 0x0328, 1}, {0x0105, 0x0061, 0x0328, 1}, {0x0106, 0x0043, 0x0301, 1},
+    {0x0107, 0x0063, 0x0301, 1}, {0x0108, 0x0043, 0x0302, 1}, {0x0109, 0x0063, 0x0302, 1}, {0x010A, 0x0043, 0x0307, 1},
+    {0x010B, 0x0063, 0x0307, 1}, {0x010C, 0x0043, 0x030C, 1}, {0x010D, 0x0063, 0x030C, 1}, {0x010E, 0x0044, 0x030C, 1},
+    {0x010F, 0x0064, 0x030C, 1}, {0x0112, 0x0045, 0x0304, 1}, {0x0113, 0x0065, 0x0304, 1}, {0x0114, 0x0045, 0x0306, 1},
+    {0x0115, 0x0065, 0x0306, 1}, {0x0116, 0x0045, 0x0307, 1}, {0x0117, 0x0065, 0x0307, 1}, {0x0118, 0x0045, 0x0328, 1},
+    {0x0119, 0x0065, 0x0328, 1}, {0x011A, 0x0045, 0x030C, 1}, {0x011B, 0x0065, 0x030C, 1}, {0x011C, 0x0047, 0x0302, 1},
+    {0x011D, 0x0067, 0x0302, 1}, {0x011E, 0x0047, 0x0306, 1}, {0x011F, 0x0067, 0x0306, 1}, {0x0120, 0x0047, 0x0307, 1},
+    {0x0121, 0x0067, 0x0307, 1}, {0x0122, 0x0047, 0x0327, 1}, {0x0123, 0x0067, 0x0327, 1}, {0x0124, 0x0048, 0x0302, 1},
+    {0x0125, 0x0068, 0x0302, 1}, {0x0128, 0x0049, 0x0303, 1}, {0x0129, 0x0069, 0x0303, 1}, {0x012A, 0x0049, 0x0304, 1},
+    {0x012B, 0x0069, 0x0304, 1}, {0x012C, 0x0049, 0x0306, 1}, {0x012D, 0x0069, 0x0306, 1}, {0x012E, 0x0049, 0x0328, 1},
+    {0x012F, 0x0069, 0x0328, 1}, {0x0130, 0x0049, 0x0307, 1}, {0x0134, 0x004A, 0x0302, 1}, {0x0135, 0x006A, 0x0302, 1},
+    {0x0136, 0x004B, 0x0327, 1}, {0x0137, 0x006B, 0x0327, 1}, {0x0139, 0x004C, 0x0301, 1}, {0x013A, 0x006C, 0x0301, 1},
+    {0x013B, 0x004C, 0x0327, 1}, {0x013C, 0x006C, 0x0327, 1}, {0x013D, 0x004C, 0x030C, 1}, {0x013E, 0x006C, 0x030C, 1},
+    {0x0143, 0x004E, 0x0301, 1}, {0x0144, 0x006E, 0x0301, 1}, {0x0145, 0x004E, 0x0327, 1}, {0x0146, 0x006E, 0x0327, 1},
+    {0x0147, 0x004E, 0x030C, 1}, {0x0148, 0x006E, 0x030C, 1}, {0x014C, 0x004F, 0x0304, 1}, {0x014D, 0x006F, 0x0304, 1},
+    {0x014E, 0x004F, 0x0306, 1}, {0x014F, 0x006F, 0x0306, 1}, {0x0150, 0x004F, 0x030B, 1}, {0x0151, 0x006F, 0x030B, 1},
+    {0x0154, 0x0052, 0x0301, 1}, {0x0155, 0x0072, 0x0301, 1}, {0x0156, 0x0052, 0x0327, 1}, {0x0157, 0x0072, 0x0327, 1},
+    {0x0158, 0x0052, 0x030C, 1}, {0x0159, 0x0072, 0x030C, 1}, {0x015A, 0x0053, 0x0301, 1}, {0x015B, 0x0073, 0x0301, 1},
+    {0x015C, 0x0053, 0x0302, 1}, {0x015D, 0x0073, 0x0302, 1}, {0x015E, 0x0053, 0x0327, 1}, {0x015F, 0x0073, 0x0327, 1},
+    {0x0160, 0x0053, 0x030C, 1}, {0x0161, 0x0073, 0x030C, 1}, {0x0162, 0x0054, 0x0327, 1}, {0x0163, 0x0074, 0x0327, 1},
+    {0x0164, 0x0054, 0x030C, 1}, {0x0165, 0x0074, 0x030C, 1}, {0x0168, 0x0055, 0x0303, 1}, {0x0169, 0x0075, 0x0303, 1},
+    {0x016A, 0x0055, 0x0304, 1}, {0x016B, 0x0075, 0x0304, 1}, {0x016C, 0x0055, 0x0306, 1}, {0x016D, 0x0075, 0x0306, 1},
+    {0x016E, 0x0055, 0x030A, 1}, {0x016F, 0x0075, 0x030A, 1}, {0x0170, 0x0055, 0x030B, 1}, {0x0171, 0x0075, 0x030B, 1},
+    {0x0172, 0x0055, 0x0328, 1}, {0x0173, 0x0075, 0x0328, 1}, {0x0174, 0x0057, 0x0302, 1}, {0x0175, 0x0077, 0x0302, 1},
+    {0x0176, 0x0059, 0x0302, 1}, {0x0177, 0x0079, 0x0302, 1}, {0x0178, 0x0059, 0x0308, 1}, {0x0179, 0x005A, 0x0301, 1},
+    {0x017A, 0x007A, 0x0301, 1}, {0x017B, 0x005A, 0x0307, 1}, {0x017C, 0x007A, 0x0307, 1}, {0x017D, 0x005A, 0x030C, 1},
+    {0x017E, 0x007A, 0x030C, 1}, {0x01A0, 0x004F, 0x031B, 1}, {0x01A1, 0x006F, 0x031B, 1}, {0x01AF, 0x0055, 0x031B, 1},
+    {0x01B0, 0x0075, 0x031B, 1}, {0x01CD, 0x0041, 0x030C, 1}, {0x01CE, 0x0061, 0x030C, 1}, {0x01CF, 0x0049, 0x030C, 1},
+    {0x01D0, 0x0069, 0x030C, 1}, {0x01D1, 0x004F, 0x030C, 1}, {0x01D2, 0x006F, 0x030C, 1}, {0x01D3, 0x0055, 0x030C, 1},
+    {0x01D4, 0x0075, 0x030C, 1}, {0x01D5, 0x00DC, 0x0304, 1}, {0x01D6, 0x00FC, 0x0304, 1}, {0x01D7, 0x00DC, 0x0301, 1},
+    {0x01D8, 0x00FC, 0x0301, 1}, {0x01D9, 0x00DC, 0x030C, 1}, {0x01DA, 0x00FC, 0x030C, 1}, {0x01DB, 0x00DC, 0x0300, 1},
+    {0x01DC, 0x00FC, 0x0300, 1}, {0x01DE, 0x00C4, 0x0304, 1}, {0x01DF, 0x00E4, 0x0304, 1}, {0x01E0, 0x0226, 0x0304, 1},
+    {0x01E1, 0x0227, 0x0304, 1}, {0x01E2, 0x00C6, 0x0304, 1}, {0x01E3, 0x00E6, 0x0304, 1}, {0x01E6, 0x0047, 0x030C, 1},
+    {0x01E7, 0x0067, 0x030C, 1}, {0x01E8, 0x004B, 0x030C, 1}, {0x01E9, 0x006B, 0x030C, 1}, {0x01EA, 0x004F, 0x0328, 1},
+    {0x01EB, 0x006F, 0x0328, 1}, {0x01EC, 0x01EA, 0x0304, 1}, {0x01ED, 0x01EB, 0x0304, 1}, {0x01EE, 0x01B7, 0x030C, 1},
+    {0x01EF, 0x0292, 0x030C, 1}, {0x01F0, 0x006A, 0x030C, 1}, {0x01F4, 0x0047, 0x0301, 1}, {0x01F5, 0x0067, 0x0301, 1},
+    {0x01F8, 0x004E, 0x0300, 1}, {0x01F9, 0x006E, 0x0300, 1}, {0x01FA, 0x00C5, 0x0301, 1}, {0x01FB, 0x00E5, 0x0301, 1},
+    {0x01FC, 0x00C6, 0x0301, 1}, {0x01FD, 0x00E6, 0x0301, 1}, {0x01FE, 0x00D8, 0x0301, 1}, {0x01FF, 0x00F8, 0x0301, 1},
+    {0x0200, 0x0041, 0x030F, 1}, {0x0201, 0x0061, 0x030F, 1}, {0x0202, 0x0041, 0x0311, 1}, {0x0203, 0x0061, 0x0311, 1},
+    {0x0204, 0x0045, 0x030F, 1}, {0x0205, 0x0065, 0x030F, 1}, {0x0206, 0x0045, 0x0311, 1}, {0x0207, 0x0065, 0x0311, 1},
+    {0x0208, 0x0049, 0x030F, 1}, {0x0209, 0x0069, 0x030F, 1}, {0x020A, 0x0049, 0x0311, 1}, {0x020B, 0x0069, 0x0311, 1},
+    {0x020C, 0x004F, 0x030F, 1}, {0x020D, 0x006F, 0x030F, 1}, {0x020E, 0x004F, 0x0311, 1}, {0x020F, 0x006F, 0x0311, 1},
+    {0x0210, 0x0052, 0x030F, 1}, {0x0211, 0x0072, 0x030F, 1}, {0x0212, 0x0052, 0x0311, 1}, {0x0213, 0x0072, 0x0311, 1},
+    {0x0214, 0x0055, 0x030F, 1}, {0x0215, 0x0075, 0x030F, 1}, {0x0216, 0x0055, 0x0311, 1}, {0x0217, 0x0075, 0x0311, 1},
+    {0x0218, 0x0053, 0x0326, 1}, {0x0219, 0x0073, 0x0326, 1}, {0x021A, 0x0054, 0x0326, 1}, {0x021B, 0x0074, 0x0326, 1},
+    {0x021E, 0x0048, 0x030C, 1}, {0x021F, 0x0068, 0x030C, 1}, {0x0226, 0x0041, 0x0307, 1}, {0x0227, 0x0061, 0x0307, 1},
+    {0x0228, 0x0045, 0x0327, 1}, {0x0229, 0x0065, 0x0327, 1}, {0x022A, 0x00D6, 0x0304, 1}, {0x022B, 0x00F6, 0x0304, 1},
+    {0x022C, 0x00D5, 0x0304, 1}, {0x022D, 0x00F5, 0x0304, 1}, {0x022E, 0x004F, 0x0307, 1}, {0x022F, 0x006F, 0x0307, 1},
+    {0x0230, 0x022E, 0x0304, 1}, {0x0231, 0x022F, 0x0304, 1}, {0x0232, 0x0059, 0x0304, 1}, {0x0233, 0x0079, 0x0304, 1},
+    {0x0340, 0x0300, 0x0000, 0}, {0x0341, 0x0301, 0x0000, 0}, {0x0343, 0x0313, 0x0000, 0}, {0x0344, 0x0308, 0x0301, 0},
+    {0x0374, 0x02B9, 0x0000, 0}, {0x037E, 0x003B, 0x0000, 0}, {0x0385, 0x00A8, 0x0301, 1}, {0x0386, 0x0391, 0x0301, 1},
+    {0x0387, 0x00B7, 0x0000, 0}, {0x0388, 0x0395, 0x0301, 1}, {0x0389, 0x0397, 0x0301, 1}, {0x038A, 0x0399, 0x0301, 1},
+    {0x038C, 0x039F, 0x0301, 1}, {0x038E, 0x03A5, 0x0301, 1}, {0x038F, 0x03A9, 0x0301, 1}, {0x0390, 0x03CA, 0x0301, 1},
+    {0x03AA, 0x0399, 0x0308, 1}, {0x03AB, 0x03A5, 0x0308, 1}, {0x03AC, 0x03B1, 0x0301, 1}, {0x03AD, 0x03B5, 0x0301, 1},
+    {0x03AE, 0x03B7, 0x0301, 1}, {0x03AF, 0x03B9, 0x0301, 1}, {0x03B0, 0x03CB, 0x0301, 1}, {0x03CA, 0x03B9, 0x0308, 1},
+    {0x03CB, 0x03C5, 0x0308, 1}, {0x03CC, 0x03BF, 0x0301, 1}, {0x03CD, 0x03C5, 0x0301, 1}, {0x03CE, 0x03C9, 0x0301, 1},
+    {0x03D3, 0x03D2, 0x0301, 1}, {0x03D4, 0x03D2, 0x0308, 1},
+    {0x09CB, 0x09C7, 0x09BE, 1}, {0x09CC, 0x09C7, 0x09D7, 1}, {0x09DC, 0x09A1, 0x09BC, 0}, {0x09DD, 0x09A2, 0x09BC, 0},
+    {0x09DF, 0x09AF, 0x09BC, 0}, {0x1E00, 0x0041, 0x0325, 1}, {0x1E01, 0x0061, 0x0325, 1}, {0x1E02, 0x0042, 0x0307, 1},
+    {0x1E03, 0x0062, 0x0307, 1}, {0x1E04, 0x0042, 0x0323, 1}, {0x1E05, 0x0062, 0x0323, 1}, {0x1E06, 0x0042, 0x0331, 1},
+    {0x1E07, 0x0062, 0x0331, 1}, {0x1E08, 0x00C7, 0x0301, 1}, {0x1E09, 0x00E7, 0x0301, 1}, {0x1E0A, 0x0044, 0x0307, 1},
+    {0x1E0B, 0x0064, 0x0307, 1}, {0x1E0C, 0x0044, 0x0323, 1}, {0x1E0D, 0x0064, 0x0323, 1}, {0x1E0E, 0x0044, 0x0331, 1},
+    {0x1E0F, 0x0064, 0x0331, 1}, {0x1E10, 0x0044, 0x0327, 1}, {0x1E11, 0x0064, 0x0327, 1}, {0x1E12, 0x0044, 0x032D, 1},
+    {0x1E13, 0x0064, 0x032D, 1}, {0x1E14, 0x0112, 0x0300, 1}, {0x1E15, 0x0113, 0x0300, 1}, {0x1E16, 0x0112, 0x0301, 1},
+    {0x1E17, 0x0113, 0x0301, 1}, {0x1E18, 0x0045, 0x032D, 1}, {0x1E19, 0x0065, 0x032D, 1}, {0x1E1A, 0x0045, 0x0330, 1},
+    {0x1E1B, 0x0065, 0x0330, 1}, {0x1E1C, 0x0228, 0x0306, 1}, {0x1E1D, 0x0229, 0x0306, 1}, {0x1E1E, 0x0046, 0x0307, 1},
+    {0x1E1F, 0x0066, 0x0307, 1}, {0x1E20, 0x0047, 0x0304, 1}, {0x1E21, 0x0067, 0x0304, 1}, {0x1E22, 0x0048, 0x0307, 1},
+    {0x1E23, 0x0068, 0x0307, 1}, {0x1E24, 0x0048, 0x0323, 1}, {0x1E25, 0x0068, 0x0323, 1}, {0x1E26, 0x0048, 0x0308, 1},
+    {0x1E27, 0x0068, 0x0308, 1}, {0x1E28, 0x0048, 0x0327, 1}, {0x1E29, 0x0068, 0x0327, 1}, {0x1E2A, 0x0048, 0x032E, 1},
+    {0x1E2B, 0x0068, 0x032E, 1}, {0x1E2C, 0x0049, 0x0330, 1}, {0x1E2D, 0x0069, 0x0330, 1}, {0x1E2E, 0x00CF, 0x0301, 1},
+    {0x1E2F, 0x00EF, 0x0301, 1}, {0x1E30, 0x004B, 0x0301, 1}, {0x1E31, 0x006B, 0x0301, 1}, {0x1E32, 0x004B, 0x0323, 1},
+    {0x1E33, 0x006B, 0x0323, 1}, {0x1E34, 0x004B, 0x0331, 1}, {0x1E35, 0x006B, 0x0331, 1}, {0x1E36, 0x004C, 0x0323, 1},
+    {0x1E37, 0x006C, 0x0323, 1}, {0x1E38, 0x1E36, 0x0304, 1}, {0x1E39, 0x1E37, 0x0304, 1}, {0x1E3A, 0x004C, 0x0331, 1},
+    {0x1E3B, 0x006C, 0x0331, 1}, {0x1E3C, 0x004C, 0x032D, 1}, {0x1E3D, 0x006C, 0x032D, 1}, {0x1E3E, 0x004D, 0x0301, 1},
+    {0x1E3F, 0x006D, 0x0301, 1}, {0x1E40, 0x004D, 0x0307, 1}, {0x1E41, 0x006D, 0x0307, 1}, {0x1E42, 0x004D, 0x0323, 1},
+    {0x1E43, 0x006D, 0x0323, 1}, {0x1E44, 0x004E, 0x0307, 1}, {0x1E45, 0x006E, 0x0307, 1}, {0x1E46, 0x004E, 0x0323, 1},
+    {0x1E47, 0x006E, 0x0323, 1}, {0x1E48, 0x004E, 0x0331, 1}, {0x1E49, 0x006E, 0x0331, 1}, {0x1E4A, 0x004E, 0x032D, 1},
+    {0x1E4B, 0x006E, 0x032D, 1}, {0x1E4C, 0x00D5, 0x0301, 1}, {0x1E4D, 0x00F5, 0x0301, 1}, {0x1E4E, 0x00D5, 0x0308, 1},
+    {0x1E4F, 0x00F5, 0x0308, 1}, {0x1E50, 0x014C, 0x0300, 1}, {0x1E51, 0x014D, 0x0300, 1}, {0x1E52, 0x014C, 0x0301, 1},
+    {0x1E53, 0x014D, 0x0301, 1}, {0x1E54, 0x0050, 0x0301, 1}, {0x1E55, 0x0070, 0x0301, 1}, {0x1E56, 0x0050, 0x0307, 1},
+    {0x1E57, 0x0070, 0x0307, 1}, {0x1E58, 0x0052, 0x0307, 1}, {0x1E59, 0x0072, 0x0307, 1}, {0x1E5A, 0x0052, 0x0323, 1},
+    {0x1E5B, 0x0072, 0x0323, 1}, {0x1E5C, 0x1E5A, 0x0304, 1}, {0x1E5D, 0x1E5B, 0x0304, 1}, {0x1E5E, 0x0052, 0x0331, 1},
+    {0x1E5F, 0x0072, 0x0331, 1}, {0x1E60, 0x0053, 0x0307, 1}, {0x1E61, 0x0073, 0x0307, 1}, {0x1E62, 0x0053, 0x0323, 1},
+    {0x1E63, 0x0073, 0x0323, 1}, {0x1E64, 0x015A, 0x0307, 1}, {0x1E65, 0x015B, 0x0307, 1}, {0x1E66, 0x0160, 0x0307, 1},
+    {0x1E67, 0x0161, 0x0307, 1}, {0x1E68, 0x1E62, 0x0307, 1}, {0x1E69, 0x1E63, 0x0307, 1}, {0x1E6A, 0x0054, 0x0307, 1},
+    {0x1E6B, 0x0074, 0x0307, 1}, {0x1E6C, 0x0054, 0x0323, 1}, {0x1E6D, 0x0074, 0x0323, 1}, {0x1E6E, 0x0054, 0x0331, 1},
+    {0x1E6F, 0x0074, 0x0331, 1}, {0x1E70, 0x0054, 0x032D, 1}, {0x1E71, 0x0074, 0x032D, 1}, {0x1E72, 0x0055, 0x0324, 1},
+    {0x1E73, 0x0075, 0x0324, 1}, {0x1E74, 0x0055, 0x0330, 1}, {0x1E75, 0x0075, 0x0330, 1}, {0x1E76, 0x0055, 0x032D, 1},
+    {0x1E77, 0x0075, 0x032D, 1}, {0x1E78, 0x0168, 0x0301, 1}, {0x1E79, 0x0169, 0x0301, 1}, {0x1E7A, 0x016A, 0x0308, 1},
+    {0x1E7B, 0x016B, 0x0308, 1}, {0x1E7C, 0x0056, 0x0303, 1}, {0x1E7D, 0x0076, 0x0303, 1}, {0x1E7E, 0x0056, 0x0323, 1},
+    {0x1E7F, 0x0076, 0x0323, 1}, {0x1E80, 0x0057, 0x0300, 1}, {0x1E81, 0x0077, 0x0300, 1}, {0x1E82, 0x0057, 0x0301, 1},
+    {0x1E83, 0x0077, 0x0301, 1}, {0x1E84, 0x0057, 0x0308, 1}, {0x1E85, 0x0077, 0x0308, 1}, {0x1E86, 0x0057, 0x0307, 1},
+    {0x1E87, 0x0077, 0x0307, 1}, {0x1E88, 0x0057, 0x0323, 1}, {0x1E89, 0x0077, 0x0323, 1}, {0x1E8A, 0x0058, 0x0307, 1},
+    {0x1E8B, 0x0078, 0x0307, 1}, {0x1E8C, 0x0058, 0x0308, 1}, {0x1E8D, 0x0078, 0x0308, 1}, {0x1E8E, 0x0059, 0x0307, 1},
+    {0x1E8F, 0x0079, 0x0307, 1}, {0x1E90, 0x005A, 0x0302, 1}, {0x1E91, 0x007A, 0x0302, 1}, {0x1E92, 0x005A, 0x0323, 1},
+    {0x1E93, 0x007A, 0x0323, 1}, {0x1E94, 0x005A, 0x0331, 1}, {0x1E95, 0x007A, 0x0331, 1}, {0x1E96, 0x0068, 0x0331, 1},
+    {0x1E97, 0x0074, 0x0308, 1}, {0x1E98, 0x0077, 0x030A, 1}, {0x1E99, 0x0079, 0x030A, 1}, {0x1E9B, 0x017F, 0x0307, 1},
+    {0x1EA0, 0x0041, 0x0323, 1}, {0x1EA1, 0x0061, 0x0323, 1}, {0x1EA2, 0x0041, 0x0309, 1}, {0x1EA3, 0x0061, 0x0309, 1},
+    {0x1EA4, 0x00C2, 0x0301, 1}, {0x1EA5, 0x00E2, 0x0301, 1}, {0x1EA6, 0x00C2, 0x0300, 1}, {0x1EA7, 0x00E2, 0x0300, 1},
+    {0x1EA8, 0x00C2, 0x0309, 1}, {0x1EA9, 0x00E2, 0x0309, 1}, {0x1EAA, 0x00C2, 0x0303, 1}, {0x1EAB, 0x00E2, 0x0303, 1},
+    {0x1EAC, 0x1EA0, 0x0302, 1}, {0x1EAD, 0x1EA1, 0x0302, 1}, {0x1EAE, 0x0102, 0x0301, 1}, {0x1EAF, 0x0103, 0x0301, 1},
+    {0x1EB0, 0x0102, 0x0300, 1}, {0x1EB1, 0x0103, 0x0300, 1}, {0x1EB2, 0x0102, 0x0309, 1}, {0x1EB3, 0x0103, 0x0309, 1},
+    {0x1EB4, 0x0102, 0x0303, 1}, {0x1EB5, 0x0103, 0x0303, 1}, {0x1EB6, 0x1EA0, 0x0306, 1}, {0x1EB7, 0x1EA1, 0x0306, 1},
+    {0x1EB8, 0x0045, 0x0323, 1}, {0x1EB9, 0x0065, 0x0323, 1}, {0x1EBA, 0x0045, 0x0309, 1}, {0x1EBB, 0x0065, 0x0309, 1},
+    {0x1EBC, 0x0045, 0x0303, 1}, {0x1EBD, 0x0065, 0x0303, 1}, {0x1EBE, 0x00CA, 0x0301, 1}, {0x1EBF, 0x00EA, 0x0301, 1},
+    {0x1EC0, 0x00CA, 0x0300, 1}, {0x1EC1, 0x00EA, 0x0300, 1}, {0x1EC2, 0x00CA, 0x0309, 1}, {0x1EC3, 0x00EA, 0x0309, 1},
+    {0x1EC4, 0x00CA, 0x0303, 1}, {0x1EC5, 0x00EA, 0x0303, 1}, {0x1EC6, 0x1EB8, 0x0302, 1}, {0x1EC7, 0x1EB9, 0x0302, 1},
+    {0x1EC8, 0x0049, 0x0309, 1}, {0x1EC9, 0x0069, 0x0309, 1}, {0x1ECA, 0x0049, 0x0323, 1}, {0x1ECB, 0x0069, 0x0323, 1},
+    {0x1ECC, 0x004F, 0x0323, 1}, {0x1ECD, 0x006F, 0x0323, 1}, {0x1ECE, 0x004F, 0x0309, 1}, {0x1ECF, 0x006F, 0x0309, 1},
+    {0x1ED0, 0x00D4, 0x0301, 1}, {0x1ED1, 0x00F4, 0x0301, 1}, {0x1ED2, 0x00D4, 0x0300, 1}, {0x1ED3, 0x00F4, 0x0300, 1},
+    {0x1ED4, 0x00D4, 0x0309, 1}, {0x1ED5, 0x00F4, 0x0309, 1}, {0x1ED6, 0x00D4, 0x0303, 1}, {0x1ED7, 0x00F4, 0x0303, 1},
+    {0x1ED8, 0x1ECC, 0x0302, 1}, {0x1ED9, 0x1ECD, 0x0302, 1}, {0x1EDA, 0x01A0, 0x0301, 1}, {0x1EDB, 0x01A1, 0x0301, 1},
+    {0x1EDC, 0x01A0, 0x0300, 1}, {0x1EDD, 0x01A1, 0x0300, 1}, {0x1EDE, 0x01A0, 0x0309, 1}, {0x1EDF, 0x01A1, 0x0309, 1},
+    {0x1EE0, 0x01A0, 0x0303, 1}, {0x1EE1, 0x01A1, 0x0303, 1}, {0x1EE2, 0x01A0, 0x0323, 1}, {0x1EE3, 0x01A1, 0x0323, 1},
+    {0x1EE4, 0x0055, 0x0323, 1}, {0x1EE5, 0x0075, 0x0323, 1}, {0x1EE6, 0x0055, 0x0309, 1}, {0x1EE7, 0x0075, 0x0309, 1},
+    {0x1EE8, 0x01AF, 0x0301, 1}, {0x1EE9, 0x01B0, 0x0301, 1}, {0x1EEA, 0x01AF, 0x0300, 1}, {0x1EEB, 0x01B0, 0x0300, 1},
+    {0x1EEC, 0x01AF, 0x0309, 1}, {0x1EED, 0x01B0, 0x0309, 1}, {0x1EEE, 0x01AF, 0x0303, 1}, {0x1EEF, 0x01B0, 0x0303, 1},
+    {0x1EF0, 0x01AF, 0x0323, 1}, {0x1EF1, 0x01B0, 0x0323, 1}, {0x1EF2, 0x0059, 0x0300, 1}, {0x1EF3, 0x0079, 0x0300, 1},
+    {0x1EF4, 0x0059, 0x0323, 1}, {0x1EF5, 0x0079, 0x0323, 1}, {0x1EF6, 0x0059, 0x0309, 1}, {0x1EF7, 0x0079, 0x0309, 1},
+    {0x1EF8, 0x0059, 0x0303, 1}, {0x1EF9, 0x0079, 0x0303, 1},
+};
+
+// Case folds of characters that do not decompose {character, fold, up to two more code points or 0}
+const uint16_t CASE_FOLD[][4] = {
+    {0x00B5, 0x03BC, 0x0000, 0x0000}, {0x00C6, 0x00E6, 0x0000, 0x0000}, {0x00D0, 0x00F0, 0x0000, 0x0000}, {0x00D8, 0x00F8, 0x0000, 0x0000},
+    {0x00DE, 0x00FE, 0x0000, 0x0000}, {0x00DF, 0x0073, 0x0073, 0x0000}, {0x0110, 0x0111, 0x0000, 0x0000}, {0x0126, 0x0127, 0x0000, 0x0000},
+    {0x0132, 0x0133, 0x0000, 0x0000}, {0x013F, 0x0140, 0x0000, 0x0000}, {0x0141, 0x0142, 0x0000, 0x0000}, {0x0149, 0x02BC, 0x006E, 0x0000},
+    {0x014A, 0x014B, 0x0000, 0x0000}, {0x0152, 0x0153, 0x0000, 0x0000}, {0x0166, 0x0167, 0x0000, 0x0000}, {0x017F, 0x0073, 0x0000, 0x0000},
+    {0x0181, 0x0253, 0x0000, 0x0000}, {0x0182, 0x0183, 0x0000, 0x0000}, {0x0184, 0x0185, 0x0000, 0x0000}, {0x0186, 0x0254, 0x0000, 0x0000},
+    {0x0187, 0x0188, 0x0000, 0x0000}, {0x0189, 0x0256, 0x0000, 0x0000}, {0x018A, 0x0257, 0x0000, 0x0000}, {0x018B, 0x018C, 0x0000, 0x0000},
+    {0x018E, 0x01DD, 0x0000, 0x0000}, {0x018F, 0x0259, 0x0000, 0x0000}, {0x0190, 0x025B, 0x0000, 0x0000}, {0x0191, 0x0192, 0x0000, 0x0000},
+    {0x0193, 0x0260, 0x0000, 0x0000}, {0x0194, 0x0263, 0x0000, 0x0000}, {0x0196, 0x0269, 0x0000, 0x0000}, {0x0197, 0x0268, 0x0000, 0x0000},
+    {0x0198, 0x0199, 0x0000, 0x0000}, {0x019C, 0x026F, 0x0000, 0x0000}, {0x019D, 0x0272, 0x0000, 0x0000}, {0x019F, 0x0275, 0x0000, 0x0000},
+    {0x01A2, 0x01A3, 0x0000, 0x0000}, {0x01A4, 0x01A5, 0x0000, 0x0000}, {0x01A6, 0x0280, 0x0000, 0x0000}, {0x01A7, 0x01A8, 0x0000, 0x0000},
+    {0x01A9, 0x0283, 0x0000, 0x0000}, {0x01AC, 0x01AD, 0x0000, 0x0000}, {0x01AE, 0x0288, 0x0000, 0x0000}, {0x01B1, 0x028A, 0x0000, 0x0000},
+    {0x01B2, 0x028B, 0x0000, 0x0000}, {0x01B3, 0x01B4, 0x0000, 0x0000}, {0x01B5, 0x01B6, 0x0000, 0x0000}, {0x01B7, 0x0292, 0x0000, 0x0000},
+    {0x01B8, 0x01B9, 0x0000, 0x0000}, {0x01BC, 0x01BD, 0x0000, 0x0000}, {0x01C4, 0x01C6, 0x0000, 0x0000}, {0x01C5, 0x01C6, 0x0000, 0x0000},
+    {0x01C7, 0x01C9, 0x0000, 0x0000}, {0x01C8, 0x01C9, 0x0000, 0x0000}, {0x01CA, 0x01CC, 0x0000, 0x0000}, {0x01CB, 0x01CC, 0x0000, 0x0000},
+    {0x01E4, 0x01E5, 0x0000, 0x0000}, {0x01F1, 0x01F3, 0x0000, 0x0000}, {0x01F2, 0x01F3, 0x0000, 0x0000}, {0x01F6, 0x0195, 0x0000, 0x0000},
+    {0x01F7, 0x01BF, 0x0000, 0x0000}, {0x021C, 0x021D, 0x0000, 0x0000}, {0x0220, 0x019E, 0x0000, 0x0000}, {0x0222, 0x0223, 0x0000, 0x0000},
+    {0x0224, 0x0225, 0x0000, 0x0000}, {0x023A, 0x2C65, 0x0000, 0x0000}, {0x023B, 0x023C, 0x0000, 0x0000}, {0x023D, 0x019A, 0x0000, 0x0000},
+    {0x023E, 0x2C66, 0x0000, 0x0000}, {0x0241, 0x0242, 0x0000, 0x0000}, {0x0243, 0x0180, 0x0000, 0x0000}, {0x0244, 0x0289, 0x0000, 0x0000},
+    {0x0245, 0x028C, 0x0000, 0x0000}, {0x0246, 0x0247, 0x0000, 0x0000}, {0x0248, 0x0249, 0x0000, 0x0000}, {0x024A, 0x024B, 0x0000, 0x0000},
+    {0x024C, 0x024D, 0x0000, 0x0000}, {0x024E, 0x024F, 0x0000, 0x0000}, {0x0345, 0x03B9, 0x0000, 0x0000}, {0x0370, 0x0371, 0x0000, 0x0000},
+    {0x0372, 0x0373, 0x0000, 0x0000}, {0x0376, 0x0377, 0x0000, 0x0000}, {0x037F, 0x03F3, 0x0000, 0x0000}, {0x03C2, 0x03C3, 0x0000, 0x0000},
+    {0x03CF, 0x03D7, 0x0000, 0x0000}, {0x03D0, 0x03B2, 0x0000, 0x0000}, {0x03D1, 0x03B8, 0x0000, 0x0000}, {0x03D5, 0x03C6, 0x0000, 0x0000},
+    {0x03D6, 0x03C0, 0x0000, 0x0000}, {0x03D8, 0x03D9, 0x0000, 0x0000}, {0x03DA, 0x03DB, 0x0000, 0x0000}, {0x03DC, 0x03DD, 0x0000, 0x0000},
+    {0x03DE, 0x03DF, 0x0000, 0x0000}, {0x03E0, 0x03E1, 0x0000, 0x0000}, {0x03E2, 0x03E3, 0x0000, 0x0000}, {0x03E4, 0x03E5, 0x0000, 0x0000},
+    {0x03E6, 0x03E7, 0x0000, 0x0000}, {0x03E8, 0x03E9, 0x0000, 0x0000}, {0x03EA, 0x03EB, 0x0000, 0x0000}, {0x03EC, 0x03ED, 0x0000, 0x0000},
+    {0x03EE, 0x03EF, 0x0000, 0x0000}, {0x03F0, 0x03BA, 0x0000, 0x0000}, {0x03F1, 0x03C1, 0x0000, 0x0000}, {0x03F4, 0x03B8, 0x0000, 0x0000},
+    {0x03F5, 0x03B5, 0x0000, 0x0000}, {0x03F7, 0x03F8, 0x0000, 0x0000}, {0x03F9, 0x03F2, 0x0000, 0x0000}, {0x03FA, 0x03FB, 0x0000, 0x0000},
+    {0x03FD, 0x037B, 0x0000, 0x0000}, {0x03FE, 0x037C, 0x0000, 0x0000}, {0x03FF, 0x037D, 0x0000, 0x0000}, {0x1E9A, 0x0061, 0x02BE, 0x0000},
+    {0x1E9E, 0x0073, 0x0073, 0x0000}, {0x1EFA, 0x1EFB, 0x0000, 0x0000}, {0x1EFC, 0x1EFD, 0x0000, 0x0000}, {0x1EFE, 0x1EFF, 0x0000, 0x0000},
+    {0xFB00, 0x0066, 0x0066, 0x0000}, {0xFB01, 0x0066, 0x0069, 0x0000}, {0xFB02, 0x0066, 0x006C, 0x0000}, {0xFB03, 0x0066, 0x0066, 0x0069},
+    {0xFB04, 0x0066, 0x0066, 0x006C}, {0xFB05, 0x0073, 0x0074, 0x0000}, {0xFB06, 0x0073, 0x0074, 0x0000},
+};
+
+// Compatibility decompositions used by NFKC {character, replacement (zero-terminated)}
+const struct { uint16_t cp, to[4]; } COMPAT_DECOMP[] = {
+    {0x00A0, {0x0020}}, {0x00A8, {0x0020, 0x0308}}, {0x00AA, {0x0061}}, {0x00AF, {0x0020, 0x0304}},
+    {0x00B2, {0x0032}}, {0x00B3, {0x0033}}, {0x00B4, {0x0020, 0x0301}}, {0x00B5, {0x03BC}},
+    {0x00B8, {0x0020, 0x0327}}, {0x00B9, {0x0031}}, {0x00BA, {0x006F}}, {0x00BC, {0x0031, 0x2044, 0x0034}},
+    {0x00BD, {0x0031, 0x2044, 0x0032}}, {0x00BE, {0x0033, 0x2044, 0x0034}}, {0x0132, {0x0049, 0x004A}}, {0x0133, {0x0069, 0x006A}},
+    {0x013F, {0x004C, 0x00B7}}, {0x0140, {0x006C, 0x00B7}}, {0x0149, {0x02BC, 0x006E}}, {0x017F, {0x0073}},
+    {0x01C4, {0x0044, 0x005A, 0x030C}}, {0x01C5, {0x0044, 0x007A, 0x030C}}, {0x01C6, {0x0064, 0x007A, 0x030C}}, {0x01C7, {0x004C, 0x004A}},
+    {0x01C8, {0x004C, 0x006A}}, {0x01C9, {0x006C, 0x006A}}, {0x01CA, {0x004E, 0x004A}}, {0x01CB, {0x004E, 0x006A}},
+    {0x01CC, {0x006E, 0x006A}}, {0x01F1, {0x0044, 0x005A}}, {0x01F2, {0x0044, 0x007A}}, {0x01F3, {0x0064, 0x007A}},
+    {0x037A, {0x0020, 0x0345}}, {0x0384, {0x0020, 0x0301}}, {0x03D0, {0x03B2}}, {0x03D1, {0x03B8}},
+    {0x03D2, {0x03A5}}, {0x03D5, {0x03C6}}, {0x03D6, {0x03C0}}, {0x03F0, {0x03BA}},
+    {0x03F1, {0x03C1}}, {0x03F2, {0x03C2}}, {0x03F4, {0x0398}}, {0x03F5, {0x03B5}},
+    {0x03F9, {0x03A3}},
+    {0x2002, {0x0020}}, {0x2003, {0x0020}}, {0x2004, {0x0020}}, {0x2005, {0x0020}},
+    {0x2006, {0x0020}}, {0x2007, {0x0020}}, {0x2008, {0x0020}}, {0x2009, {0x0020}},
+    {0x200A, {0x0020}}, {0x2011, {0x2010}}, {0x2017, {0x0020, 0x0333}}, {0x2024, {0x002E}},
+    {0x2025, {0x002E, 0x002E}}, {0x2026, {0x002E, 0x002E, 0x002E}}, {0x202F, {0x0020}}, {0x2033, {0x2032, 0x2032}},
+    {0x2034, {0x2032, 0x2032, 0x2032}}, {0x2036, {0x2035, 0x2035}}, {0x2037, {0x2035, 0x2035, 0x2035}}, {0x203C, {0x0021, 0x0021}},
+    {0x203E, {0x0020, 0x0305}}, {0x2047, {0x003F, 0x003F}}, {0x2048, {0x003F, 0x0021}}, {0x2049, {0x0021, 0x003F}},
+    {0x2057, {0x2032, 0x2032, 0x2032, 0x2032}}, {0x205F, {0x0020}}, {0xFB00, {0x0066, 0x0066}}, {0xFB01, {0x0066, 0x0069}},
+    {0xFB02, {0x0066, 0x006C}}, {0xFB03, {0x0066, 0x0066, 0x0069}}, {0xFB04, {0x0066, 0x0066, 0x006C}}, {0xFB05, {0x0073, 0x0074}},
+    {0xFB06, {0x0073, 0x0074}},
+};
+
+// Canonical combining classes {first, last, class} of the combining marks in the covered scripts
+const uint16_t COMBINING_CLASS[][3] = {
+    {0x0300, 0x0314, 230}, {0x0315, 0x0315, 232}, {0x0316, 0x0319, 220}, {0x031A, 0x031A, 232}, {0x031B, 0x031B, 216},
+    {0x031C, 0x0320, 220}, {0x0321, 0x0322, 202}, {0x0323, 0x0326, 220}, {0x0327, 0x0328, 202}, {0x0329, 0x0333, 220},
+    {0x0334, 0x0338, 1}, {0x0339, 0x033C, 220}, {0x033D, 0x0344, 230}, {0x0345, 0x0345, 240}, {0x0346, 0x0346, 230},
+    {0x0347, 0x0349, 220}, {0x034A, 0x034C, 230}, {0x034D, 0x034E, 220}, {0x0350, 0x0352, 230}, {0x0353, 0x0356, 220},
+    {0x0357, 0x0357, 230}, {0x0358, 0x0358, 232}, {0x0359, 0x035A, 220}, {0x035B, 0x035B, 230}, {0x035C, 0x035C, 233},
+    {0x035D, 0x035E, 234}, {0x035F, 0x035F, 233}, {0x0360, 0x0361, 234}, {0x0362, 0x0362, 233}, {0x0363, 0x036F, 230},
+    {0x09BC, 0x09BC, 7}, {0x09CD, 0x09CD, 9}, {0x09FE, 0x09FE, 230},
+};
+
+// Canonical combining class of a code point (0 for starters and anything outside the tables)
+int combining_class(uint32_t cp) {
+    for (auto &r : COMBINING_CLASS)
+        if (cp >= r[0] && cp <= r[1]) return r[2];
+    return 0;
+}
+
+// True if the bytes are all ASCII; checks 16 bytes per step with SSE2
+bool is_ascii(const char *p, size_t n) {
+    size_t i = 0;
+#ifdef __SSE2__
+    __m128i acc = _mm_setzero_si128();
+    for (; i + 16 <= n; i += 16) acc = _mm_or_si128(acc, _mm_loadu_si128((const __m128i *)(p + i)));
+    if (_mm_movemask_epi8(acc)) return false;       // Some byte had its top bit set
+#endif
+    for (; i < n; i++)
+        if (p[i] & 0x80) return false;
+    return true;
+}
+
+// Lowercases ASCII letters in place, 16 bytes per step with SSE2
+void ascii_fold(string &s) {
+    size_t i = 0;
+#ifdef __SSE2__
+    const __m128i lo = _mm_set1_epi8('A' - 1), hi = _mm_set1_epi8('Z' + 1), bit = _mm_set1_epi8(0x20);
+    for (; i + 16 <= s.size(); i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i *)&s[i]);
+        __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(x, lo), _mm_cmplt_epi8(x, hi));
+        _mm_storeu_si128((__m128i *)&s[i], _mm_or_si128(x, _mm_and_si128(upper, bit)));
+    }
+#endif
+    for (; i < s.size(); i++)
+        if (s[i] >= 'A' && s[i] <= 'Z') s[i] |= 0x20;
+}
+
+// Decodes UTF-8 into code points, replacing every invalid or overlong sequence with U+FFFD
+vector<uint32_t> decode_utf8(const string &s) {
+    vector<uint32_t> cps;
+    for (size_t i = 0; i < s.size();) {
+        unsigned char b = s[i];
+        int len = b < 0x80 ? 1 : (b >> 5) == 6 ? 2 : (b >> 4) == 14 ? 3 : (b >> 3) == 30 ? 4 : 0;
+        uint32_t cp = len == 1 ? b : len == 2 ? b & 0x1F : len == 3 ? b & 0x0F : b & 0x07;
+        bool ok = len > 0 && i + len <= s.size();
+        for (int k = 1; ok && k < len; k++) {
+            ok = ((unsigned char)s[i + k] >> 6) == 2;
+            cp = cp << 6 | (s[i + k] & 0x3F);
+        }
+        static const uint32_t min_cp[5] = {0, 0, 0x80, 0x800, 0x10000};
+        if (ok && (cp < min_cp[len] || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF))) ok = false;
+        cps.push_back(ok ? cp : 0xFFFD);
+        i += ok ? len : 1;
+    }
+    return cps;
+}
+
+// Encodes code points as UTF-8
+string encode_utf8(const vector<uint32_t> &cps) {
+    string s;
+    for (uint32_t cp : cps) {
+        if (cp < 0x80) s += (char)cp;
+        else if (cp < 0x800) { s += (char)(0xC0 | cp >> 6); s += (char)(0x80 | (cp & 0x3F)); }
+        else if (cp < 0x10000) { s += (char)(0xE0 | cp >> 12); s += (char)(0x80 | (cp >> 6 & 0x3F)); s += (char)(0x80 | (cp & 0x3F)); }
+        else { s += (char)(0xF0 | cp >> 18); s += (char)(0x80 | (cp >> 12 & 0x3F)); s += (char)(0x80 | (cp >> 6 & 0x3F)); s += (char)(0x80 | (cp & 0x3F)); }
+    }
+    return s;
+}
+
+// Appends the full decomposition of one code point
+void decompose(uint32_t cp, bool compat, vector<uint32_t> &out) {
+    if (compat) {
+        if (cp >= 0xFF01 && cp <= 0xFF5E) { out.push_back(cp - 0xFEE0); return; } // Fullwidth ASCII
+        for (auto &c : COMPAT_DECOMP) {
+            if (c.cp != cp) continue;
+            for (int k = 0; k < 4 && c.to[k]; k++) decompose(c.to[k], compat, out);
+            return;
+        }
+    }
+    for (auto &d : CANONICAL_DECOMP) {
+        if (d[0] != cp) continue;
+        decompose(d[1], compat, out);
+        if (d[2]) out.push_back(d[2]);
+        return;
+    }
+    out.push_back(cp);
+}
+
+// Appends the case fold of one code point
+void case_fold(uint32_t cp, vector<uint32_t> &out) {
+    if (cp >= 'A' && cp <= 'Z') cp += 0x20;
+    else if ((cp >= 0x391 && cp <= 0x3A9 && cp != 0x3A2) || (cp >= 0x410 && cp <= 0x42F)) cp += 0x20; // Greek, Cyrillic
+    else if (cp >= 0x400 && cp <= 0x40F) cp += 0x50;
+    else if (cp >= 0xFF21 && cp <= 0xFF3A) cp += 0x20;                      // Fullwidth Latin
+    else {
+        for (auto &f : CASE_FOLD) {
+            if (f[0] != cp) continue;
+            for (int k = 1; k < 4 && f[k]; k++) out.push_back(f[k]);
+            return;
+        }
+    }
+    out.push_back(cp);
+}
+
+// Primary composite of a starter and a following character, or 0
+uint32_t compose_pair(uint32_t a, uint32_t b) {
+    static const unordered_map<uint64_t, uint32_t> table = [] {
+        unordered_map<uint64_t, uint32_t> t;
+        for (auto &d : CANONICAL_DECOMP)
+            if (d[3]) t[(uint64_t)d[1] << 32 | d[2]] = d[0]; // Composition exclusions stay decomposed
+        return t;
+    }();
+    auto it = table.find((uint64_t)a << 32 | b);
+    return it == table.end() ? 0 : it->second;
+}
+
+// Normalizes a name to NFC (or NFKC when compat is set) plus case folding
+string fold_name(const string &name, bool compat) {
+    string s = name;
+    if (is_ascii(s.data(), s.size())) {                 // Fast path: nothing to decompose or compose
+        ascii_fold(s);
+        return s;
+    }
+    // Canonical ordering: stable sort of every run of combining marks by class
+    auto reorder = [](vector<uint32_t> &cps) {
+        for (size_t i = 0; i < cps.size();) {
+            size_t j = i;
+            while (j < cps.size() && combining_class(cps[j]) != 0) j++;
+            if (j - i > 1)
+                stable_sort(cps.begin() + i, cps.begin() + j,
+                            [](uint32_t a, uint32_t b) { return combining_class(a) < combining_class(b); });
+            i = j + 1;
+        }
+    };
+    vector<uint32_t> dec, cps;
+    for (uint32_t cp : decode_utf8(s)) decompose(cp, compat, dec);
+    reorder(dec);
+    for (uint32_t cp : dec) {
+        vector<uint32_t> folded;
+        case_fold(cp, folded);
+        for (uint32_t f : folded) decompose(f, compat, cps); // A fold can land on a decomposable letter
+    }
+    reorder(cps);
+
+    // Canonical composition: join each character with the last starter unless something blocks it
+    vector<uint32_t> out;
+    size_t starter = SIZE_MAX;
+    for (uint32_t cp : cps) {
+        int cc = combining_class(cp);
+        if (starter != SIZE_MAX) {
+            bool adjacent = out.size() - 1 == starter;
+            if (adjacent || (cc != 0 && combining_class(out.back()) < cc)) {
+                uint32_t composite = compose_pair(out[starter], cp);
+                if (composite) { out[starter] = composite; continue; }
+            }
+        }
+        if (cc == 0) starter = out.size();
+        out.push_back(cp);
+    }
+    return encode_utf8(out);
+}
+
+// Copies of records [begin, end) with normalized names, at the same positions (phones unchanged)
+vector<Contact> fold_contacts(const vector<Contact> &contacts, int begin, int end, bool compat) {
+    end = max(begin, min((int)contacts.size(), end));
+    vector<Contact> folded(end);
+    for (int i = begin; i < end; i++) folded[i] = {fold_name(contacts[i].name, compat), contacts[i].phone};
+    return folded;
+}
+
+// How the per-rank scan matches a search term
+struct Matcher {
+    const TokenIndex *index = nullptr;   // Search the token dictionary first (--tokens)
+    bool glob = false;                   // The term is a whole-name wildcard pattern (--glob)
+    const vector<Contact> *folded = nullptr; // Normalized names to scan instead (--normalize)
+    bool compat = false;                 // The names were normalized with NFKC rather than NFC
+};
+
+// Splits a name into its space-separated tokens
+vector<string> split_tokens(const string &name) {
+    vector<string> tokens;
+    size_t pos = 0;
+    while (pos < name.size()) {
+        size_t space = name.find(' ', pos);
+        if (space == string::npos) space = name.size();
+        if (space > pos) tokens.push_back(name.substr(pos, space - pos));
+        pos = space + 1;
+    }
+    return tokens;
+}
+
+// Finds needle in hay[from, n) and returns its position or string::npos. With SSE2, 16 start
+// positions are tested at once against the needle's first and last byte, and only the
+// candidates that pass both are compared in full.
+size_t simd_find(const char *hay, size_t n, const string &needle, size_t from) {
+    size_t m = needle.size();
+    if (m == 0) return from <= n ? from : string::npos;
+    if (from > n || n - from < m) return string::npos;
+    size_t i = from;
+#ifdef __SSE2__
+    const __m128i first = _mm_set1_epi8(needle[0]), last = _mm_set1_epi8(needle[m - 1]);
+    for (; i + m - 1 + 16 <= n; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(hay + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(hay + i + m - 1));
+        unsigned mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last)));
+        for (; mask; mask &= mask - 1) {
+            size_t at = i + __builtin_ctz(mask);
+            if (m < 3 || memcmp(hay + at + 1, needle.data() + 1, m - 2) == 0) return at;
+        }
+    }
+#endif
+    for (; i + m <= n; i++)                         // Tail (or the whole scan without SSE2)
+        if (hay[i] == needle[0] && memcmp(hay + i, needle.data(), m) == 0) return i;
+    return string::npos;
+}
+
+// A compiled whole-name wildcard pattern: '*' matches any run of characters, '?' any single one.
+// The pattern is kept as its star-separated groups plus the rarest '?'-free literal run, which
+// is the only part looked for in the scan.
+struct GlobPattern {
+    vector<string> groups;               // Pieces between stars ('?' allowed inside)
+    bool lead_star = false, trail_star = false;
+    string anchor;                       // Rarest literal run; empty if the pattern has none
+};
+
+// Splits the pattern and picks the literal run whose bytes are least likely in these names
+GlobPattern compile_glob(const string &pattern, const vector<Contact> &contacts, int begin, int end) {
+    GlobPattern g;
+    g.lead_star = !pattern.empty() && pattern[0] == '*';
+    g.trail_star = !pattern.empty() && pattern.back() == '*';
+    string cur;
+    for (char ch : pattern + "*") {
+        if (ch != '*') { cur += ch; continue; }
+        if (!cur.empty()) g.groups.push_back(cur);
+        cur.clear();
+    }
+    if (g.groups.empty()) g.lead_star = g.trail_star = !pattern.empty(); // "" or only stars
+
+    // Byte frequencies of the local names (sampled) rate how selective each literal run is
+    double freq[256];
+    fill(freq, freq + 256, 1.0);
+    int step = max(1, (end - begin) / 4096);
+    for (int i = begin; i < end; i += step)
+        for (unsigned char ch : contacts[i].name) freq[ch]++;
+    double total = accumulate(freq, freq + 256, 0.0), best = 0;
+    for (const string &group : g.groups) {
+        for (size_t pos = 0; pos < group.size();) {
+            size_t q = group.find('?', pos);
+            if (q == string::npos) q = group.size();
+            string run = group.substr(pos, q - pos);
+            double score = 0;                       // Log-probability of the run: lower is rarer
+            for (unsigned char ch : run) score += log(freq[ch] / total);
+            if (!run.empty() && (g.anchor.empty() || score < best)) { g.anchor = run; best = score; }
+            pos = q + 1;
+        }
+    }
+    return g;
+}
+
+// Does text[at..] start with the group ('?' matches anything)?
+bool group_at(const string &text, size_t at, const string &group) {
+    if (at + group.size() > text.size()) return false;
+    for (size_t k = 0; k < group.size(); k++)
+        if (group[k] != '?' && group[k] != text[at + k]) return false;
+    return true;
+}
+
+// Whole-name glob match: fixed groups at the unstarred ends, middle groups at their leftmost fit
+bool glob_match(const string &name, const GlobPattern &g) {
+    size_t n = g.groups.size(), first = 0, last = n, lo = 0, hi = name.size();
+    if (n == 0) return g.lead_star || name.empty();
+    if (n == 1 && !g.lead_star && !g.trail_star) return name.size() == g.groups[0].size() && group_at(name, 0, g.groups[0]);
+    if (!g.lead_star) {
+        if (!group_at(name, 0, g.groups[0])) return false;
+        lo = g.groups[first++].size();
+    }
+    if (!g.trail_star) {
+        const string &tail = g.groups[n - 1];
+        if (tail.size() > hi - lo || !group_at(name, hi - tail.size(), tail)) return false;
+        hi -= tail.size();
+        last--;
+    }
+    for (size_t k = first; k < last; k++) {
+        const string &group = g.groups[k];
+        while (lo + group.size() <= hi && !group_at(name, lo, group)) lo++;
+        if (lo + group.size() > hi) return false;
+        lo += group.size();
+    }
+    return true;
+}
+
+// Glob search over records [begin, end): the names are laid out as one newline-separated buffer,
+// the SIMD scan jumps from one occurrence of the anchor run to the next, and only the records it
+// lands in are verified against the full pattern
+vector<int> glob_range(const vector<Contact> &contacts, int begin, int end, const string &pattern) {
+    GlobPattern g = compile_glob(pattern, contacts, begin, end);
+    vector<int> matches;
+    if (g.anchor.empty()) {
+        for (int i = begin; i < end; i++)
+            if (glob_match(contacts[i].name, g)) matches.push_back(i - begin);
+        return matches;
+    }
+    string names;
+    vector<size_t> starts;
+    for (int i = begin; i < end; i++) {
+        starts.push_back(names.size());
+        names += contacts[i].name;
+        names += '\n';
+    }
+    size_t pos = 0;
+    while ((pos = simd_find(names.data(), names.size(), g.anchor, pos)) != string::npos) {
+        int r = upper_bound(starts.begin(), starts.end(), pos) - starts.begin() - 1;
+        if (glob_match(contacts[begin + r].name, g)) matches.push_back(r);
+        pos = r + 1 < (int)starts.size() ? starts[r + 1] : names.size(); // Next record
+    }
+    return matches;
+}
+
+// Finds the records in [begin, end) whose name contains the term (or matches it as a glob
+// pattern); returns their offsets from `begin` in ascending order. With a token index only the distinct tokens are scanned: a term
+// without spaces must lie inside one token, so the postings of the matching tokens are exactly
+// the answer. A term with spaces is anchored on its longest space-free piece and the candidates
+// are verified against the full name.
+vector<int> match_range(const vector<Contact> &records, int begin, int end, const string &search, const Matcher &how) {
+    // With --normalize the scan runs over the normalized names and a normalized term
+    const vector<Contact> &contacts = how.folded ? *how.folded : records;
+    string term = how.folded ? fold_name(search, how.compat) : search;
+    vector<int> matches;
+    end = max(begin, min((int)contacts.size(), end));
+    if (how.glob) return glob_range(contacts, begin, end, term);
+    const TokenIndex *index = how.index;
+    vector<string> pieces = split_tokens(term);
+    if (index == nullptr || pieces.empty()) {
+        for (int i = begin; i < end; i++)
+            if (contacts[i].name.find(term) != string::npos) matches.push_back(i - begin);
+        return matches;
+    }
+
+    string anchor = *max_element(pieces.begin(), pieces.end(),
+                                 [](const string &a, const string &b) { return a.size() < b.size(); });
+    bool exact = pieces.size() == 1 && anchor == term; // No spaces: token hits are final
+    vector<char> hit(end - begin, 0);                   // Bitmap over local records
+    for (int t = 0; t < (int)index->dict.size(); t++) {
+        if (index->dict[t].find(anchor) == string::npos) continue;
+        for (int k = index->post_start[t]; k < index->post_start[t + 1]; k++) hit[index->postings[k]] = 1;
+    }
+    for (int r = 0; r < end - begin; r++)
+        if (hit[r] && (exact || contacts[begin + r].name.find(term) != string::npos)) matches.push_back(r);
+    return matches;
+}
+
+// Formats matched records as output lines: name, a space, phone
+string format_matches(const vector<Contact> &contacts, int begin, const vector<int> &matches) {
+    string result;
+    for (int r : matches) result += contacts[begin + r].name + " " + contacts[begin + r].phone + "\n";
+    return result;
+}
+
+// Searches records [begin, end) for the term and returns the formatted matches
+string search_range(const vector<Contact> &contacts, int begin, int end, const string &term, const Matcher &how) {
+    return format_matches(contacts, begin, match_range(contacts, begin, end, term, how));
+}
+
+// ---------------------------------------------------------------------------------------------
+// Snapshots with a minimal perfect hash over normalized full names.
+//
+// The snapshot stores the records sorted by normalized name, so every distinct name owns one
+// contiguous record range. A BBHash-style MPH maps each distinct name to the slot of its range:
+// level l is a bit array of ~remaining-keys bits; a key whose level position no other key hits
+// sets its bit there, colliding keys move on to level l+1. The slot is the key's rank among all
+// set bits. Every 512-bit block (one cache line) has a precomputed rank, so a lookup costs about
+// one cache miss per visited level plus one for the range, at roughly 3.5 bits per key.
+// All sections are 8-byte aligned and the file is used through mmap as is.
+// ---------------------------------------------------------------------------------------------
+
+const int MPH_MAX_LEVELS = 32;
+const char SNAPSHOT_MAGIC[8] = "PBSNAP3";  // Bumped whenever the key normalization changes
+
+struct SnapshotHeader {
+    char magic[8];                       // SNAPSHOT_MAGIC; keys are NFKC case-folded names
+    uint64_t records, keys, text_bytes, levels, fallback;
+    uint64_t text_off, rec_off, range_off, fallback_off;
+    uint64_t level_bits[MPH_MAX_LEVELS], level_base[MPH_MAX_LEVELS];
+    uint64_t level_word_off[MPH_MAX_LEVELS], level_rank_off[MPH_MAX_LEVELS];
+};
+
+// Record range of one distinct name
+struct KeyRange {
+    uint32_t first, count;
+};
+
+// Read-only view of a snapshot (either mapped from disk or pointing into build buffers)
+struct SnapshotView {
+    const SnapshotHeader *hdr;
+    const char *text;                    // Records as "name,phone\n" lines, sorted by normalized name
+    const uint64_t *rec_off;             // Record i is text[rec_off[i] .. rec_off[i+1])
+    const KeyRange *ranges;              // Indexed by MPH slot
+    const uint64_t *words[MPH_MAX_LEVELS], *ranks[MPH_MAX_LEVELS];
+    const uint64_t *fallback;            // Sorted (hash, slot) pairs of keys no level could place
+    void *base;                          // Start and length of the mapping (nullptr when not mapped)
+    size_t bytes;
+};
+
+// Normalizes a name (NFKC, case folded) and collapses runs of whitespace, so "Fatema  JAHAN" and
+// "FATEMA jahan" give the same key
+string normalize_key(const string &name) {
+    string key;
+    for (char ch : fold_name(name, true)) {
+        if (isspace((unsigned char)ch)) {
+            if (!key.empty() && key.back() != ' ') key += ' ';
+        } else {
+            key += ch;
+        }
+    }
+    if (!key.empty() && key.back() == ' ') key.pop_back();
+    return key;
+}
+
+// 64-bit FNV-1a hash of a key
+uint64_t hash_key(const string &key) {
+    uint64_t h = 1469598103934665603ULL;
+    for (unsigned char ch : key) h = (h ^ ch) * 1099511628211ULL;
+    return h;
+}
+
+// Derives an independent position hash for each MPH level (murmur3 finalizer)
+uint64_t level_hash(uint64_t h, int level) {
+    h ^= (uint64_t)(level + 1) * 0x9E3779B97F4A7C15ULL;
+    h ^= h >> 33; h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33; h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+// Returns the MPH slot of a hash; the caller verifies the key since non-members map anywhere
+int64_t mph_lookup(const SnapshotView &v, uint64_t h) {
+    for (uint64_t l = 0; l < v.hdr->levels; l++) {
+        uint64_t pos = level_hash(h, l) % v.hdr->level_bits[l];
+        const uint64_t *w = v.words[l];
+        if (!(w[pos / 64] >> (pos % 64) & 1)) continue;
+        uint64_t r = v.ranks[l][pos / 512];                    // Set bits before this cache line
+        for (uint64_t k = pos / 512 * 8; k < pos / 64; k++) r += __builtin_popcountll(w[k]);
+        r += __builtin_popcountll(w[pos / 64] & ((1ULL << (pos % 64)) - 1));
+        return v.hdr->level_base[l] + r;
+    }
+    // Last resort: binary search over the few keys no level could place
+    uint64_t lo = 0, hi = v.hdr->fallback;
+    while (lo < hi) {
+        uint64_t mid = (lo + hi) / 2;
+        if (v.fallback[2 * mid] < h) lo = mid + 1; else hi = mid;
+    }
+    return lo < v.hdr->fallback && v.fallback[2 * lo] == h ? (int64_t)v.fallback[2 * lo + 1] : -1;
+}
+
+// Maps a snapshot file into memory; returns false, with the reason in *error, if it is missing,
+// not a snapshot of this format, or corrupt (a header that points past the end of the file)
+bool map_snapshot(const string &path, SnapshotView &v, string *error = nullptr) {
+    auto fail = [&](const char *why) {
+        if (error) *error = why;
+        return false;
+    };
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return fail("cannot open the file");
+    struct stat st;
+    fstat(fd, &st);
+    void *base = st.st_size >= (off_t)sizeof(SnapshotHeader) ? mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (base == MAP_FAILED) return fail("not a snapshot (too short)");
+    const char *p = (const char *)base;
+    const SnapshotHeader *h = (const SnapshotHeader *)p;
+    uint64_t size = st.st_size;
+    // Does a section of `count` elements of `bytes` each at `off` lie inside the file?
+    auto inside = [&](uint64_t off, uint64_t count, uint64_t bytes) {
+        return off % 8 == 0 && off <= size && count <= (size - off) / bytes;
+    };
+    const char *problem = nullptr;
+    if (memcmp(h->magic, SNAPSHOT_MAGIC, 8) != 0) {
+        problem = "not a snapshot of this format (rebuild it with --build-snapshot)";
+    } else if (h->levels > (uint64_t)MPH_MAX_LEVELS || h->keys > h->records || h->records >= UINT32_MAX ||
+               h->text_off > size || h->text_bytes > size - h->text_off || !inside(h->rec_off, h->records + 1, 8) ||
+               !inside(h->range_off, h->keys, sizeof(KeyRange)) || !inside(h->fallback_off, h->fallback, 16)) {
+        problem = "corrupt snapshot";
+    } else {
+        for (uint64_t l = 0; l < h->levels && !problem; l++) {
+            uint64_t words = h->level_bits[l] / 64;
+            if (h->level_bits[l] == 0 || h->level_bits[l] % 64 != 0 || !inside(h->level_word_off[l], words, 8) ||
+                !inside(h->level_rank_off[l], (words + 7) / 8, 8))
+                problem = "corrupt snapshot";
+        }
+    }
+    if (problem) {
+        munmap(base, st.st_size);
+        return fail(problem);
+    }
+    v.base = base;
+    v.bytes = st.st_size;
+    v.hdr = h;
+    v.text = p + h->text_off;
+    v.rec_off = (const uint64_t *)(p + h->rec_off);
+    v.ranges = (const KeyRange *)(p + h->range_off);
+    for (uint64_t l = 0; l < h->levels; l++) {
+        v.words[l] = (const uint64_t *)(p + h->level_word_off[l]);
+        v.ranks[l] = (const uint64_t *)(p + h->level_rank_off[l]);
+    }
+    v.fallback = (const uint64_t *)(p + h->fallback_off);
+    return true;
+}
+
+// Looks up all records whose normalized name equals the normalized `name`
+string snapshot_exact(const SnapshotView &v, const string &name) {
+    string key = normalize_key(name);
+    int64_t slot = mph_lookup(v, hash_key(key));
+    if (slot < 0 || (uint64_t)slot >= v.hdr->keys) return "";
+    KeyRange range = v.ranges[slot];
+    string result;
+    if (range.first > v.hdr->records || range.count > v.hdr->records - range.first) return "";
+    for (uint32_t i = range.first; i < range.first + range.count; i++) {
+        if (v.rec_off[i] >= v.rec_off[i + 1] || v.rec_off[i + 1] > v.hdr->text_bytes) return ""; // Damaged record table
+        string line(v.text + v.rec_off[i], v.rec_off[i + 1] - v.rec_off[i] - 1);
+        size_t comma = line.find(',');
+        Contact c = {line.substr(0, comma), line.substr(comma + 1)};
+        if (i == range.first && normalize_key(c.name) != key) return ""; // Not a member: the slot belongs to another name
+        result += c.name + " " + c.phone + "\n";
+    }
+    return result;
+}
+
+// Digits of a phone number, so "017 62 031" and "0176-2031" compare equal
+string phone_digits(const string &phone) {
+    string d;
+    for (char ch : phone) if (isdigit((unsigned char)ch)) d += ch;
+    return d;
+}
+
+// Join key of a contact: the normalized name or the digits of the phone
+string join_key(const string &name, const string &phone, bool by_phone) {
+    return by_phone ? phone_digits(phone) : normalize_key(name);
+}
+
+// ---------------------------------------------------------------------------------------------
+// Batched exact-key lookups. Every rank indexes its records by join key (normalized name or
+// phone digits) in an open-addressing table of (hash, first record) slots; records sharing a
+// key are chained. One lookup is a chain of dependent cache misses: the slot, the key string
+// object, its characters, then each chained record. The probe engine interleaves a group of
+// lookups AMAC-style: every in-flight lookup is a small state machine that advances one step,
+// prefetches what its next step reads and hands over to the next lookup, so the misses of the
+// whole group overlap instead of running back to back.
+// ---------------------------------------------------------------------------------------------
+
+// Exact-key index of one rank's records
+struct KeyIndex {
+    struct Slot { uint64_t hash; int first; };      // hash 0 marks an empty slot
+    vector<Slot> slots;
+    vector<int> next;                               // Next record with the same key, -1 at the end
+    vector<string> keys;                            // Join key of every record
+    size_t mask;
+};
+
+// Hash of a join key as stored in the index (never 0)
+uint64_t index_hash(const string &key) {
+    return level_hash(hash_key(key), 7) | 1;
+}
+
+// Indexes records [0, n) by name or phone key; slots are kept at most half full
+KeyIndex build_key_index(const vector<Contact> &contacts, bool by_phone) {
+    KeyIndex idx;
+    size_t capacity = 16;
+    while (capacity < 2 * contacts.size()) capacity <<= 1;
+    idx.slots.assign(capacity, {0, -1});
+    idx.mask = capacity - 1;
+    idx.next.assign(contacts.size(), -1);
+    idx.keys.resize(contacts.size());
+    for (int i = contacts.size() - 1; i >= 0; i--) { // Prepending in reverse keeps the chains ascending
+        idx.keys[i] = join_key(contacts[i].name, contacts[i].phone, by_phone);
+        uint64_t h = index_hash(idx.keys[i]);
+        size_t s = h & idx.mask;
+        while (idx.slots[s].hash != 0 && !(idx.slots[s].hash == h && idx.keys[idx.slots[s].first] == idx.keys[i]))
+            s = (s + 1) & idx.mask;
+        idx.next[i] = idx.slots[s].first;
+        idx.slots[s] = {h, i};
+    }
+    return idx;
+}
+
+// Looks up every key (already in join-key form) and returns, per key, its local records in
+// ascending order. `group` lookups are in flight at once; a group of 1 is the plain loop.
+vector<vector<int>> batch_lookup(const KeyIndex &idx, const vector<string> &keys, int group) {
+    enum State { IDLE, PROBE, KEY, VERIFY, CHAIN };
+    struct Lookup { State state = IDLE; int q; uint64_t h; size_t slot; int rec; };
+    vector<vector<int>> hits(keys.size());
+    vector<Lookup> ring(max(1, min(group, (int)keys.size())));
+    size_t started = 0, done = 0;
+    auto start = [&](Lookup &l) {
+        if (started == keys.size()) { l.state = IDLE; return; }
+        l.q = started++;
+        l.h = index_hash(keys[l.q]);
+        l.slot = l.h & idx.mask;
+        __builtin_prefetch(&idx.slots[l.slot]);
+        l.state = PROBE;
+    };
+    for (Lookup &l : ring) start(l);
+
+    for (size_t k = 0; done < keys.size(); k = k + 1 == ring.size() ? 0 : k + 1) {
+        Lookup &l = ring[k];
+        switch (l.state) {
+        case IDLE:
+            break;
+        case PROBE: {                               // The slot is (hopefully) cached by now
+            const KeyIndex::Slot &s = idx.slots[l.slot];
+            if (s.hash == 0) { done++; start(l); break; } // Key not present
+            if (s.hash != l.h) {
+                l.slot = (l.slot + 1) & idx.mask;
+                __builtin_prefetch(&idx.slots[l.slot]);
+                break;
+            }
+            l.rec = s.first;
+            __builtin_prefetch(&idx.keys[l.rec]);
+            l.state = KEY;
+            break;
+        }
+        case KEY:                                   // String object cached: fetch its characters
+            __builtin_prefetch(idx.keys[l.rec].data());
+            l.state = VERIFY;
+            break;
+        case VERIFY:
+            if (idx.keys[l.rec] != keys[l.q]) {     // 64-bit hash collision: keep probing
+                l.slot = (l.slot + 1) & idx.mask;
+                __builtin_prefetch(&idx.slots[l.slot]);
+                l.state = PROBE;
+                break;
+            }
+            __builtin_prefetch(&idx.next[l.rec]);
+            l.state = CHAIN;
+            break;
+        case CHAIN:                                 // Every record of the chain has the key
+            hits[l.q].push_back(l.rec);
+            l.rec = idx.next[l.rec];
+            if (l.rec < 0) { done++; start(l); break; }
+            __builtin_prefetch(&idx.next[l.rec]);
+            break;
+        }
+    }
+    return hits;
+}
+
+#endif
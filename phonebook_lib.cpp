@@ -0,0 +1,183 @@
+/*
+    Embeddable phonebook search library; the C API is documented in phonebook.h.
+
+    Build:  g++ -O2 -fPIC -shared -fvisibility=hidden -Wl,--version-script=phonebook.map \
+                -o libphonebook.so phonebook_lib.cpp -lpthread
+
+    A book holds the same record table the MPI program scans, so every query mode gives the
+    matches one rank would give for its partition, here for the whole book. No exception
+    crosses the C boundary: failures become a NULL or -1 return and a pb_error() message.
+*/
+
+#include "phonebook_core.h"
+#include "phonebook.h"
+
+// An opened phonebook. Everything except the lazily built key indexes is fixed at open time.
+struct pb_book {
+    vector<Contact> contacts;
+    vector<Contact> folded;              // Normalized names at the same positions (PB_OPEN_NFC/NFKC)
+    Matcher how;                         // Matcher for substring and glob queries
+    SnapshotView snapshot = {};          // Mapped snapshot (snapshot.base is nullptr for text files)
+    KeyIndex by_name, by_phone;          // Exact-key indexes, built on first use
+    once_flag name_once, phone_once;
+};
+
+// Matches of one query as record numbers
+struct pb_result {
+    const pb_book *book;
+    vector<int> ids;
+    size_t next = 0;
+};
+
+thread_local string last_error;          // Message for pb_error(), per calling thread
+
+// Records the message of a failed call and returns `value` for the caller to pass on
+template <class T> T fail(const string &message, T value) {
+    last_error = message;
+    return value;
+}
+
+// Applies the open flags: normalized copies of the names for the substring and glob scans
+bool finish_open(pb_book *book, int flags) {
+    if (flags & ~(PB_OPEN_NFC | PB_OPEN_NFKC)) return fail("unknown open flags", false);
+    if (flags) {
+        book->how.compat = flags & PB_OPEN_NFKC;
+        book->folded = fold_contacts(book->contacts, 0, book->contacts.size(), book->how.compat);
+        book->how.folded = &book->folded;
+    }
+    return true;
+}
+
+// Finds the records matching `term` under `mode` (ascending record numbers)
+bool run_query(const pb_book *book, const char *term, int mode, vector<int> &ids) {
+    if (book == nullptr || term == nullptr) return fail("no book or no term", false);
+    pb_book *b = const_cast<pb_book *>(book);    // Only the once-guarded indexes are ever written
+    int n = book->contacts.size();
+    if (mode == PB_SUBSTRING || mode == PB_GLOB) {
+        Matcher how = book->how;
+        how.glob = mode == PB_GLOB;
+        ids = match_range(book->contacts, 0, n, term, how);
+        return true;
+    }
+    if (mode == PB_EXACT_NAME && book->snapshot.base != nullptr) {
+        // Snapshot records are stored in name order, so one MPH slot gives the whole range
+        string key = normalize_key(term);
+        int64_t slot = mph_lookup(book->snapshot, hash_key(key));
+        ids.clear();
+        if (slot < 0 || (uint64_t)slot >= book->snapshot.hdr->keys) return true;
+        KeyRange range = book->snapshot.ranges[slot];
+        if (range.first >= (uint32_t)n || normalize_key(book->contacts[range.first].name) != key) return true;
+        for (uint32_t i = range.first; i < range.first + range.count && i < (uint32_t)n; i++) ids.push_back(i);
+        return true;
+    }
+    if (mode == PB_EXACT_NAME || mode == PB_PHONE) {
+        bool by_phone = mode == PB_PHONE;
+        KeyIndex &idx = by_phone ? b->by_phone : b->by_name;
+        call_once(by_phone ? b->phone_once : b->name_once, [&] { idx = build_key_index(book->contacts, by_phone); });
+        ids = batch_lookup(idx, {join_key(term, term, by_phone)}, 1)[0];
+        return true;
+    }
+    return fail("unknown query mode " + to_string(mode), false);
+}
+
+// Only the C API is exported: default visibility here, and phonebook.map keeps everything else local
+#pragma GCC visibility push(default)
+extern "C" {
+
+int pb_version(void) {
+    return PB_API_VERSION;
+}
+
+const char *pb_error(void) {
+    return last_error.c_str();
+}
+
+pb_book *pb_open_files(const char *const *paths, int count, int flags) {
+    try {
+        if (paths == nullptr || count <= 0) return fail("no phonebook files", (pb_book *)nullptr);
+        vector<string> files;
+        for (int i = 0; i < count; i++) {
+            if (paths[i] == nullptr || access(paths[i], R_OK) != 0)
+                return fail(string("cannot read ") + (paths[i] ? paths[i] : "(null)"), (pb_book *)nullptr);
+            files.push_back(paths[i]);
+        }
+        unique_ptr<pb_book> book(new pb_book);
+        read_phonebook(files, book->contacts);
+        if (!finish_open(book.get(), flags)) return nullptr;
+        return book.release();
+    } catch (const exception &e) {
+        return fail(string("cannot open phonebook: ") + e.what(), (pb_book *)nullptr);
+    }
+}
+
+pb_book *pb_open_snapshot(const char *path, int flags) {
+    try {
+        unique_ptr<pb_book> book(new pb_book);
+        string problem = "no path";
+        if (path == nullptr || !map_snapshot(path, book->snapshot, &problem))
+            return fail(string(path ? path : "(null)") + ": " + problem, (pb_book *)nullptr);
+        book->contacts = string_to_contacts(string(book->snapshot.text, book->snapshot.hdr->text_bytes));
+        if (!finish_open(book.get(), flags)) {
+            munmap(book->snapshot.base, book->snapshot.bytes);
+            return nullptr;
+        }
+        return book.release();
+    } catch (const exception &e) {
+        return fail(string("cannot open snapshot: ") + e.what(), (pb_book *)nullptr);
+    }
+}
+
+size_t pb_size(const pb_book *book) {
+    return book ? book->contacts.size() : 0;
+}
+
+long pb_search(const pb_book *book, const char *term, int mode, pb_match_fn fn, void *user) {
+    try {
+        vector<int> ids;
+        if (!run_query(book, term, mode, ids)) return -1;
+        if (fn == nullptr) return ids.size();          // Count only
+        long delivered = 0;
+        for (int i : ids) {
+            delivered++;
+            if (fn(book->contacts[i].name.c_str(), book->contacts[i].phone.c_str(), user)) break;
+        }
+        return delivered;
+    } catch (const exception &e) {
+        return fail(string("search failed: ") + e.what(), -1L);
+    }
+}
+
+pb_result *pb_query(const pb_book *book, const char *term, int mode) {
+    try {
+        unique_ptr<pb_result> res(new pb_result{book, {}, 0});
+        if (!run_query(book, term, mode, res->ids)) return nullptr;
+        return res.release();
+    } catch (const exception &e) {
+        return fail(string("query failed: ") + e.what(), (pb_result *)nullptr);
+    }
+}
+
+size_t pb_result_count(const pb_result *res) {
+    return res ? res->ids.size() : 0;
+}
+
+int pb_result_next(pb_result *res, const char **name, const char **phone) {
+    if (res == nullptr || res->next >= res->ids.size()) return 0;
+    const Contact &c = res->book->contacts[res->ids[res->next++]];
+    if (name) *name = c.name.c_str();
+    if (phone) *phone = c.phone.c_str();
+    return 1;
+}
+
+void pb_result_free(pb_result *res) {
+    delete res;
+}
+
+void pb_close(pb_book *book) {
+    if (book == nullptr) return;
+    if (book->snapshot.base != nullptr) munmap(book->snapshot.base, book->snapshot.bytes);
+    delete book;
+}
+
+}
+#pragma GCC visibility pop
@@ -2,36 +2,352 @@
     How to compile and run:
     Compile: mpic++ -o search phonebook_search.cpp
     Run:     mpirun -np 4 ./search phonebook1.txt Bob
+             mpirun -np 4 ./search --join phone phonebook_a.txt phonebook_b.txt
+             mpirun -np 7 ./search --replicas 2 --queries names.txt phonebook1.txt
+             mpirun -np 4 ./search --build-snapshot book.snap phonebook1.txt
+             mpirun -np 1 ./search --snapshot book.snap --exact "FATEMA JAHAN TAMMY"
 
     This program performs a parallel search for a name (e.g., "Bob")
     in a phonebook file using MPI. It divides the workload among processes
     to speed up the search operation.
+
+    Options (given before the file names):
+      --replicas <r>     keep every partition on r worker ranks and hedge slow answers
+      --hedge-pct <p>    latency percentile after which a hedged duplicate is sent (default 95)
+      --inflight <n>     number of queries the master keeps in flight at once (default 1)
+      --queries <file>   read one search term per line ("-" for stdin) instead of a single term;
+                         a line may add "<TAB>deadline ms<TAB>class" (class 0 = most urgent, default 1)
+      --deadline-ms <d>  deadline of queries that carry none; late partitions answer with partial results
+      --progress-thread  overlap the distribution of the chunks with rank 0's own scan (MPI_THREAD_MULTIPLE)
+      --overlap-bench    measure how much of the distribution that overlap actually hides
+      --ingest-threads <n>  read the files through a reader / n parsers / builder pipeline
+      --lookup name|phone  exact-key lookups of the search term (or of every --queries line) in a
+                         per-rank hash index; names compare like --exact, phones by their digits
+      --lookup-group <g> lookups the batch probe engine keeps in flight (default 16; 1 = one at a time)
+      --compress lz4     write output.txt.lz4 instead of output.txt; every rank compresses its own
+                         matches, so the file is a series of LZ4 frames (lz4 -d reads it as one)
+      --shm-sink <path>  publish the results into a shared-memory ring for a local consumer instead of
+                         writing a file; <path> becomes a symlink to it (see phonebook_ring.h)
+      --wire-lz4 <gbit/s>  LZ4-compress large messages when that beats a link of this speed
+      --coll-tune <file> distribute the chunks and collect the results with the scatter/gather/bcast
+                         algorithms tuned for this machine (see mpi_coll.h); a new file is filled by a
+                         short benchmark on first use
+      --tokens           dictionary-encode names and search the distinct tokens first
+      --build-snapshot <file>  write the phonebook and a minimal perfect hash of its names to a snapshot
+      --snapshot <file>  read contacts from a snapshot instead of phonebook files
+      --exact <name>     look up one full name (case and spacing ignored) in the snapshot's hash
+      --save <set>       keep the result as a named record-ID bitmap in the result cache
+      --from <set>       start from a saved result instead of searching (no search term)
+      --and/--or/--andnot <set>   combine the result with a saved one (applied in order)
+      --cache <dir>      directory of the named-result cache (default .phonebook_results)
+      --sort name|phone  write the matches ordered by name or by phone number
+      --speed-file <f>   weight the partitions by the per-rank scan speed saved in f by the last run
+      --glob             treat the search term as a whole-name pattern with * and ? wildcards
+      --dedup            cluster near-duplicate contacts instead of searching (no search term)
+      --dedup-threshold <j>  name-shingle Jaccard similarity that makes two contacts duplicates (default 0.6)
+      --join name|phone  list the contacts of the first file that also appear in the second (two files, no search term)
+      --normalize nfc|nfkc  validate UTF-8 and match on normalized, case-folded names
+      --approx <rate>    estimate the match count from a stratified sample of this fraction, with
+                         sketch-based distinct name/token/surname counts and error bounds
 */
 
 #include <bits/stdc++.h>
 #include <mpi.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "phonebook_core.h"
+#include "phonebook_ring.h"
+#include "mpi_coll.h"
 using namespace std;
 
-// Struct to represent a contact entry with name and phone number
-struct Contact {
-    string name;
-    string phone;
+// Message tags used by the replicated query service
+const int TAG_QUERY = 10;   // master -> worker: "<qid>\n<budget seconds, -1 = none>\n<class>\n<search term>"
+const int TAG_CANCEL = 11;  // master -> worker: "<qid>", the other replica already answered
+const int TAG_STOP = 12;    // master -> worker: no more queries
+const int TAG_RESULT = 13;  // worker -> master: "<qid>\n<0 done|1 cancelled|2 partial>\n<scanned> <records> <busy s>\n<matches>"
+const int TAG_RUN = 14;     // worker -> master: next block of a sorted run, empty at its end
+const int TAG_JOIN = 15;    // worker -> master: next block of joined pairs, empty when the worker is done
+
+// Command line options (all optional, given before the file names)
+struct Options {
+    int replicas = 1;        // Number of worker ranks holding each partition
+    double hedge_pct = 95;   // Latency percentile that triggers a hedged duplicate
+    int inflight = 1;        // Queries the master keeps outstanding at once
+    string queries;          // Query file ("-" = stdin); empty means a single search term
+    bool tokens = false;     // Search through the global token dictionary instead of every name
+    string build_snapshot;   // Write a snapshot of the input files to this path
+    string snapshot;         // Read contacts from this snapshot instead of text files
+    string exact;            // Full name to look up through the snapshot's perfect hash
+    string save, from;       // Named result sets to write / to start from instead of searching
+    vector<pair<string, string>> set_ops; // ("and" | "or" | "andnot", set name) in command line order
+    string cache = ".phonebook_results";  // Directory of the named-result cache
+    string sort;             // "name" or "phone": order the output by that field
+    string speed_file;       // Per-rank scan speeds from the previous run (read, then rewritten)
+    bool glob = false;       // The search term is a wildcard pattern
+    bool dedup = false;      // Near-duplicate clustering job
+    double dedup_threshold = 0.6; // Jaccard similarity of name shingles for a duplicate pair
+    string join;             // "name" or "phone": join the two input files on that key
+    string normalize;        // "nfc" or "nfkc": Unicode-normalize and case-fold names before matching
+    double approx = 0;       // Sampling rate of the approximate mode (0 = exact search)
+    double deadline_ms = 0;  // Deadline of service queries that do not carry their own (0 = none)
+    bool progress_thread = false; // Keep MPI progressing in a background thread during the scan
+    bool overlap_bench = false;   // Benchmark communication/computation overlap instead of searching
+    int ingest_threads = 0;  // Parser threads of the staged ingest pipeline (0 = serial read loop)
+    string lookup;           // "name" or "phone": exact-key lookups of the query keys instead of a search
+    int lookup_group = 16;   // Lookups interleaved by the batch probe engine
+    bool compress = false;   // Write the results LZ4-compressed (--compress lz4)
+    string shm_sink;         // Publish the results into a shared-memory ring reachable through this path
+    double wire_gbps = 0;    // Link speed for the adaptive payload compression (0 = off)
+    string coll_tune;        // Tuning file of the self-tuned collectives (empty = the MPI library's)
 };
 
-// Function to send a string to a specific receiver process
-void send_string(const string &text, int receiver) {
+// ---------------------------------------------------------------------------------------------
+// LZ4 block codec, used for compressed output files and compressed message payloads. The
+// compressor is a small greedy LZ4 encoder: a 4K-entry hash of 4-byte sequences finds matches
+// within the 64 KB window, and each 64 KB block is compressed on its own, so blocks can be
+// produced and decoded independently on every rank.
+// ---------------------------------------------------------------------------------------------
+
+const size_t LZ4_BLOCK_BYTES = 1 << 16;            // Uncompressed bytes per block (frame BD: 64 KB max)
+
+// 32-bit xxHash, used for the frame header checksum
+uint32_t xxh32(const uint8_t *p, size_t n, uint32_t seed) {
+    const uint32_t P1 = 2654435761U, P2 = 2246822519U, P3 = 3266489917U, P4 = 668265263U, P5 = 374761393U;
+    auto rotl = [](uint32_t x, int r) { return (x << r) | (x >> (32 - r)); };
+    auto lane = [](const uint8_t *q) { uint32_t v; memcpy(&v, q, 4); return v; };
+    const uint8_t *end = p + n;
+    uint32_t h;
+    if (n >= 16) {
+        uint32_t v[4] = {seed + P1 + P2, seed + P2, seed, seed - P1};
+        for (; p + 16 <= end; p += 16)
+            for (int i = 0; i < 4; i++) v[i] = rotl(v[i] + lane(p + 4 * i) * P2, 13) * P1;
+        h = rotl(v[0], 1) + rotl(v[1], 7) + rotl(v[2], 12) + rotl(v[3], 18);
+    } else {
+        h = seed + P5;
+    }
+    h += n;
+    for (; p + 4 <= end; p += 4) h = rotl(h + lane(p) * P3, 17) * P4;
+    for (; p < end; p++) h = rotl(h + *p * P5, 11) * P1;
+    h ^= h >> 15; h *= P2;
+    h ^= h >> 13; h *= P3;
+    return h ^ (h >> 16);
+}
+
+// Writes an LZ4 length continuation (runs of 255 and the remainder)
+uint8_t *lz4_put_length(uint8_t *op, size_t len) {
+    for (; len >= 255; len -= 255) *op++ = 255;
+    *op++ = len;
+    return op;
+}
+
+// Compresses src[0, n) into one LZ4 block (sequences of literals plus a back-reference)
+string lz4_compress_block(const char *src, size_t n) {
+    const int HASH_BITS = 12;
+    const size_t MIN_MATCH = 4, LAST_LITERALS = 5, MATCH_LIMIT = 12; // Format rules for the block end
+    const uint8_t *in = (const uint8_t *)src;
+    auto load = [&](size_t i) { uint32_t v; memcpy(&v, in + i, 4); return v; };
+    int32_t table[1 << HASH_BITS];
+    fill(table, table + (1 << HASH_BITS), -1);
+    string out(n + n / 255 + 16, '\0');            // Worst case of the format
+    uint8_t *op = (uint8_t *)&out[0];
+    size_t anchor = 0, i = 0;
+    auto emit = [&](size_t literals, size_t offset, size_t match) { // match = 0: final literals only
+        size_t ml = match ? match - MIN_MATCH : 0;
+        *op++ = (min<size_t>(literals, 15) << 4) | min<size_t>(ml, 15);
+        if (literals >= 15) op = lz4_put_length(op, literals - 15);
+        memcpy(op, in + anchor, literals);
+        op += literals;
+        if (!match) return;
+        *op++ = offset & 0xFF;
+        *op++ = offset >> 8;
+        if (ml >= 15) op = lz4_put_length(op, ml - 15);
+    };
+    while (n > MATCH_LIMIT && i < n - MATCH_LIMIT) {
+        uint32_t seq = load(i);
+        uint32_t h = (seq * 2654435761U) >> (32 - HASH_BITS);
+        int32_t cand = table[h];
+        table[h] = i;
+        if (cand < 0 || i - cand > 65535 || load(cand) != seq) { i++; continue; }
+        size_t len = MIN_MATCH, room = n - LAST_LITERALS - i;
+        while (len < room && in[cand + len] == in[i + len]) len++;
+        while (i > anchor && cand > 0 && in[i - 1] == in[cand - 1]) { i--; cand--; len++; } // Extend backwards
+        emit(i - anchor, i - cand, len);
+        i += len;
+        anchor = i;
+    }
+    emit(n - anchor, 0, 0);
+    out.resize(op - (uint8_t *)&out[0]);
+    return out;
+}
+
+// Decodes one LZ4 block into dst[0, cap); returns the decoded size, or -1 if the block is malformed
+long lz4_decompress_block(const char *src, size_t n, char *dst, size_t cap) {
+    const uint8_t *ip = (const uint8_t *)src, *iend = ip + n;
+    uint8_t *op = (uint8_t *)dst, *oend = op + cap;
+    auto length = [&](size_t &len) {                // Adds a length continuation; false if truncated
+        for (uint8_t b = 255; b == 255; len += b) {
+            if (ip >= iend) return false;
+            b = *ip++;
+        }
+        return true;
+    };
+    while (ip < iend) {
+        uint8_t token = *ip++;
+        size_t literals = token >> 4;
+        if (literals == 15 && !length(literals)) return -1;
+        if ((size_t)(iend - ip) < literals || (size_t)(oend - op) < literals) return -1;
+        memcpy(op, ip, literals);
+        op += literals;
+        ip += literals;
+        if (ip == iend) break;                      // The last sequence has no match
+        if (iend - ip < 2) return -1;
+        size_t offset = ip[0] | ip[1] << 8, len = (token & 15) + 4;
+        ip += 2;
+        if ((token & 15) == 15 && !length(len)) return -1;
+        if (offset == 0 || offset > (size_t)(op - (uint8_t *)dst) || (size_t)(oend - op) < len) return -1;
+        const uint8_t *match = op - offset;
+        if (offset >= len) memcpy(op, match, len);
+        else for (size_t k = 0; k < len; k++) op[k] = match[k]; // Overlap repeats the last `offset` bytes
+        op += len;
+    }
+    return op - (uint8_t *)dst;
+}
+
+// Optional LZ4 compression of send_string payloads (--wire-lz4). A payload is compressed only
+// when it is large and the model says it pays off: compressing, sending ratio * n bytes and
+// decompressing on the receiver must beat sending n bytes at link speed. Ratio and compress speed
+// are smoothed measurements; every 16th large message is compressed regardless, so they stay
+// current. The receivers' decompress speeds are measured once at startup and shared by all ranks.
+struct WireCompression {
+    double link_rate = 0;                           // Link bandwidth in bytes/s; 0 disables compression
+    double ratio = 0.5;                             // Compressed / raw size
+    double compress_rate = 0;                       // Raw bytes per second (0 = not measured yet)
+    vector<double> decompress_rate;                 // Raw bytes per second each rank decodes
+    unsigned large = 0;                             // Payloads above the threshold so far
+    long long messages = 0, packed = 0, raw_bytes = 0, wire_bytes = 0;
+};
+WireCompression wire;
+const size_t WIRE_MIN_BYTES = 1 << 16;             // Smaller payloads always travel as they are
+
+// Folds one measurement into a smoothed value
+void smooth(double &avg, double sample) {
+    avg = avg == 0 ? sample : 0.8 * avg + 0.2 * sample;
+}
+
+// Packs a payload as its 8-byte raw size followed by 64 KB LZ4 blocks, each a 4-byte size (high
+// bit set: stored raw) and the block data
+string wire_compress(const string &text) {
+    string out(8, '\0');
+    uint64_t raw = text.size();
+    memcpy(&out[0], &raw, 8);
+    for (size_t pos = 0; pos < text.size(); pos += LZ4_BLOCK_BYTES) {
+        size_t n = min(LZ4_BLOCK_BYTES, text.size() - pos);
+        string block = lz4_compress_block(text.data() + pos, n);
+        bool stored = block.size() >= n;
+        uint32_t size = stored ? n | 0x80000000U : block.size();
+        out.append((const char *)&size, 4);
+        if (stored) out.append(text, pos, n);
+        else out += block;
+    }
+    return out;
+}
+
+// Unpacks wire_compress output straight into the destination string; false if it is malformed
+bool wire_decompress(const char *p, size_t n, string &out) {
+    uint64_t raw;
+    if (n < 8) return false;
+    memcpy(&raw, p, 8);
+    out.resize(raw);
+    size_t pos = 8, done = 0;
+    while (pos + 4 <= n && done < raw) {
+        uint32_t size;
+        memcpy(&size, p + pos, 4);
+        pos += 4;
+        bool stored = size & 0x80000000U;
+        size &= 0x7FFFFFFFU;
+        if (pos + size > n) return false;
+        long got = stored ? (long)size : lz4_decompress_block(p + pos, size, &out[done], raw - done);
+        if (got < 0 || (stored && size > raw - done)) return false;
+        if (stored) memcpy(&out[done], p + pos, size);
+        done += got;
+        pos += size;
+    }
+    return done == raw && pos == n;
+}
+
+// Times this rank's codec on a sample of phonebook lines (best of three) and gathers every rank's
+// decompress speed, so senders weigh the speed of the rank that will actually decode. Collective.
+void wire_calibrate(int size) {
+    static const char *words[] = {"FATEMA", "JAHAN", "RAHMAN", "AKTER", "HOSSAIN", "ISLAM", "BEGUM", "KHAN"};
+    string sample, packed, back;
+    for (unsigned i = 0; sample.size() < 4 * WIRE_MIN_BYTES; i++)
+        sample += string("\"") + words[i % 8] + " " + words[i * 7 / 3 % 8] + "\",\"01" + to_string(i * 7919 % 100000000) + "\"\n";
+    double compress = 1e30, decompress = 1e30;
+    for (int rep = 0; rep < 3; rep++) {
+        double start = MPI_Wtime();
+        packed = wire_compress(sample);
+        double mid = MPI_Wtime();
+        wire_decompress(packed.data(), packed.size(), back);
+        compress = min(compress, mid - start);
+        decompress = min(decompress, MPI_Wtime() - mid);
+    }
+    wire.compress_rate = sample.size() / max(compress, 1e-9);
+    wire.ratio = (double)packed.size() / sample.size();
+    double mine = sample.size() / max(decompress, 1e-9);
+    wire.decompress_rate.resize(size);
+    MPI_Allgather(&mine, 1, MPI_DOUBLE, wire.decompress_rate.data(), 1, MPI_DOUBLE, MPI_COMM_WORLD);
+}
+
+// Function to send a string to a specific receiver process. A compressed payload is announced
+// by a negative length (minus its packed size).
+void send_string(const string &text, int receiver, int tag = 1) {
     int len = text.size() + 1; // +1 for null terminator
-    MPI_Send(&len, 1, MPI_INT, receiver, 1, MPI_COMM_WORLD);           // Send length first
-    MPI_Send(text.c_str(), len, MPI_CHAR, receiver, 1, MPI_COMM_WORLD); // Then send the actual string
+    wire.messages++;
+    wire.raw_bytes += text.size();
+    if (wire.link_rate > 0 && text.size() >= WIRE_MIN_BYTES) {
+        double n = text.size(), send_raw = n / wire.link_rate;
+        bool probe = wire.large++ % 16 == 0 || wire.compress_rate == 0;
+        double decompress = wire.decompress_rate[receiver];
+        if (probe || n / wire.compress_rate + n * wire.ratio / wire.link_rate + n / decompress < send_raw) {
+            double start = MPI_Wtime();
+            string packed = wire_compress(text);
+            smooth(wire.compress_rate, n / max(MPI_Wtime() - start, 1e-9));
+            smooth(wire.ratio, packed.size() / n);
+            if (packed.size() < text.size()) {
+                len = -(int)packed.size();
+                MPI_Send(&len, 1, MPI_INT, receiver, tag, MPI_COMM_WORLD);
+                MPI_Send(packed.data(), packed.size(), MPI_CHAR, receiver, tag, MPI_COMM_WORLD);
+                wire.packed++;
+                wire.wire_bytes += packed.size();
+                return;
+            }
+        }
+    }
+    wire.wire_bytes += text.size();
+    MPI_Send(&len, 1, MPI_INT, receiver, tag, MPI_COMM_WORLD);           // Send length first
+    MPI_Send(text.c_str(), len, MPI_CHAR, receiver, tag, MPI_COMM_WORLD); // Then send the actual string
 }
 
 // Function to receive a string from a specific sender process
-string receive_string(int sender) {
+string receive_string(int sender, int tag = 1) {
     int len;
-    MPI_Recv(&len, 1, MPI_INT, sender, 1, MPI_COMM_WORLD, MPI_STATUS_IGNORE); // Receive length
+    MPI_Recv(&len, 1, MPI_INT, sender, tag, MPI_COMM_WORLD, MPI_STATUS_IGNORE); // Receive length
+    if (len < 0) {                                  // Compressed payload: decode into the result
+        vector<char> packed(-len);
+        MPI_Recv(packed.data(), -len, MPI_CHAR, sender, tag, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        string res;
+        if (!wire_decompress(packed.data(), packed.size(), res)) {
+            cerr << "Corrupt compressed message from process " << sender << "\n";
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        return res;
+    }
     char *buf = new char[len];
-    MPI_Recv(buf, len, MPI_CHAR, sender, 1, MPI_COMM_WORLD, MPI_STATUS_IGNORE); // Receive string
-    string res(buf);
+    MPI_Recv(buf, len, MPI_CHAR, sender, tag, MPI_COMM_WORLD, MPI_STATUS_IGNORE); // Receive string
+    string res(buf, len - 1);                       // Payloads may be binary (result bitmaps)
     delete[] buf;
     return res;
 }
@@ -45,118 +361,2245 @@ string vector_to_string(const vector<Contact> &contacts, int start, int end) {
     return result;
 }
 
-// Converts a received string back into a vector of Contact objects
-vector<Contact> string_to_contacts(const string &text) {
-    vector<Contact> contacts;
-    istringstream iss(text);
-    string line;
-    while (getline(iss, line)) {
-        if (line.empty()) continue;
-        int comma = line.find(",");
-        if (comma == string::npos) continue;
-        contacts.push_back({line.substr(0, comma), line.substr(comma + 1)});
+// Merges the distinct tokens of every rank into one sorted dictionary known to all ranks.
+// Each rank deduplicates locally first, so only distinct tokens travel.
+vector<string> merge_token_dictionary(const vector<string> &local_distinct, int rank, int size) {
+    string mine;
+    for (const string &t : local_distinct) mine += t + "\n";
+    int len = mine.size();
+    vector<int> lens(size), displs(size);
+    MPI_Gather(&len, 1, MPI_INT, lens.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
+    string all;
+    if (rank == 0) {
+        for (int i = 1; i < size; i++) displs[i] = displs[i - 1] + lens[i - 1];
+        all.resize(displs[size - 1] + lens[size - 1]);
+    }
+    MPI_Gatherv(mine.data(), len, MPI_CHAR, &all[0], lens.data(), displs.data(), MPI_CHAR, 0, MPI_COMM_WORLD);
+
+    // Rank 0 merges the per-rank lists and broadcasts the result
+    string merged;
+    if (rank == 0) {
+        vector<string> tokens;
+        istringstream iss(all);
+        string t;
+        while (getline(iss, t)) tokens.push_back(t);
+        sort(tokens.begin(), tokens.end());
+        tokens.erase(unique(tokens.begin(), tokens.end()), tokens.end());
+        for (const string &tok : tokens) merged += tok + "\n";
+    }
+    int mlen = merged.size();
+    MPI_Bcast(&mlen, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    merged.resize(mlen);
+    MPI_Bcast(&merged[0], mlen, MPI_CHAR, 0, MPI_COMM_WORLD);
+
+    vector<string> dict;
+    istringstream iss(merged);
+    string t;
+    while (getline(iss, t)) dict.push_back(t);
+    return dict;
+}
+
+// Tokenizes records [begin, end) against the global dictionary (collective over all ranks)
+TokenIndex build_token_index(const vector<Contact> &contacts, int begin, int end, int rank, int size) {
+    TokenIndex index;
+    end = max(begin, min((int)contacts.size(), end));
+    vector<vector<string>> tokens;
+    vector<string> distinct;
+    for (int i = begin; i < end; i++) {
+        tokens.push_back(split_tokens(contacts[i].name));
+        distinct.insert(distinct.end(), tokens.back().begin(), tokens.back().end());
+    }
+    sort(distinct.begin(), distinct.end());
+    distinct.erase(unique(distinct.begin(), distinct.end()), distinct.end());
+    index.dict = merge_token_dictionary(distinct, rank, size);
+
+    // Encode every record as a short array of token IDs
+    unordered_map<string, int> id_of;
+    for (int t = 0; t < (int)index.dict.size(); t++) id_of[index.dict[t]] = t;
+    index.rec_start.push_back(0);
+    for (auto &rec : tokens) {
+        for (const string &t : rec) index.rec_tokens.push_back(id_of[t]);
+        index.rec_start.push_back(index.rec_tokens.size());
+    }
+
+    // Invert into postings lists with a counting sort over token IDs
+    index.post_start.assign(index.dict.size() + 1, 0);
+    for (int t : index.rec_tokens) index.post_start[t + 1]++;
+    for (size_t t = 0; t < index.dict.size(); t++) index.post_start[t + 1] += index.post_start[t];
+    index.postings.resize(index.rec_tokens.size());
+    vector<int> fill(index.post_start.begin(), index.post_start.end() - 1);
+    for (int r = 0; r + 1 < (int)index.rec_start.size(); r++)
+        for (int k = index.rec_start[r]; k < index.rec_start[r + 1]; k++)
+            index.postings[fill[index.rec_tokens[k]]++] = r;
+    return index;
+}
+
+// ---------------------------------------------------------------------------------------------
+// Snapshot building. The file format and the lookups live in phonebook_core.h; building the
+// minimal perfect hash is collective, every level's collision bitmap is reduced over all ranks.
+// ---------------------------------------------------------------------------------------------
+
+// MPI reduction over (seen once, seen more than once) word pairs: a bit set by two ranks collides
+void merge_collision_words(void *in, void *inout, int *len, MPI_Datatype *) {
+    const uint64_t *a = (const uint64_t *)in;
+    uint64_t *b = (uint64_t *)inout;
+    for (int i = 0; i < 2 * *len; i += 2) {
+        b[i + 1] |= a[i + 1] | (a[i] & b[i]);
+        b[i] |= a[i];
+    }
+}
+
+// Builds the snapshot of `contacts` (rank 0) and writes it to `path`. Collective: the distinct
+// name hashes are spread over all ranks, which build each MPH level together by reducing their
+// collision bitmaps with a custom MPI operation.
+void build_snapshot(const string &path, const vector<Contact> &contacts, int rank, int size) {
+    // Rank 0 sorts the records by normalized name and hashes every distinct name
+    vector<int> order;
+    vector<string> keys;
+    vector<KeyRange> key_ranges;
+    vector<uint64_t> hashes;
+    if (rank == 0) {
+        vector<string> norm(contacts.size());
+        for (size_t i = 0; i < contacts.size(); i++) norm[i] = normalize_key(contacts[i].name);
+        order.resize(contacts.size());
+        iota(order.begin(), order.end(), 0);
+        stable_sort(order.begin(), order.end(), [&](int a, int b) { return norm[a] < norm[b]; });
+        for (size_t i = 0; i < order.size(); i++) {
+            if (keys.empty() || norm[order[i]] != keys.back()) {
+                keys.push_back(norm[order[i]]);
+                key_ranges.push_back({(uint32_t)i, 0});
+                hashes.push_back(hash_key(keys.back()));
+            }
+            key_ranges.back().count++;
+        }
+    }
+
+    // Spread the hashes over all ranks
+    uint64_t nkeys = keys.size();
+    MPI_Bcast(&nkeys, 1, MPI_UINT64_T, 0, MPI_COMM_WORLD);
+    vector<int> counts(size), displs(size);
+    for (int r = 0; r < size; r++) {
+        counts[r] = nkeys * (r + 1) / size - nkeys * r / size;
+        displs[r] = nkeys * r / size;
+    }
+    vector<uint64_t> mine(counts[rank]);
+    MPI_Scatterv(hashes.data(), counts.data(), displs.data(), MPI_UINT64_T, mine.data(), counts[rank],
+                 MPI_UINT64_T, 0, MPI_COMM_WORLD);
+
+    MPI_Datatype pair_type;
+    MPI_Op collide;
+    MPI_Type_contiguous(2, MPI_UINT64_T, &pair_type);  // Keep (once, twice) words together when MPI splits buffers
+    MPI_Type_commit(&pair_type);
+    MPI_Op_create(merge_collision_words, 1, &collide);
+
+    SnapshotHeader hdr = {};
+    memcpy(hdr.magic, SNAPSHOT_MAGIC, 8);
+    vector<vector<uint64_t>> level_words;
+    uint64_t remaining = nkeys, placed = 0;
+    while (remaining > 0 && (int)hdr.levels < MPH_MAX_LEVELS) {
+        int l = hdr.levels;
+        uint64_t bits = (remaining + 511) / 512 * 512;   // gamma = 1, rounded to whole cache lines
+        vector<uint64_t> pairs(bits / 64 * 2, 0);
+        for (uint64_t h : mine) {
+            uint64_t pos = level_hash(h, l) % bits, bit = 1ULL << (pos % 64);
+            if (pairs[pos / 64 * 2] & bit) pairs[pos / 64 * 2 + 1] |= bit;
+            else pairs[pos / 64 * 2] |= bit;
+        }
+        MPI_Allreduce(MPI_IN_PLACE, pairs.data(), bits / 64, pair_type, collide, MPI_COMM_WORLD);
+
+        // Keys on a collision move to the next level
+        vector<uint64_t> next;
+        for (uint64_t h : mine) {
+            uint64_t pos = level_hash(h, l) % bits;
+            if (pairs[pos / 64 * 2 + 1] >> (pos % 64) & 1) next.push_back(h);
+        }
+        mine.swap(next);
+        vector<uint64_t> words(bits / 64);
+        for (size_t k = 0; k < words.size(); k++) words[k] = pairs[2 * k] & ~pairs[2 * k + 1];
+        hdr.level_bits[l] = bits;
+        hdr.level_base[l] = placed;
+        for (uint64_t w : words) placed += __builtin_popcountll(w);
+        level_words.push_back(words);
+        hdr.levels++;
+        uint64_t left = mine.size();
+        MPI_Allreduce(&left, &remaining, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+    }
+    MPI_Op_free(&collide);
+    MPI_Type_free(&pair_type);
+
+    // Keys still unplaced after the last level go to a small sorted fallback table on rank 0
+    int left = mine.size();
+    MPI_Gather(&left, 1, MPI_INT, counts.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
+    for (int r = 1; r < size; r++) displs[r] = displs[r - 1] + counts[r - 1];
+    vector<uint64_t> leftovers(rank == 0 ? displs[size - 1] + counts[size - 1] : 0);
+    MPI_Gatherv(mine.data(), left, MPI_UINT64_T, leftovers.data(), counts.data(), displs.data(), MPI_UINT64_T, 0,
+                MPI_COMM_WORLD);
+    if (rank != 0) return;
+
+    sort(leftovers.begin(), leftovers.end());
+    vector<uint64_t> fallback;
+    for (uint64_t h : leftovers) { fallback.push_back(h); fallback.push_back(placed++); }
+    hdr.fallback = leftovers.size();
+
+    // Per-cache-line rank counters
+    vector<vector<uint64_t>> level_ranks;
+    for (auto &words : level_words) {
+        vector<uint64_t> ranks;
+        uint64_t r = 0;
+        for (size_t k = 0; k < words.size(); k++) {
+            if (k % 8 == 0) ranks.push_back(r);
+            r += __builtin_popcountll(words[k]);
+        }
+        level_ranks.push_back(ranks);
+    }
+
+    // Records in name order, plus their offsets
+    string text;
+    vector<uint64_t> rec_off;
+    for (int i : order) {
+        rec_off.push_back(text.size());
+        text += contacts[i].name + "," + contacts[i].phone + "\n";
+    }
+    rec_off.push_back(text.size());
+    hdr.records = contacts.size();
+    hdr.keys = nkeys;
+    hdr.text_bytes = text.size();
+
+    // Lay out the sections
+    auto align8 = [](uint64_t x) { return (x + 7) / 8 * 8; };
+    uint64_t off = align8(sizeof(SnapshotHeader));
+    hdr.text_off = off;      off = align8(off + text.size());
+    hdr.rec_off = off;       off += rec_off.size() * 8;
+    hdr.range_off = off;     off = align8(off + nkeys * sizeof(KeyRange));
+    for (uint64_t l = 0; l < hdr.levels; l++) {
+        hdr.level_word_off[l] = off; off += level_words[l].size() * 8;
+        hdr.level_rank_off[l] = off; off += level_ranks[l].size() * 8;
+    }
+    hdr.fallback_off = off;  off += fallback.size() * 8;
+
+    // Slot of every key, computed through the finished hash itself
+    SnapshotView view = {&hdr, text.data(), rec_off.data(), nullptr, {}, {}, fallback.data(), nullptr, 0};
+    for (uint64_t l = 0; l < hdr.levels; l++) { view.words[l] = level_words[l].data(); view.ranks[l] = level_ranks[l].data(); }
+    vector<KeyRange> ranges(nkeys);
+    for (uint64_t k = 0; k < nkeys; k++) ranges[mph_lookup(view, hashes[k])] = key_ranges[k];
+
+    ofstream f(path, ios::binary);
+    auto put = [&](const void *p, uint64_t at, uint64_t len) {
+        f.seekp(at);
+        f.write((const char *)p, len);
+    };
+    put(&hdr, 0, sizeof hdr);
+    put(text.data(), hdr.text_off, text.size());
+    put(rec_off.data(), hdr.rec_off, rec_off.size() * 8);
+    put(ranges.data(), hdr.range_off, nkeys * sizeof(KeyRange));
+    for (uint64_t l = 0; l < hdr.levels; l++) {
+        put(level_words[l].data(), hdr.level_word_off[l], level_words[l].size() * 8);
+        put(level_ranks[l].data(), hdr.level_rank_off[l], level_ranks[l].size() * 8);
+    }
+    put(fallback.data(), hdr.fallback_off, fallback.size() * 8);
+    if (off > (uint64_t)f.tellp()) put("", off - 1, 1);   // Pad the final section
+    f.close();
+
+    uint64_t mph_bits = 0;
+    for (uint64_t l = 0; l < hdr.levels; l++) mph_bits += (level_words[l].size() + level_ranks[l].size()) * 64;
+    printf("Snapshot %s: %llu records, %llu distinct names, %llu MPH levels, %.2f bits per name.\n", path.c_str(),
+           (unsigned long long)hdr.records, (unsigned long long)nkeys, (unsigned long long)hdr.levels,
+           nkeys ? (double)mph_bits / nkeys : 0.0);
+}
+
+// Reads the contacts from the snapshot if one was given, otherwise from the phonebook files
+bool load_contacts(const Options &opt, const vector<string> &files, vector<Contact> &contacts) {
+    if (opt.snapshot.empty()) {
+        if (opt.ingest_threads > 0) ingest_phonebook(files, contacts, opt.ingest_threads);
+        else read_phonebook(files, contacts);
+        return true;
+    }
+    SnapshotView v;
+    if (!map_snapshot(opt.snapshot, v)) return false;
+    contacts = string_to_contacts(string(v.text, v.hdr->text_bytes));
+    munmap(v.base, v.bytes);
+    return true;
+}
+
+// ---------------------------------------------------------------------------------------------
+// Sorted output. Every rank sorts its own matches, and rank 0 merges the sorted runs with a
+// loser tree while they stream in block by block, writing each record as soon as it wins.
+// ---------------------------------------------------------------------------------------------
+
+const size_t RUN_BLOCK_BYTES = 1 << 16;    // Text per streamed block of a sorted run
+
+// Sorts local record numbers by name or phone: an LSD radix sort on the first 8 key bytes, then
+// records that share the whole prefix are ordered by comparing their full keys. Stable.
+void sort_records(const vector<Contact> &contacts, int begin, vector<int> &ids, bool by_phone) {
+    auto key = [&](int r) -> const string & { return by_phone ? contacts[begin + r].phone : contacts[begin + r].name; };
+    size_t n = ids.size();
+    vector<uint64_t> pre(n), pre2(n);
+    vector<int> ids2(n);
+    for (size_t i = 0; i < n; i++) {
+        const string &k = key(ids[i]);
+        uint64_t p = 0;
+        for (size_t b = 0; b < 8; b++) p = p << 8 | (b < k.size() ? (unsigned char)k[b] : 0);
+        pre[i] = p;
+    }
+    for (int shift = 0; shift < 64; shift += 8) {
+        size_t count[257] = {0};
+        for (size_t i = 0; i < n; i++) count[(pre[i] >> shift & 255) + 1]++;
+        if (*max_element(count + 1, count + 257) == n) continue;  // All keys share this byte
+        for (int b = 0; b < 256; b++) count[b + 1] += count[b];
+        for (size_t i = 0; i < n; i++) {
+            size_t dst = count[pre[i] >> shift & 255]++;
+            pre2[dst] = pre[i];
+            ids2[dst] = ids[i];
+        }
+        pre.swap(pre2);
+        ids.swap(ids2);
+    }
+    for (size_t i = 0, j; i < n; i = j) {
+        bool longer = key(ids[i]).size() > 8;     // Only keys past the prefix can still differ
+        for (j = i + 1; j < n && pre[j] == pre[i]; j++) longer |= key(ids[j]).size() > 8;
+        if (j - i > 1 && longer)
+            stable_sort(ids.begin() + i, ids.begin() + j, [&](int a, int b) { return key(a) < key(b); });
+    }
+}
+
+// Worker side: streams the sorted matches to rank 0 in "name,phone" blocks, then an empty block
+void send_sorted_run(const vector<Contact> &contacts, const vector<int> &sorted) {
+    string block;
+    for (int r : sorted) {
+        block += contacts[r].name + "," + contacts[r].phone + "\n";
+        if (block.size() >= RUN_BLOCK_BYTES) {
+            send_string(block, 0, TAG_RUN);
+            block.clear();
+        }
+    }
+    if (!block.empty()) send_string(block, 0, TAG_RUN);
+    send_string("", 0, TAG_RUN);
+}
+
+// Rank 0 side: k-way merge of its own sorted matches with the runs streamed by ranks 1..size-1.
+// Sources are the leaves of a loser tree; tree[0] holds the current winner, and advancing it
+// replays one leaf-to-root path. Ties go to the lower rank, which keeps the unsorted order.
+void merge_sorted_runs(const vector<Contact> &local, const vector<int> &local_sorted, int size, bool by_phone,
+                       ostream &out) {
+    struct Source { vector<Contact> block; size_t pos; bool done; };
+    int k = size;
+    vector<Source> src(k);
+    for (int r : local_sorted) src[0].block.push_back(local[r]);
+    src[0].pos = 0;
+    src[0].done = src[0].block.empty();
+    auto refill = [&](int s) {                      // Pull the next block of a worker's run
+        src[s].block = string_to_contacts(receive_string(s, TAG_RUN));
+        src[s].pos = 0;
+        src[s].done = src[s].block.empty();
+    };
+    for (int s = 1; s < k; s++) refill(s);
+
+    auto head = [&](int s) -> const string & {
+        const Contact &c = src[s].block[src[s].pos];
+        return by_phone ? c.phone : c.name;
+    };
+    auto less = [&](int a, int b) {                 // Does source a's head come before source b's?
+        if (src[a].done || src[b].done) return !src[a].done && src[b].done;
+        int cmp = head(a).compare(head(b));
+        return cmp < 0 || (cmp == 0 && a < b);
+    };
+
+    vector<int> tree(max(k, 1));
+    function<int(int)> build = [&](int node) {
+        if (node >= k) return node - k;
+        int a = build(2 * node), b = build(2 * node + 1);
+        if (less(b, a)) swap(a, b);
+        tree[node] = b;                             // The loser stays at this node
+        return a;
+    };
+    tree[0] = build(1);
+
+    while (!src[tree[0]].done) {
+        int s = tree[0];
+        const Contact &c = src[s].block[src[s].pos];
+        out << c.name << " " << c.phone << "\n";
+        if (++src[s].pos == src[s].block.size()) {
+            if (s == 0) src[0].done = true;
+            else refill(s);
+        }
+        int winner = s;
+        for (int node = (s + k) / 2; node >= 1; node /= 2)
+            if (less(tree[node], winner)) swap(tree[node], winner);
+        tree[0] = winner;
+    }
+}
+
+// ---------------------------------------------------------------------------------------------
+// Result sets as Roaring-style compressed bitmaps over global record IDs (positions in the loaded
+// phonebook). IDs are split into a 16-bit container key and a 16-bit low part; a container holds
+// a sorted array of low parts while it has at most 4096 of them and a 65536-bit bitmap otherwise.
+// ---------------------------------------------------------------------------------------------
+
+const size_t ROARING_ARRAY_MAX = 4096;
+
+struct RoaringContainer {
+    uint16_t key;
+    vector<uint16_t> array;              // Sorted low parts (sparse form)
+    vector<uint64_t> bits;               // 1024 words (dense form); empty while sparse
+};
+
+struct Roaring {
+    vector<RoaringContainer> c;          // Sorted by key, no empty containers
+};
+
+// Number of IDs in a container
+size_t container_size(const RoaringContainer &c) {
+    if (c.bits.empty()) return c.array.size();
+    size_t n = 0;
+    for (uint64_t w : c.bits) n += __builtin_popcountll(w);
+    return n;
+}
+
+// Switches a container to whichever form suits its size
+void normalize_container(RoaringContainer &c) {
+    size_t n = container_size(c);
+    if (c.bits.empty() && n > ROARING_ARRAY_MAX) {
+        c.bits.assign(1024, 0);
+        for (uint16_t v : c.array) c.bits[v / 64] |= 1ULL << (v % 64);
+        c.array.clear();
+    } else if (!c.bits.empty() && n <= ROARING_ARRAY_MAX) {
+        c.array.clear();
+        for (int w = 0; w < 1024; w++)
+            for (uint64_t x = c.bits[w]; x; x &= x - 1) c.array.push_back(w * 64 + __builtin_ctzll(x));
+        c.bits.clear();
+    }
+}
+
+// Appends an ID; IDs must be added in increasing order
+void roaring_add(Roaring &r, uint32_t id) {
+    uint16_t key = id >> 16, low = id & 0xFFFF;
+    if (r.c.empty() || r.c.back().key != key) r.c.push_back({key, {}, {}});
+    RoaringContainer &c = r.c.back();
+    if (!c.bits.empty()) c.bits[low / 64] |= 1ULL << (low % 64);
+    else if (c.array.push_back(low), c.array.size() > ROARING_ARRAY_MAX) normalize_container(c);
+}
+
+// Number of IDs in the set
+size_t roaring_size(const Roaring &r) {
+    size_t n = 0;
+    for (auto &c : r.c) n += container_size(c);
+    return n;
+}
+
+// Calls f(id) for every ID in increasing order
+template <class F> void roaring_for_each(const Roaring &r, F f) {
+    for (auto &c : r.c) {
+        uint32_t base = (uint32_t)c.key << 16;
+        if (c.bits.empty()) {
+            for (uint16_t v : c.array) f(base | v);
+        } else {
+            for (int w = 0; w < 1024; w++)
+                for (uint64_t x = c.bits[w]; x; x &= x - 1) f(base | (w * 64 + __builtin_ctzll(x)));
+        }
+    }
+}
+
+// Combines two containers with the same key; op is 'a' (and), 'o' (or) or 'n' (and not)
+RoaringContainer combine_containers(const RoaringContainer &a, const RoaringContainer &b, char op) {
+    RoaringContainer out = {a.key, {}, {}};
+    if (a.bits.empty() && b.bits.empty()) {
+        auto dst = back_inserter(out.array);
+        if (op == 'a') set_intersection(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(), dst);
+        else if (op == 'o') set_union(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(), dst);
+        else set_difference(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(), dst);
+    } else {
+        // At least one side is dense: work on words
+        auto words = [](const RoaringContainer &c) {
+            if (!c.bits.empty()) return c.bits;
+            vector<uint64_t> w(1024, 0);
+            for (uint16_t v : c.array) w[v / 64] |= 1ULL << (v % 64);
+            return w;
+        };
+        vector<uint64_t> x = words(a), y = words(b);
+        for (int w = 0; w < 1024; w++) x[w] = op == 'a' ? x[w] & y[w] : op == 'o' ? x[w] | y[w] : x[w] & ~y[w];
+        out.bits = x;
+    }
+    normalize_container(out);
+    return out;
+}
+
+// Set algebra between two result sets
+Roaring roaring_combine(const Roaring &a, const Roaring &b, char op) {
+    Roaring out;
+    size_t i = 0, j = 0;
+    while (i < a.c.size() || j < b.c.size()) {
+        bool take_a = j == b.c.size() || (i < a.c.size() && a.c[i].key < b.c[j].key);
+        bool take_b = i == a.c.size() || (j < b.c.size() && b.c[j].key < a.c[i].key);
+        if (take_a) {
+            if (op != 'a') out.c.push_back(a.c[i]);
+            i++;
+        } else if (take_b) {
+            if (op == 'o') out.c.push_back(b.c[j]);
+            j++;
+        } else {
+            RoaringContainer c = combine_containers(a.c[i++], b.c[j++], op);
+            if (container_size(c) > 0) out.c.push_back(c);
+        }
+    }
+    return out;
+}
+
+// Serializes a set: container count, then key, form, size and payload of every container
+string roaring_serialize(const Roaring &r) {
+    string out;
+    auto put = [&](const void *p, size_t n) { out.append((const char *)p, n); };
+    uint32_t n = r.c.size();
+    put(&n, 4);
+    for (auto &c : r.c) {
+        uint8_t dense = !c.bits.empty();
+        uint32_t count = dense ? 1024 : c.array.size();
+        put(&c.key, 2);
+        put(&dense, 1);
+        put(&count, 4);
+        if (dense) put(c.bits.data(), 1024 * 8);
+        else put(c.array.data(), count * 2);
+    }
+    return out;
+}
+
+// Inverse of roaring_serialize; returns false on truncated input
+bool roaring_deserialize(const string &data, Roaring &r) {
+    size_t pos = 0;
+    auto get = [&](void *p, size_t n) {
+        if (pos + n > data.size()) return false;
+        memcpy(p, data.data() + pos, n);
+        pos += n;
+        return true;
+    };
+    uint32_t n;
+    r.c.clear();
+    if (!get(&n, 4)) return false;
+    for (uint32_t i = 0; i < n; i++) {
+        RoaringContainer c = {0, {}, {}};
+        uint8_t dense;
+        uint32_t count;
+        if (!get(&c.key, 2) || !get(&dense, 1) || !get(&count, 4)) return false;
+        if (dense) { c.bits.resize(1024); if (count != 1024 || !get(c.bits.data(), 1024 * 8)) return false; }
+        else {
+            if (count > (data.size() - pos) / 2) return false; // Checked before a corrupt count can allocate
+            c.array.resize(count);
+            get(c.array.data(), count * 2);
+        }
+        r.c.push_back(c);
+    }
+    return pos == data.size();
+}
+
+// Writes a named result to the cache, tagged with the record count of the phonebook it indexes
+bool save_result_set(const Options &opt, const string &name, const Roaring &r, uint64_t records) {
+    mkdir(opt.cache.c_str(), 0755);
+    ofstream f(opt.cache + "/" + name + ".roar", ios::binary);
+    string data = roaring_serialize(r);
+    f.write("PBROAR1", 8);
+    f.write((const char *)&records, 8);
+    f.write(data.data(), data.size());
+    return (bool)f;
+}
+
+// Reads a named result; fails if it is missing or was computed over a different phonebook size
+bool load_result_set(const Options &opt, const string &name, Roaring &r, uint64_t records) {
+    ifstream f(opt.cache + "/" + name + ".roar", ios::binary);
+    string data((istreambuf_iterator<char>(f)), istreambuf_iterator<char>());
+    uint64_t saved;
+    if (data.size() < 16 || data.compare(0, 7, "PBROAR1") != 0) return false;
+    memcpy(&saved, data.data() + 8, 8);
+    return saved == records && roaring_deserialize(data.substr(16), r);
+}
+
+// Applies the --and/--or/--andnot chain, saves the result if asked and renders it as text.
+// This is the only place a result set turns into names and phones.
+bool finish_result_set(const Options &opt, Roaring result, const vector<Contact> &contacts, string &text) {
+    for (auto &[op, name] : opt.set_ops) {
+        Roaring other;
+        if (!load_result_set(opt, name, other, contacts.size())) {
+            cerr << "Result set '" << name << "' is missing, corrupt or belongs to another phonebook.\n";
+            return false;
+        }
+        result = roaring_combine(result, other, op == "and" ? 'a' : op == "or" ? 'o' : 'n');
+    }
+    if (!opt.save.empty() && !save_result_set(opt, opt.save, result, contacts.size())) {
+        cerr << "Cannot write result set '" << opt.save << "'.\n";
+        return false;
+    }
+    vector<int> ids;
+    roaring_for_each(result, [&](uint32_t id) { ids.push_back(id); });
+    if (!opt.sort.empty()) sort_records(contacts, 0, ids, opt.sort == "phone");
+    text = format_matches(contacts, 0, ids);
+    return true;
+}
+
+// Splits the records into `parts` contiguous ranges of about equal name bytes, since the scan
+// cost follows bytes rather than record count. `share` optionally gives each part's fraction of
+// the bytes (e.g. from measured rank speeds); empty means equal shares. Returns parts+1 bounds.
+vector<int> partition_by_bytes(const vector<Contact> &contacts, int parts, const vector<double> &share) {
+    int n = contacts.size();
+    vector<uint64_t> prefix(n + 1, 0);              // prefix[i] = bytes of records [0, i)
+    for (int i = 0; i < n; i++) prefix[i + 1] = prefix[i] + contacts[i].name.size() + 1;
+    vector<int> bounds(parts + 1, 0);
+    bounds[parts] = n;
+    double cum = 0;
+    for (int p = 1; p < parts; p++) {
+        cum += share.empty() ? 1.0 / parts : share[p - 1];
+        uint64_t target = cum * prefix[n];
+        bounds[p] = lower_bound(prefix.begin(), prefix.end(), target) - prefix.begin();
+        bounds[p] = min(n, max(bounds[p], bounds[p - 1]));
+    }
+    return bounds;
+}
+
+// Reads the per-rank speeds of the previous run and turns them into byte shares; empty if the
+// file is missing or was written for a different number of processes
+vector<double> read_speed_shares(const string &path, int size) {
+    vector<double> speed;
+    ifstream f(path);
+    double v;
+    while (f >> v) speed.push_back(v);
+    if ((int)speed.size() != size || *min_element(speed.begin(), speed.end()) <= 0) return {};
+    double sum = accumulate(speed.begin(), speed.end(), 0.0);
+    for (double &x : speed) x /= sum;               // A rank twice as fast gets twice the bytes
+    return speed;
+}
+
+// Collects every rank's scan speed (name bytes per second) and saves them for the next run.
+// Collective; ranks whose scan was too short to time keep the speed they had before.
+void record_speeds(const string &path, const vector<Contact> &contacts, int begin, int end, double seconds,
+                   int rank, int size) {
+    double bytes = 0;
+    for (int i = begin; i < min(end, (int)contacts.size()); i++) bytes += contacts[i].name.size() + 1;
+    double speed = seconds > 1e-4 ? bytes / seconds : 0;
+    vector<double> all(size);
+    MPI_Gather(&speed, 1, MPI_DOUBLE, all.data(), 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    if (rank != 0) return;
+    vector<double> old;
+    ifstream in(path);
+    double v;
+    while (in >> v) old.push_back(v);
+    in.close();
+    ofstream out(path);
+    for (int r = 0; r < size; r++) {
+        if (all[r] <= 0) all[r] = (int)old.size() == size ? old[r] : 0;
+        out << all[r] << "\n";
+    }
+}
+
+// A contact tagged with a routing key and its global record ID, as shipped between ranks
+struct KeyedRecord {
+    uint64_t key;
+    uint32_t gid;
+    string name, phone;
+};
+
+// Appends a keyed record to a byte buffer: key, ID, then the name and phone with 32-bit lengths
+void pack_record(string &buf, uint64_t key, uint32_t gid, const Contact &c) {
+    uint32_t nlen = c.name.size(), plen = c.phone.size();
+    buf.append((const char *)&key, 8).append((const char *)&gid, 4);
+    buf.append((const char *)&nlen, 4).append(c.name);
+    buf.append((const char *)&plen, 4).append(c.phone);
+}
+
+// Decodes every record packed into a buffer
+vector<KeyedRecord> unpack_records(const string &buf) {
+    vector<KeyedRecord> recs;
+    for (size_t pos = 0; pos < buf.size();) {
+        KeyedRecord e;
+        uint32_t len;
+        memcpy(&e.key, &buf[pos], 8);
+        memcpy(&e.gid, &buf[pos + 8], 4);
+        memcpy(&len, &buf[pos + 12], 4);
+        e.name = buf.substr(pos + 16, len);
+        pos += 16 + len;
+        memcpy(&len, &buf[pos], 4);
+        e.phone = buf.substr(pos + 4, len);
+        pos += 4 + len;
+        recs.push_back(e);
+    }
+    return recs;
+}
+
+// Personalized all-to-all of byte buffers: outbox[r] goes to rank r, and the concatenation of
+// what every rank sent here comes back. The outbox is released on the way.
+string exchange_bytes(vector<string> &outbox, int size) {
+    vector<int> scounts(size), rcounts(size), sdispls(size), rdispls(size);
+    string sendbuf;
+    for (int r = 0; r < size; r++) {
+        sdispls[r] = sendbuf.size();
+        scounts[r] = outbox[r].size();
+        sendbuf += outbox[r];
+        string().swap(outbox[r]);
+    }
+    MPI_Alltoall(scounts.data(), 1, MPI_INT, rcounts.data(), 1, MPI_INT, MPI_COMM_WORLD);
+    for (int r = 1; r < size; r++) rdispls[r] = rdispls[r - 1] + rcounts[r - 1];
+    string recvbuf(rdispls[size - 1] + rcounts[size - 1], '\0');
+    MPI_Alltoallv(sendbuf.data(), scounts.data(), sdispls.data(), MPI_CHAR, &recvbuf[0], rcounts.data(),
+                  rdispls.data(), MPI_CHAR, MPI_COMM_WORLD);
+    return recvbuf;
+}
+
+// ---------------------------------------------------------------------------------------------
+// Near-duplicate clustering. Every rank computes MinHash signatures over the character 3-grams of
+// its normalized names and cuts them into LSH bands. Each band value is sent to the rank that owns
+// its bucket with one MPI_Alltoallv; bucket owners verify candidate pairs by exact shingle
+// Jaccard similarity, and the verified pairs are clustered with a union-find whose per-rank
+// spanning forests are merged pairwise up a binary tree.
+// ---------------------------------------------------------------------------------------------
+
+const int MINHASH_BANDS = 16, MINHASH_ROWS = 4;    // 64 hashes; candidates from ~0.5 similarity up
+const int BUCKET_WINDOW = 8;                         // Neighbours compared inside one bucket
+
+// Sorted distinct hashes of a name's character 3-grams (padded so short names still get some)
+vector<uint64_t> name_shingles(const string &name) {
+    string s = "  " + normalize_key(name) + " ";
+    vector<uint64_t> sh;
+    for (size_t i = 0; i + 3 <= s.size(); i++) sh.push_back(hash_key(s.substr(i, 3)));
+    sort(sh.begin(), sh.end());
+    sh.erase(unique(sh.begin(), sh.end()), sh.end());
+    return sh;
+}
+
+// Jaccard similarity of two sorted shingle sets
+double jaccard(const vector<uint64_t> &a, const vector<uint64_t> &b) {
+    size_t i = 0, j = 0, common = 0;
+    while (i < a.size() && j < b.size()) {
+        if (a[i] == b[j]) { common++; i++; j++; }
+        else if (a[i] < b[j]) i++;
+        else j++;
+    }
+    size_t all = a.size() + b.size() - common;
+    return all ? (double)common / all : 1.0;
+}
+
+// Union-find over global record IDs, kept sparse since only records with a duplicate appear
+struct UnionFind {
+    unordered_map<uint32_t, uint32_t> parent;
+    uint32_t find(uint32_t x) {
+        auto it = parent.find(x);
+        if (it == parent.end()) { parent[x] = x; return x; }
+        while (it->second != x) {                   // Path halving: skip to the grandparent
+            it->second = parent.find(it->second)->second;
+            x = it->second;
+            it = parent.find(x);
+        }
+        return x;
+    }
+    void unite(uint32_t a, uint32_t b) {
+        a = find(a); b = find(b);
+        if (a != b) parent[max(a, b)] = min(a, b); // The smallest ID becomes the representative
+    }
+    // Edges (x, root) that reproduce the same components
+    vector<uint32_t> forest() {
+        vector<uint32_t> edges;
+        for (auto &kv : parent) {
+            uint32_t root = find(kv.first);
+            if (root != kv.first) { edges.push_back(kv.first); edges.push_back(root); }
+        }
+        return edges;
+    }
+};
+
+// Runs the dedup job over this rank's records [0, contacts.size()), whose global IDs start at
+// `first_id`. Collective; rank 0 gets the clusters as lists of global IDs.
+vector<vector<uint32_t>> dedup_clusters(const vector<Contact> &contacts, uint32_t first_id, double threshold,
+                                        int rank, int size, long long stats[3]) {
+    // MinHash signatures, banded and routed to the bucket owners
+    vector<string> outbox(size);
+    for (size_t i = 0; i < contacts.size(); i++) {
+        vector<uint64_t> sh = name_shingles(contacts[i].name);
+        uint64_t sig[MINHASH_BANDS * MINHASH_ROWS];
+        for (int k = 0; k < MINHASH_BANDS * MINHASH_ROWS; k++) {
+            uint64_t best = UINT64_MAX;
+            for (uint64_t h : sh) best = min(best, level_hash(h, k));
+            sig[k] = best;
+        }
+        uint32_t gid = first_id + i;
+        for (int b = 0; b < MINHASH_BANDS; b++) {
+            uint64_t key = b;
+            for (int r = 0; r < MINHASH_ROWS; r++) key = level_hash(key ^ sig[b * MINHASH_ROWS + r], 100 + b);
+            pack_record(outbox[key % size], key, gid, contacts[i]);
+        }
+    }
+
+    // This rank's buckets, each sorted by record ID
+    vector<KeyedRecord> entries = unpack_records(exchange_bytes(outbox, size));
+    sort(entries.begin(), entries.end(), [](const KeyedRecord &a, const KeyedRecord &b) {
+        return a.key != b.key ? a.key < b.key : a.gid < b.gid;
+    });
+
+    // Candidate pairs: records sharing a bucket, each compared with its next few neighbours so a
+    // huge bucket stays linear (union-find closes the chains)
+    unordered_set<uint64_t> tried;                  // Pairs already verified via another band
+    UnionFind uf;
+    for (size_t i = 0; i < entries.size(); i++) {
+        for (size_t j = i + 1; j < entries.size() && j <= i + BUCKET_WINDOW && entries[j].key == entries[i].key; j++) {
+            if (entries[i].gid == entries[j].gid || !tried.insert((uint64_t)entries[i].gid << 32 | entries[j].gid).second)
+                continue;
+            stats[0]++;
+            double sim = jaccard(name_shingles(entries[i].name), name_shingles(entries[j].name));
+            bool same_phone = phone_digits(entries[i].phone) == phone_digits(entries[j].phone);
+            if (sim >= threshold || (same_phone && sim >= threshold / 2)) { // A shared phone lowers the bar
+                uf.unite(entries[i].gid, entries[j].gid);
+                stats[1]++;
+            }
+        }
+    }
+
+    // Merge the spanning forests up a binary tree: in round d, rank r + d hands its forest to r
+    vector<uint32_t> forest = uf.forest();
+    for (int d = 1; d < size; d *= 2) {
+        if (rank % (2 * d) == d) {
+            int n = forest.size();
+            MPI_Send(&n, 1, MPI_INT, rank - d, 2, MPI_COMM_WORLD);
+            MPI_Send(forest.data(), n, MPI_UINT32_T, rank - d, 2, MPI_COMM_WORLD);
+            break;
+        }
+        if (rank % (2 * d) == 0 && rank + d < size) {
+            int n;
+            MPI_Recv(&n, 1, MPI_INT, rank + d, 2, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+            vector<uint32_t> other(n);
+            MPI_Recv(other.data(), n, MPI_UINT32_T, rank + d, 2, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+            for (int k = 0; k + 1 < n; k += 2) uf.unite(other[k], other[k + 1]);
+            forest = uf.forest();
+        }
+    }
+    MPI_Reduce(rank == 0 ? MPI_IN_PLACE : stats, stats, 2, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+
+    vector<vector<uint32_t>> clusters;
+    if (rank != 0) return clusters;
+    map<uint32_t, vector<uint32_t>> by_root;
+    for (auto &kv : uf.parent) by_root[uf.find(kv.first)].push_back(kv.first);
+    for (auto &kv : by_root) {
+        sort(kv.second.begin(), kv.second.end());
+        clusters.push_back(kv.second);
+    }
+    stats[2] = clusters.size();
+    return clusters;
+}
+
+// ---------------------------------------------------------------------------------------------
+// Distributed hash join of two phonebooks. Both inputs are shuffled to the rank owning each join
+// key with MPI_Alltoallv; every rank then splits its two sides into cache-sized partitions by hash
+// bits and joins partition by partition with a small open-addressing table on the build side.
+// Joined pairs stream to rank 0 in blocks while the join runs.
+// ---------------------------------------------------------------------------------------------
+
+const size_t JOIN_PARTITION_ROWS = 1024;           // Build rows per radix partition
+
+// Routes each local row to the rank that owns its join key; returns the rows this rank owns
+vector<KeyedRecord> shuffle_by_key(const vector<Contact> &rows, bool by_phone, int size) {
+    vector<string> outbox(size);
+    for (size_t i = 0; i < rows.size(); i++) {
+        uint64_t h = hash_key(join_key(rows[i].name, rows[i].phone, by_phone));
+        pack_record(outbox[h % size], h, i, rows[i]);
+    }
+    return unpack_records(exchange_bytes(outbox, size));
+}
+
+// Radix-partitioned hash join. emit(a, b) gets each matching pair with `a` from the first input;
+// `between` runs after every partition so rank 0 can drain incoming result blocks meanwhile.
+template <class Emit, class Between>
+void radix_hash_join(const vector<KeyedRecord> &a, const vector<KeyedRecord> &b, bool by_phone, Emit emit,
+                     Between between) {
+    bool a_builds = a.size() <= b.size();           // Build on the smaller side
+    const vector<KeyedRecord> &build = a_builds ? a : b, &probe = a_builds ? b : a;
+    int bits = 0;
+    while ((build.size() >> bits) > JOIN_PARTITION_ROWS && bits < 16) bits++;
+    uint64_t parts = 1ULL << bits;
+
+    // Counting-sort both sides into partitions by the top hash bits
+    auto partition = [&](const vector<KeyedRecord> &rows, vector<uint32_t> &start, vector<uint32_t> &order) {
+        start.assign(parts + 1, 0);
+        for (auto &r : rows) start[(bits ? r.key >> (64 - bits) : 0) + 1]++;
+        for (uint64_t p = 0; p < parts; p++) start[p + 1] += start[p];
+        vector<uint32_t> fill(start.begin(), start.end() - 1);
+        order.resize(rows.size());
+        for (uint32_t i = 0; i < rows.size(); i++) order[fill[bits ? rows[i].key >> (64 - bits) : 0]++] = i;
+    };
+    vector<uint32_t> bstart, border, pstart, porder;
+    partition(build, bstart, border);
+    partition(probe, pstart, porder);
+
+    vector<string> build_keys(build.size());
+    vector<int> table;
+    for (uint64_t p = 0; p < parts; p++) {
+        uint32_t nb = bstart[p + 1] - bstart[p];
+        if (nb == 0 || pstart[p + 1] == pstart[p]) continue;
+        size_t cap = 16;
+        while (cap < 2 * nb) cap *= 2;
+        table.assign(cap, -1);
+        for (uint32_t k = bstart[p]; k < bstart[p + 1]; k++) {
+            uint32_t i = border[k];
+            build_keys[i] = join_key(build[i].name, build[i].phone, by_phone);
+            size_t slot = level_hash(build[i].key, 0) & (cap - 1); // Owner ranks fix the low key bits
+            while (table[slot] >= 0) slot = (slot + 1) & (cap - 1);
+            table[slot] = i;
+        }
+        for (uint32_t k = pstart[p]; k < pstart[p + 1]; k++) {
+            const KeyedRecord &row = probe[porder[k]];
+            string key;
+            for (size_t slot = level_hash(row.key, 0) & (cap - 1); table[slot] >= 0; slot = (slot + 1) & (cap - 1)) {
+                const KeyedRecord &other = build[table[slot]];
+                if (other.key != row.key) continue;
+                if (key.empty()) key = join_key(row.name, row.phone, by_phone);
+                if (build_keys[table[slot]] != key) continue;
+                if (a_builds) emit(other, row);
+                else emit(row, other);
+            }
+        }
+        between();
+    }
+}
+
+// Runs the join over this rank's slices of both inputs. Collective. Rank 0 writes every pair to
+// `out` (its own as produced, the others' as their blocks arrive); returns the local pair count.
+long long distributed_join(const vector<Contact> &a, const vector<Contact> &b, bool by_phone, int rank, int size,
+                           ostream &out) {
+    vector<KeyedRecord> ra = shuffle_by_key(a, by_phone, size);
+    vector<KeyedRecord> rb = shuffle_by_key(b, by_phone, size);
+    long long pairs = 0;
+    int finished = 0;                               // Workers whose final block rank 0 has seen
+    string block;
+    auto drain = [&](bool wait) {                   // Rank 0: write the blocks that have arrived
+        int flag = 1;
+        MPI_Status st;
+        while (finished < size - 1) {
+            if (wait) MPI_Probe(MPI_ANY_SOURCE, TAG_JOIN, MPI_COMM_WORLD, &st);
+            else MPI_Iprobe(MPI_ANY_SOURCE, TAG_JOIN, MPI_COMM_WORLD, &flag, &st);
+            if (!flag) break;
+            string got = receive_string(st.MPI_SOURCE, TAG_JOIN);
+            if (got.empty()) finished++;
+            out << got;
+        }
+    };
+    auto emit = [&](const KeyedRecord &x, const KeyedRecord &y) {
+        block += x.name + " " + x.phone + " | " + y.name + " " + y.phone + "\n";
+        pairs++;
+        if (block.size() < RUN_BLOCK_BYTES) return;
+        if (rank == 0) out << block;
+        else send_string(block, 0, TAG_JOIN);
+        block.clear();
+    };
+    radix_hash_join(ra, rb, by_phone, emit, [&] { if (rank == 0) drain(false); });
+    if (rank == 0) {
+        out << block;
+        drain(true);
+    } else {
+        if (!block.empty()) send_string(block, 0, TAG_JOIN);
+        send_string("", 0, TAG_JOIN);
+    }
+    return pairs;
+}
+
+// ---------------------------------------------------------------------------------------------
+// Approximate answers. Every rank draws a stratified sample of its partition at load time
+// (strata: the leading byte of the name) and estimates how many records match a term, with a
+// 95% confidence interval. In the same pass it fills mergeable sketches over the normalized
+// names: HyperLogLog registers for distinct names, tokens and surnames (merged with MPI_MAX)
+// and a Count-Min table of per-token contact counts (merged with MPI_SUM). Once reduced to
+// rank 0 the sketches answer in microseconds.
+// ---------------------------------------------------------------------------------------------
+
+const int HLL_BITS = 14, HLL_REGISTERS = 1 << HLL_BITS;  // 16K registers: 0.81% standard error
+const int CMS_DEPTH = 4, CMS_WIDTH = 4096;               // Overcount <= e/4096 of all tokens, w.p. 1 - e^-4
+enum { HLL_NAMES, HLL_TOKENS, HLL_SURNAMES, HLL_KINDS }; // What each register array counts
+
+// The sketches of one rank (or, after reduce_sketches, of the whole phonebook)
+struct Sketches {
+    vector<uint8_t> hll = vector<uint8_t>(HLL_KINDS * HLL_REGISTERS, 0); // Register arrays back to back
+    vector<uint32_t> cms = vector<uint32_t>(CMS_DEPTH * CMS_WIDTH, 0);   // Count-Min rows back to back
+};
+
+// A stratified sample of one rank's records
+struct Sample {
+    vector<Contact> records;              // Sampled records (normalized names with --normalize)
+    vector<int> stratum;                  // Stratum of each sampled record
+    vector<long long> population, drawn;  // Records and sampled records per stratum
+};
+
+// Hash of a sketch key; the salt gives independent hashes for the Count-Min rows
+uint64_t sketch_hash(const string &key, int salt) {
+    return level_hash(hash_key(key), salt);
+}
+
+// Adds a hashed value to a HyperLogLog register array: the top bits pick the register, which
+// keeps the longest run of leading zeros seen in the remaining bits
+void hll_add(uint8_t *reg, uint64_t h) {
+    uint64_t rest = h << HLL_BITS;
+    uint8_t rho = rest ? __builtin_clzll(rest) + 1 : 64 - HLL_BITS + 1;
+    uint8_t &r = reg[h >> (64 - HLL_BITS)];
+    r = max(r, rho);
+}
+
+// Estimates the number of distinct values added to a register array (linear counting when small)
+double hll_estimate(const uint8_t *reg) {
+    static double inverse_power[65];                 // 2^-r for every register value
+    if (inverse_power[0] == 0)
+        for (int r = 0; r <= 64; r++) inverse_power[r] = ldexp(1.0, -r);
+    double sum = 0, m = HLL_REGISTERS;
+    int zeros = 0;
+    for (int i = 0; i < HLL_REGISTERS; i++) {
+        sum += inverse_power[reg[i]];
+        zeros += reg[i] == 0;
+    }
+    double estimate = 0.7213 / (1 + 1.079 / m) * m * m / sum;
+    if (estimate <= 2.5 * m && zeros > 0) estimate = m * log(m / zeros); // Small-range correction
+    return estimate;
+}
+
+// Contacts whose name contains the token, as seen by the Count-Min table (never an undercount)
+uint32_t cms_estimate(const Sketches &sk, const string &token) {
+    uint32_t best = UINT32_MAX;
+    for (int d = 0; d < CMS_DEPTH; d++) best = min(best, sk.cms[d * CMS_WIDTH + sketch_hash(token, d + 1) % CMS_WIDTH]);
+    return best;
+}
+
+// Adds records [begin, end) to the sketches. Names are keyed like the snapshot (NFKC, case
+// folded, single spaces); a contact counts once per distinct token, its last token is the surname.
+void build_sketches(Sketches &sk, const vector<Contact> &contacts, int begin, int end) {
+    for (int i = begin; i < min((int)contacts.size(), end); i++) {
+        string key = normalize_key(contacts[i].name);
+        vector<string> tokens = split_tokens(key);
+        if (tokens.empty()) continue;
+        hll_add(&sk.hll[HLL_NAMES * HLL_REGISTERS], sketch_hash(key, 0));
+        hll_add(&sk.hll[HLL_SURNAMES * HLL_REGISTERS], sketch_hash(tokens.back(), 0));
+        sort(tokens.begin(), tokens.end());
+        tokens.erase(unique(tokens.begin(), tokens.end()), tokens.end());
+        for (const string &t : tokens) {
+            hll_add(&sk.hll[HLL_TOKENS * HLL_REGISTERS], sketch_hash(t, 0));
+            for (int d = 0; d < CMS_DEPTH; d++) sk.cms[d * CMS_WIDTH + sketch_hash(t, d + 1) % CMS_WIDTH]++;
+        }
+    }
+}
+
+// Merges every rank's sketches into rank 0's: registers by maximum, counters by sum
+void reduce_sketches(Sketches &sk, int rank) {
+    Sketches merged;
+    MPI_Reduce(sk.hll.data(), merged.hll.data(), sk.hll.size(), MPI_UINT8_T, MPI_MAX, 0, MPI_COMM_WORLD);
+    MPI_Reduce(sk.cms.data(), merged.cms.data(), sk.cms.size(), MPI_UINT32_T, MPI_SUM, 0, MPI_COMM_WORLD);
+    if (rank == 0) sk = merged;
+}
+
+// Draws a stratified sample of records [begin, end). Each stratum contributes ceil(rate * size)
+// records chosen uniformly without replacement, and at least two where it has them.
+Sample draw_sample(const vector<Contact> &contacts, int begin, int end, double rate, int rank) {
+    Sample s;
+    s.population.assign(256, 0);
+    s.drawn.assign(256, 0);
+    vector<vector<int>> members(256);
+    for (int i = begin; i < min((int)contacts.size(), end); i++)
+        members[contacts[i].name.empty() ? 0 : (unsigned char)contacts[i].name[0]].push_back(i);
+    mt19937_64 rng(0x9E3779B97F4A7C15ULL ^ rank);  // Fixed seed: repeated runs give the same sample
+    for (int h = 0; h < 256; h++) {
+        vector<int> &m = members[h];
+        long long n = m.size(), want = min<long long>(n, max<long long>(2, ceil(rate * n)));
+        for (long long k = 0; k < want; k++) {      // Partial Fisher-Yates shuffle
+            swap(m[k], m[k + rng() % (n - k)]);
+            s.records.push_back(contacts[m[k]]);
+            s.stratum.push_back(h);
+        }
+        s.population[h] = n;
+        s.drawn[h] = want;
+    }
+    return s;
+}
+
+// Estimates the records matching the term from the sample. Returns {estimate, variance, sampled
+// matches, sampled records, population}, all of which add up across ranks.
+array<double, 5> sample_count(const Sample &s, const string &term, bool glob) {
+    Matcher plain;
+    plain.glob = glob;
+    vector<long long> hits(256, 0);
+    for (int r : match_range(s.records, 0, s.records.size(), term, plain)) hits[s.stratum[r]]++;
+    array<double, 5> sum = {0, 0, 0, 0, 0};
+    for (int h = 0; h < 256; h++) {
+        double N = s.population[h], n = s.drawn[h];
+        if (n == 0) continue;
+        double p = hits[h] / n;
+        sum[0] += N * p;
+        if (n > 1) sum[1] += N * N * (1 - n / N) * p * (1 - p) / (n - 1); // With finite population correction
+        sum[2] += hits[h];
+        sum[3] += n;
+        sum[4] += N;
+    }
+    return sum;
+}
+
+// Formats the approximate answers for one term at rank 0; the sketch lookups are timed alone
+string approx_report(const Sketches &sk, const array<double, 5> &sampled, const string &term, bool glob) {
+    char line[512];
+    string report;
+    double estimate = sampled[0], half = 1.96 * sqrt(sampled[1]);
+    if (sampled[2] == 0 && sampled[3] > 0)          // Nothing sampled matched: rule of three
+        snprintf(line, sizeof line, "Matches for \"%s\": about 0, 95%% CI [0, %.0f] (%.0f of %.0f records sampled)\n",
+                 term.c_str(), 3 * sampled[4] / sampled[3], sampled[3], sampled[4]);
+    else
+        snprintf(line, sizeof line, "Matches for \"%s\": about %.0f, 95%% CI [%.0f, %.0f] (%.0f of %.0f records sampled)\n",
+                 term.c_str(), estimate, max(sampled[2], estimate - half), min(sampled[4], estimate + half),
+                 sampled[3], sampled[4]);
+    report += line;
+
+    double start = MPI_Wtime();
+    vector<string> tokens = glob ? vector<string>() : split_tokens(normalize_key(term)); // Patterns are not tokens
+    uint32_t token_count = tokens.size() == 1 ? cms_estimate(sk, tokens[0]) : 0;
+    double distinct[HLL_KINDS];
+    for (int k = 0; k < HLL_KINDS; k++) distinct[k] = hll_estimate(&sk.hll[k * HLL_REGISTERS]);
+    double micros = (MPI_Wtime() - start) * 1e6;
+
+    double total = accumulate(sk.cms.begin(), sk.cms.begin() + CMS_WIDTH, 0.0); // Token occurrences counted
+    if (tokens.size() == 1) {
+        snprintf(line, sizeof line, "Contacts with token \"%s\": at most %u (Count-Min; overcount <= %.0f with %.1f%% probability)\n",
+                 tokens[0].c_str(), token_count, M_E / CMS_WIDTH * total, 100 * (1 - exp(-CMS_DEPTH)));
+        report += line;
+    }
+    const char *kinds[HLL_KINDS] = {"names", "name tokens", "surnames"};
+    double error = 1.04 / sqrt((double)HLL_REGISTERS);  // Relative standard error of HyperLogLog
+    for (int k = 0; k < HLL_KINDS; k++) {
+        snprintf(line, sizeof line, "Distinct %s: about %.0f, 95%% CI [%.0f, %.0f] (HyperLogLog, %.2f%% standard error)\n",
+                 kinds[k], distinct[k], distinct[k] * (1 - 1.96 * error), distinct[k] * (1 + 1.96 * error), 100 * error);
+        report += line;
+    }
+    snprintf(line, sizeof line, "Sketch lookups took %.1f microseconds.\n", micros);
+    return report + line;
+}
+
+// ---------------------------------------------------------------------------------------------
+// Compressed output in the LZ4 frame format (readable by `lz4 -d`, which also accepts several
+// frames back to back), built on the block codec near the top of the file.
+// ---------------------------------------------------------------------------------------------
+
+// Output stream buffer that writes everything passing through it to `sink` as one LZ4 frame.
+// The frame is finished by finish() or the destructor.
+struct Lz4FrameBuf : streambuf {
+    ostream &sink;
+    vector<char> block;
+    bool finished = false;
+    explicit Lz4FrameBuf(ostream &s) : sink(s), block(LZ4_BLOCK_BYTES) {
+        uint8_t header[7] = {0x04, 0x22, 0x4D, 0x18, 0x60, 0x40, 0}; // Magic; independent blocks; 64 KB
+        header[6] = xxh32(header + 4, 2, 0) >> 8 & 0xFF;
+        sink.write((const char *)header, sizeof header);
+        setp(block.data(), block.data() + block.size());
+    }
+    ~Lz4FrameBuf() { finish(); }
+    void put_block() {                              // Compress the buffered bytes as one block
+        size_t n = pptr() - pbase();
+        if (n == 0) return;
+        string packed = lz4_compress_block(pbase(), n);
+        bool raw = packed.size() >= n;              // Incompressible: store as is (high bit set)
+        uint32_t size = raw ? n | 0x80000000U : packed.size();
+        sink.write((const char *)&size, 4);         // Little-endian on every platform we run on
+        if (raw) sink.write(pbase(), n);
+        else sink.write(packed.data(), packed.size());
+        setp(block.data(), block.data() + block.size());
+    }
+    int overflow(int ch) override {
+        put_block();
+        if (ch != EOF) { *pptr() = ch; pbump(1); }
+        return ch == EOF ? 0 : ch;
+    }
+    void finish() {
+        if (finished) return;
+        put_block();
+        uint32_t end_mark = 0;
+        sink.write((const char *)&end_mark, 4);
+        finished = true;
+    }
+};
+
+// Compresses a whole string into one LZ4 frame
+string lz4_frame(const string &text) {
+    ostringstream out;
+    Lz4FrameBuf frame(out);
+    frame.sputn(text.data(), text.size());
+    frame.finish();
+    return out.str();
+}
+
+// ---------------------------------------------------------------------------------------------
+// Shared-memory result sink (--shm-sink). Rank 0 publishes the matches into the memfd ring
+// described in phonebook_ring.h as batches of whole lines, so a consumer on the same node reads
+// them in place while the search runs. The ring applies backpressure: a full ring makes the
+// producer wait, and closing waits until the consumer has read everything.
+// ---------------------------------------------------------------------------------------------
+
+const size_t SHM_RING_BYTES = 16 << 20;            // Data area of the ring
+const size_t SHM_BATCH_BYTES = 1 << 16;            // Lines gathered into one published batch
+
+// Producer side of the result ring
+struct ShmSink {
+    pb_ring_header *hdr = nullptr;
+    char *data = nullptr;
+    int fd = -1;
+    string path;                                    // Symlink through which consumers attach
+};
+
+// Creates the ring in a memfd and points `path` at it; returns false if that fails
+bool shm_sink_create(ShmSink &sink, const string &path) {
+    sink.fd = memfd_create("phonebook-results", 0);
+    if (sink.fd < 0 || ftruncate(sink.fd, PB_RING_DATA + SHM_RING_BYTES) != 0) return false;
+    void *base = mmap(nullptr, PB_RING_DATA + SHM_RING_BYTES, PROT_READ | PROT_WRITE, MAP_SHARED, sink.fd, 0);
+    if (base == MAP_FAILED) return false;
+    sink.hdr = (pb_ring_header *)base;
+    sink.data = (char *)base + PB_RING_DATA;
+    sink.hdr->capacity = SHM_RING_BYTES;
+    __atomic_store_n(&sink.hdr->magic, PB_RING_MAGIC, __ATOMIC_RELEASE); // Valid from here on
+    sink.path = path;
+    unlink(path.c_str());
+    string target = "/proc/" + to_string(getpid()) + "/fd/" + to_string(sink.fd);
+    return symlink(target.c_str(), path.c_str()) == 0;
+}
+
+// Publishes one record, waiting for the consumer to free space when the ring is full
+void shm_sink_publish(ShmSink &sink, const char *p, size_t n) {
+    pb_ring_header *h = sink.hdr;
+    uint64_t cap = h->capacity, mask = cap - 1, head = h->head, need = pb_ring_record_bytes(n);
+    unsigned spins = 0;
+    auto wait_for = [&](uint64_t bytes) {
+        while (cap - (head - __atomic_load_n(&h->tail, __ATOMIC_ACQUIRE)) < bytes) pb_ring_pause(&spins);
+    };
+    if ((head & mask) + need > cap) {               // Would cross the end: wrap to offset 0 first
+        wait_for(cap - (head & mask));
+        uint32_t wrap = PB_RING_WRAP;
+        memcpy(sink.data + (head & mask), &wrap, 4);
+        head += cap - (head & mask);
+        __atomic_store_n(&h->head, head, __ATOMIC_RELEASE);
+    }
+    wait_for(need);
+    uint32_t len = n;
+    memcpy(sink.data + (head & mask), &len, 4);
+    memcpy(sink.data + (head & mask) + 8, p, n);
+    __atomic_store_n(&h->head, head + need, __ATOMIC_RELEASE);
+}
+
+// Marks the stream complete, waits until the consumer has drained it and removes the symlink
+void shm_sink_close(ShmSink &sink) {
+    if (sink.hdr == nullptr) return;
+    __atomic_store_n(&sink.hdr->closed, 1, __ATOMIC_RELEASE);
+    unsigned spins = 0;
+    while (__atomic_load_n(&sink.hdr->tail, __ATOMIC_ACQUIRE) != sink.hdr->head) pb_ring_pause(&spins);
+    unlink(sink.path.c_str());
+    munmap(sink.hdr, PB_RING_DATA + SHM_RING_BYTES);
+    close(sink.fd);
+    sink.hdr = nullptr;
+}
+
+// Stream buffer that publishes the text written to it as batches of whole lines
+struct ShmSinkBuf : streambuf {
+    ShmSink &sink;
+    string pending;
+    explicit ShmSinkBuf(ShmSink &s) : sink(s) {}
+    void publish(bool all) {                        // Send every complete line (or everything)
+        size_t cut = all ? pending.size() : pending.rfind('\n') + 1; // npos + 1 == 0
+        for (size_t pos = 0; pos < cut;) {
+            size_t n = min(cut - pos, SHM_BATCH_BYTES);
+            if (pos + n < cut) {                    // Split long runs at a line end where possible
+                size_t nl = pending.rfind('\n', pos + n - 1);
+                if (nl != string::npos && nl >= pos) n = nl + 1 - pos;
+            }
+            shm_sink_publish(sink, pending.data() + pos, n);
+            pos += n;
+        }
+        pending.erase(0, cut);
+    }
+    streamsize xsputn(const char *s, streamsize n) override {
+        pending.append(s, n);
+        if (pending.size() >= SHM_BATCH_BYTES) publish(false);
+        return n;
+    }
+    int overflow(int ch) override {
+        if (ch != EOF) xsputn((const char *)&ch, 1);
+        return ch == EOF ? 0 : ch;
+    }
+    int sync() override { publish(false); return 0; }
+};
+
+// Where rank 0 writes the results: output.txt, output.txt.lz4 through an LZ4 frame (--compress)
+// or the shared-memory ring (--shm-sink)
+struct ResultFile {
+    ofstream raw;
+    unique_ptr<Lz4FrameBuf> frame;
+    ShmSink sink;
+    unique_ptr<ShmSinkBuf> ring;
+    ostream out;
+    explicit ResultFile(const Options &opt) : out(nullptr) {
+        if (!opt.shm_sink.empty()) {
+            if (!shm_sink_create(sink, opt.shm_sink)) fail("Cannot create the shared-memory sink " + opt.shm_sink);
+            ring.reset(new ShmSinkBuf(sink));
+            out.rdbuf(ring.get());
+            return;
+        }
+        const char *name = opt.compress ? "output.txt.lz4" : "output.txt";
+        raw.open(name, ios::binary);
+        if (!raw) fail(string("Cannot open ") + name);
+        out.rdbuf(raw.rdbuf());
+        if (opt.compress) {
+            frame.reset(new Lz4FrameBuf(raw));
+            out.rdbuf(frame.get());
+        }
+    }
+    // Nowhere to put the results: end the whole run rather than drop every match and exit 0
+    [[noreturn]] static void fail(const string &why) {
+        cerr << why << "\n";
+        MPI_Abort(MPI_COMM_WORLD, 1);
+        exit(1);
+    }
+    void close() {
+        if (frame) frame->finish();
+        if (ring) ring->publish(true);
+        shm_sink_close(sink);
+        raw.close();
+    }
+};
+
+// ---------------------------------------------------------------------------------------------
+// Progress thread. Many MPI libraries (Open MPI's ob1 among them) advance a nonblocking transfer
+// only while some thread of the process is inside an MPI call, so an Isend posted before a long
+// scan may not move until the Wait after it. The progress thread keeps probing a private
+// communicator, which turns the progress engine while the main thread computes. It needs
+// MPI_THREAD_MULTIPLE and costs one mostly yielding thread per rank.
+// ---------------------------------------------------------------------------------------------
+
+struct ProgressThread {
+    thread poller;
+    atomic<bool> stop{false};
+    MPI_Comm comm = MPI_COMM_NULL;          // Private duplicate of MPI_COMM_SELF; nothing is ever sent on it
+};
+
+// Starts the progress thread (local, not collective)
+void start_progress(ProgressThread &p) {
+    MPI_Comm_dup(MPI_COMM_SELF, &p.comm);
+    p.stop = false;
+    p.poller = thread([&p] {
+        int flag;
+        while (!p.stop.load(memory_order_relaxed)) {
+            MPI_Iprobe(MPI_ANY_SOURCE, MPI_ANY_TAG, p.comm, &flag, MPI_STATUS_IGNORE);
+            this_thread::yield();
+        }
+    });
+}
+
+// Stops and joins the progress thread
+void stop_progress(ProgressThread &p) {
+    if (!p.poller.joinable()) return;
+    p.stop = true;
+    p.poller.join();
+    MPI_Comm_free(&p.comm);
+}
+
+// Starts sending a string the way send_string does without waiting for it; `len` and `text`
+// must stay alive until the two requests appended to `reqs` complete
+void isend_string(const string &text, int &len, int receiver, vector<MPI_Request> &reqs, int tag = 1) {
+    len = text.size() + 1;
+    reqs.resize(reqs.size() + 2);
+    MPI_Isend(&len, 1, MPI_INT, receiver, tag, MPI_COMM_WORLD, &reqs[reqs.size() - 2]);
+    MPI_Isend(text.c_str(), len, MPI_CHAR, receiver, tag, MPI_COMM_WORLD, &reqs.back());
+}
+
+// Scatters one string per rank from rank 0 through the tuned collectives; returns this rank's
+// string (parts is only read on rank 0)
+string scatter_strings(coll_ctx &coll, const vector<string> &parts) {
+    vector<int> counts(coll.size), displs(coll.size);
+    string all;
+    if (coll.rank == 0) {
+        for (int i = 0; i < coll.size; i++) {
+            counts[i] = parts[i].size();
+            displs[i] = all.size();
+            all += parts[i];
+        }
+    }
+    coll_bcast(&coll, counts.data(), coll.size * sizeof(int), 0); // Every rank needs all block sizes
+    string mine(counts[coll.rank], '\0');
+    coll_scatterv(&coll, all.data(), counts.data(), displs.data(), &mine[0], 0);
+    return mine;
+}
+
+// Gathers every rank's string on rank 0 through the tuned collectives; rank 0 gets them in rank order
+vector<string> gather_strings(coll_ctx &coll, const string &mine) {
+    vector<int> counts(coll.size), displs(coll.size);
+    int len = mine.size();
+    MPI_Allgather(&len, 1, MPI_INT, counts.data(), 1, MPI_INT, MPI_COMM_WORLD);
+    string all;
+    if (coll.rank == 0) {
+        for (int i = 1; i < coll.size; i++) displs[i] = displs[i - 1] + counts[i - 1];
+        all.resize(displs.back() + counts.back());
+    }
+    coll_gatherv(&coll, mine.data(), counts.data(), &all[0], displs.data(), 0);
+    vector<string> parts;
+    if (coll.rank == 0)
+        for (int i = 0; i < coll.size; i++) parts.push_back(all.substr(displs[i], counts[i]));
+    return parts;
+}
+
+// Measures how much of the chunk distribution rank 0 hides behind the scan of its own chunk:
+// sending alone, scanning alone, and both together without and (if the MPI library allows
+// threads) with the progress thread. Each case is the best of a few barrier-aligned trials.
+// Collective; rank 0 prints the report.
+void overlap_benchmark(const vector<Contact> &contacts, const vector<int> &bounds, const string &term, bool threads,
+                       int rank, int size) {
+    const int TRIALS = 5;
+    const char *names[4] = {"send alone", "scan alone", "send + scan", "send + scan, progress thread"};
+    vector<string> chunks(size);
+    vector<int> lens(size);
+    double bytes = 0;
+    if (rank == 0)
+        for (int i = 1; i < size; i++) {
+            chunks[i] = vector_to_string(contacts, bounds[i], bounds[i + 1]);
+            bytes += chunks[i].size();
+        }
+    double best[4] = {1e30, 1e30, 1e30, 1e30};
+    for (int c = 0; c < (threads ? 4 : 3); c++) {
+        bool send = c != 1, scan = c != 0;
+        ProgressThread progress;
+        if (c == 3) start_progress(progress);
+        for (int t = 0; t < TRIALS; t++) {
+            MPI_Barrier(MPI_COMM_WORLD);
+            double start = MPI_Wtime();
+            if (rank == 0) {
+                vector<MPI_Request> sends;
+                if (send)
+                    for (int i = 1; i < size; i++) isend_string(chunks[i], lens[i], i, sends);
+                if (scan) match_range(contacts, 0, bounds[1], term, Matcher());
+                MPI_Waitall(sends.size(), sends.data(), MPI_STATUSES_IGNORE);
+                best[c] = min(best[c], MPI_Wtime() - start);
+            } else if (send) {
+                receive_string(0);
+            }
+        }
+        stop_progress(progress);
+    }
+    if (rank != 0) return;
+
+    printf("Overlap benchmark: %d workers, %.1f MB sent, %d records scanned, best of %d trials\n", size - 1,
+           bytes / 1e6, bounds[1], TRIALS);
+    for (int c = 0; c < (threads ? 4 : 3); c++) {
+        printf("  %-30s %9.3f ms", names[c], best[c] * 1e3);
+        // Share of the shorter phase that disappeared when both ran together
+        if (c >= 2)
+            printf("   overlap %3.0f%%", 100 * max(0.0, min(1.0, (best[0] + best[1] - best[c]) / min(best[0], best[1]))));
+        printf("\n");
+    }
+    if (!threads) printf("  (the MPI library does not provide MPI_THREAD_MULTIPLE; no progress thread)\n");
+}
+
+// Scan state of one rank's records, prepared once at load time
+struct LocalScan {
+    vector<Contact> folded;              // Normalized names (with --normalize)
+    TokenIndex index;                    // Token dictionary and postings (with --tokens)
+    Matcher how;                         // Points into the two members above
+};
+
+// Normalizes and tokenizes records [begin, end) as the options ask. Collective when --tokens is
+// set, since the token dictionary is merged across ranks.
+void prepare_scan(LocalScan &scan, const Options &opt, const vector<Contact> &contacts, int begin, int end, int rank,
+                  int size) {
+    bool normalize = !opt.normalize.empty();
+    if (normalize) scan.folded = fold_contacts(contacts, begin, end, opt.normalize == "nfkc");
+    if (opt.tokens) scan.index = build_token_index(normalize ? scan.folded : contacts, begin, end, rank, size);
+    scan.how = {opt.tokens ? &scan.index : nullptr, opt.glob, normalize ? &scan.folded : nullptr, opt.normalize == "nfkc"};
+}
+
+// Parses the leading "--name value" options; returns the index of the first file argument or -1 on error
+int parse_options(int argc, char **argv, Options &opt) {
+    int i = 1;
+    while (i < argc && strncmp(argv[i], "--", 2) == 0) {
+        string name = argv[i];
+        if (name == "--tokens") { opt.tokens = true; i++; continue; } // Flags without a value
+        if (name == "--glob") { opt.glob = true; i++; continue; }
+        if (name == "--dedup") { opt.dedup = true; i++; continue; }
+        if (name == "--progress-thread") { opt.progress_thread = true; i++; continue; }
+        if (name == "--overlap-bench") { opt.overlap_bench = true; i++; continue; }
+        if (i + 1 >= argc) return -1;               // The remaining options take a value
+        string value = argv[i + 1];
+        if (name == "--replicas") opt.replicas = max(1, atoi(value.c_str()));
+        else if (name == "--hedge-pct") opt.hedge_pct = min(100.0, max(0.0, atof(value.c_str())));
+        else if (name == "--inflight") opt.inflight = max(1, atoi(value.c_str()));
+        else if (name == "--queries") opt.queries = value;
+        else if (name == "--build-snapshot") opt.build_snapshot = value;
+        else if (name == "--snapshot") opt.snapshot = value;
+        else if (name == "--exact") opt.exact = value;
+        else if (name == "--save") opt.save = value;
+        else if (name == "--from") opt.from = value;
+        else if (name == "--and" || name == "--or" || name == "--andnot") opt.set_ops.push_back({name.substr(2), value});
+        else if (name == "--cache") opt.cache = value;
+        else if (name == "--sort" && (value == "name" || value == "phone")) opt.sort = value;
+        else if (name == "--speed-file") opt.speed_file = value;
+        else if (name == "--dedup-threshold") opt.dedup_threshold = atof(value.c_str());
+        else if (name == "--join" && (value == "name" || value == "phone")) opt.join = value;
+        else if (name == "--normalize" && (value == "nfc" || value == "nfkc")) opt.normalize = value;
+        else if (name == "--approx" && atof(value.c_str()) > 0) opt.approx = min(1.0, atof(value.c_str()));
+        else if (name == "--deadline-ms") opt.deadline_ms = max(0.0, atof(value.c_str()));
+        else if (name == "--ingest-threads") opt.ingest_threads = max(0, atoi(value.c_str()));
+        else if (name == "--lookup" && (value == "name" || value == "phone")) opt.lookup = value;
+        else if (name == "--lookup-group") opt.lookup_group = max(1, atoi(value.c_str()));
+        else if (name == "--compress" && value == "lz4") opt.compress = true;
+        else if (name == "--shm-sink") opt.shm_sink = value;
+        else if (name == "--wire-lz4") opt.wire_gbps = max(0.0, atof(value.c_str()));
+        else if (name == "--coll-tune") opt.coll_tune = value;
+        else return -1;
+        i += 2;
     }
-    return contacts;
+    if (!opt.shm_sink.empty()) opt.compress = false; // The ring carries plain text
+    return i;
 }
 
-// Check if the contact name contains the search term
-string check(const Contact &c, const string &search) {
-    if (c.name.find(search) != string::npos) {
-        return c.name + " " + c.phone + "\n";
+// Orders the worker ranks (1..size-1) so that consecutive entries live on different nodes.
+// Every rank must call this; only rank 0 gets the list back.
+vector<int> interleave_workers_by_node(int rank, int size) {
+    char name[MPI_MAX_PROCESSOR_NAME] = {0};
+    int len;
+    MPI_Get_processor_name(name, &len);
+    vector<char> all(rank == 0 ? size * MPI_MAX_PROCESSOR_NAME : 1);
+    MPI_Gather(name, MPI_MAX_PROCESSOR_NAME, MPI_CHAR, all.data(), MPI_MAX_PROCESSOR_NAME, MPI_CHAR, 0, MPI_COMM_WORLD);
+    vector<int> order;
+    if (rank != 0) return order;
+
+    // Group workers by host name, keeping the hosts in first-seen order
+    vector<string> hosts;
+    vector<vector<int>> by_host;
+    for (int r = 1; r < size; r++) {
+        string host(&all[r * MPI_MAX_PROCESSOR_NAME]);
+        int h = find(hosts.begin(), hosts.end(), host) - hosts.begin();
+        if (h == (int)hosts.size()) { hosts.push_back(host); by_host.push_back({}); }
+        by_host[h].push_back(r);
     }
-    return "";
+    // Round-robin over hosts so neighbouring entries (replicas of one partition) differ in node
+    for (size_t k = 0; order.size() < (size_t)size - 1; k++)
+        for (auto &ranks : by_host)
+            if (k < ranks.size()) order.push_back(ranks[k]);
+    return order;
 }
 
-// Reads contacts from one or more phonebook files into a vector
-void read_phonebook(const vector<string> &files, vector<Contact> &contacts) {
-    for (const string &file : files) {
-        ifstream f(file);
-        string line;
-        while (getline(f, line)) {
-            if (line.empty()) continue;
-            int comma = line.find(",");
-            if (comma == string::npos) continue;
-            // Clean and extract name and phone
-            contacts.push_back({line.substr(1, comma - 2), line.substr(comma + 2, line.size() - comma - 3)});
+// Returns the p-th percentile of the recorded latencies (infinity until enough samples exist)
+double latency_percentile(const deque<double> &history, double p) {
+    if (history.size() < 16) return numeric_limits<double>::infinity();
+    vector<double> v(history.begin(), history.end());
+    size_t k = min(v.size() - 1, (size_t)(p / 100.0 * v.size()));
+    nth_element(v.begin(), v.begin() + k, v.end());
+    return v[k];
+}
+
+// Worker side of the query service: scans the local partition for each query in slices and
+// checks for new queries or cancellations between slices, so a losing replica stops early.
+// Slices are scheduled earliest-deadline-first (then by class, then by arrival), and a query
+// whose deadline passes is answered with the matches found so far, flagged as partial.
+// Every query is answered exactly once, either with its matches or with a "cancelled" reply.
+// With a token index a query is answered in one step, since its postings cover the whole partition.
+void serve_partition(const vector<Contact> &contacts, const Matcher &how) {
+    struct Task { int qid; string term; size_t pos; string result; double deadline; int cls; double busy; };
+    vector<Task> tasks;                             // Kept in arrival order
+    const size_t SLICE = 4096;                      // Records scanned between message checks
+    const double NONE = numeric_limits<double>::infinity();
+    auto reply = [&](const Task &t, int status) {
+        send_string(to_string(t.qid) + "\n" + to_string(status) + "\n" + to_string(t.pos) + " " +
+                        to_string(contacts.size()) + " " + to_string(t.busy) + "\n" + t.result, 0, TAG_RESULT);
+    };
+
+    while (true) {
+        int flag = 0;
+        MPI_Status st;
+        if (tasks.empty()) { MPI_Probe(0, MPI_ANY_TAG, MPI_COMM_WORLD, &st); flag = 1; } // Idle: block
+        else MPI_Iprobe(0, MPI_ANY_TAG, MPI_COMM_WORLD, &flag, &st);
+        if (flag) {
+            string msg = receive_string(0, st.MPI_TAG);
+            if (st.MPI_TAG == TAG_STOP) break;
+            int qid = atoi(msg.c_str());
+            if (st.MPI_TAG == TAG_QUERY) {
+                // The budget is relative, so the ranks' clocks need not agree
+                istringstream iss(msg);
+                string line, budget, cls, term;
+                getline(iss, line); getline(iss, budget); getline(iss, cls); getline(iss, term);
+                double b = atof(budget.c_str());
+                tasks.push_back({qid, term, 0, "", b < 0 ? NONE : MPI_Wtime() + b, atoi(cls.c_str()), 0});
+            } else if (st.MPI_TAG == TAG_CANCEL) {
+                for (auto it = tasks.begin(); it != tasks.end(); ++it) {
+                    if (it->qid != qid) continue;
+                    it->result.clear();
+                    reply(*it, 1);                  // Acknowledge the cancel
+                    tasks.erase(it);
+                    break;
+                }
+            }
+            continue;                               // Drain all control messages before scanning
+        }
+
+        // Answer every expired query with what it has so far
+        double now = MPI_Wtime();
+        for (size_t i = 0; i < tasks.size();) {
+            if (tasks[i].deadline > now) { i++; continue; }
+            reply(tasks[i], 2);
+            tasks.erase(tasks.begin() + i);
+        }
+        if (tasks.empty()) continue;
+
+        // Scan one slice of the most urgent query
+        Task &t = *min_element(tasks.begin(), tasks.end(), [](const Task &a, const Task &b) {
+            return a.deadline != b.deadline ? a.deadline < b.deadline : a.cls < b.cls; // Stable: ties keep arrival order
+        });
+        if (how.index != nullptr) {
+            t.result = search_range(contacts, 0, contacts.size(), t.term, how);
+            t.pos = contacts.size();
+        }
+        size_t stop = min(contacts.size(), t.pos + SLICE);
+        if (t.pos < stop) t.result += search_range(contacts, t.pos, stop, t.term, how);
+        t.pos = stop;
+        t.busy += MPI_Wtime() - now;
+        if (t.pos == contacts.size()) {
+            reply(t, 0);
+            tasks.erase(tasks.begin() + (&t - tasks.data()));
+        }
+    }
+}
+
+// Master side of the query service. Rank 0 holds no data; it sends each query to one replica of
+// every partition and, when a partition has not answered after the hedge-percentile latency,
+// sends a duplicate to the next replica. The first answer wins and the other replica is cancelled.
+// A query with a deadline is admitted only if the work queued ahead of it on its primaries,
+// priced at the measured per-record scan cost, leaves time to finish; otherwise it is rejected.
+void coordinate_queries(const Options &opt, const vector<Contact> &contacts, const vector<int> &workers,
+                        const string &single_term, int size) {
+    int nworkers = workers.size();
+    int parts = nworkers / opt.replicas;            // Number of distinct partitions
+
+    // replicas[p] lists the ranks holding partition p; spare ranks become extra replicas
+    vector<vector<int>> replicas(parts);
+    for (int i = 0; i < nworkers; i++)
+        replicas[i < parts * opt.replicas ? i / opt.replicas : i % parts].push_back(workers[i]);
+
+    // Ship every partition to all of its replicas
+    vector<int> bounds = partition_by_bytes(contacts, parts, {});
+    for (int p = 0; p < parts; p++) {
+        string text = vector_to_string(contacts, bounds[p], bounds[p + 1]);
+        for (int r : replicas[p]) send_string(text, r);
+    }
+    if (opt.tokens) build_token_index(contacts, 0, 0, 0, size); // Join the dictionary merge with no records
+
+    // Query source: a file, stdin, or the single search term from the command line
+    ifstream qfile;
+    istream *qin = nullptr;
+    if (opt.queries == "-") qin = &cin;
+    else if (!opt.queries.empty()) { qfile.open(opt.queries); qin = &qfile; }
+    bool single_pending = opt.queries.empty();
+
+    struct Part { double sent; int primary, hedge; bool done; };
+    struct Query {
+        string term;
+        double start, deadline;                     // deadline is infinite for queries without one
+        int cls, remaining;
+        long long scanned = 0, records = 0;         // Records scanned so far out of all partitions
+        bool partial = false;
+        vector<string> results;
+        vector<Part> parts;
+    };
+    map<int, Query> active;
+    map<int, int> outstanding;                      // Unanswered messages per worker rank
+    deque<double> history;                          // Recent per-partition answer latencies
+    vector<double> query_latency;
+    int next_qid = 0, hedges = 0, hedges_won = 0, partials = 0, rejected = 0;
+    double record_cost = 0;                         // Smoothed scan seconds per record (0 = not measured yet)
+    const double NONE = numeric_limits<double>::infinity();
+    auto query_message = [&](int qid, const Query &q) {
+        double budget = q.deadline == NONE ? -1 : max(0.0, q.deadline - MPI_Wtime());
+        return to_string(qid) + "\n" + to_string(budget) + "\n" + to_string(q.cls) + "\n" + q.term;
+    };
+    bool input_done = false;
+    ofstream out("output.txt");
+
+    while (!input_done || !active.empty()) {
+        // Admit new queries while the in-flight window has room
+        while (!input_done && (int)active.size() < opt.inflight) {
+            string term;
+            if (qin == nullptr) {
+                if (!single_pending) { input_done = true; break; }
+                term = single_term;
+                single_pending = false;
+            } else {
+                // Never block on an interactive stdin while answers are still arriving
+                if (qin == &cin && !active.empty()) {
+                    pollfd pfd = {0, POLLIN, 0};
+                    if (poll(&pfd, 1, 0) <= 0) break;
+                }
+                if (!getline(*qin, term)) { input_done = true; break; }
+                if (term.empty()) continue;
+            }
+            // Optional "<TAB>deadline ms<TAB>class" after the term
+            double deadline_ms = opt.deadline_ms;
+            int cls = 1;
+            size_t tab = term.find('\t');
+            if (tab != string::npos) {
+                istringstream fields(term.substr(tab + 1));
+                string d, c;
+                getline(fields, d, '\t');
+                getline(fields, c, '\t');
+                if (!d.empty()) deadline_ms = atof(d.c_str());
+                if (!c.empty()) cls = max(0, atoi(c.c_str()));
+                term.resize(tab);
+            }
+            int qid = next_qid++;
+            Query q;
+            q.term = term;
+            q.start = MPI_Wtime();
+            q.deadline = deadline_ms > 0 ? q.start + deadline_ms / 1e3 : NONE;
+            q.cls = cls;
+            q.remaining = parts;
+            q.results.assign(parts, "");
+            for (int p = 0; p < parts; p++)
+                q.parts.push_back({q.start, replicas[p][qid % replicas[p].size()], -1, false}); // Rotate primaries
+
+            // Admission control: a primary scans the unfinished queries that are due no later
+            // than this one before it, so the estimate is the slowest primary's queue plus this query
+            if (q.deadline != NONE && record_cost > 0) {
+                double worst = 0;
+                for (int p = 0; p < parts; p++) {
+                    int ahead = 1;
+                    for (auto &[id, other] : active)
+                        if (other.deadline <= q.deadline && !other.parts[p].done && other.parts[p].primary == q.parts[p].primary)
+                            ahead++;
+                    worst = max(worst, ahead * (bounds[p + 1] - bounds[p]) * record_cost);
+                }
+                if (worst > q.deadline - q.start) {
+                    out << "# " << term << " [rejected: needs about " << fixed << setprecision(1) << worst * 1e3
+                        << " ms, deadline " << deadline_ms << " ms]\n" << defaultfloat;
+                    out.flush();
+                    rejected++;
+                    continue;
+                }
+            }
+            for (int p = 0; p < parts; p++) {
+                send_string(query_message(qid, q), q.parts[p].primary, TAG_QUERY);
+                outstanding[q.parts[p].primary]++;
+            }
+            active[qid] = q;
         }
+
+        bool progressed = false;
+        int flag;
+        MPI_Status st;
+        MPI_Iprobe(MPI_ANY_SOURCE, TAG_RESULT, MPI_COMM_WORLD, &flag, &st);
+        if (flag) {
+            progressed = true;
+            int src = st.MPI_SOURCE;
+            string msg = receive_string(src, TAG_RESULT);
+            outstanding[src]--;
+            size_t nl1 = msg.find('\n'), nl2 = msg.find('\n', nl1 + 1), nl3 = msg.find('\n', nl2 + 1);
+            int qid = atoi(msg.c_str());
+            int status = msg[nl1 + 1] - '0';
+            bool cancelled = status == 1;
+            long long scanned = 0, records = 0;
+            double busy = 0;
+            sscanf(msg.c_str() + nl2 + 1, "%lld %lld %lf", &scanned, &records, &busy);
+            if (scanned > 0 && busy > 0)            // Learn the scan cost from every answer
+                record_cost = record_cost == 0 ? busy / scanned : 0.8 * record_cost + 0.2 * busy / scanned;
+            auto it = active.find(qid);
+            if (!cancelled && it != active.end()) {
+                Query &q = it->second;
+                int p = 0;
+                while (p < parts && q.parts[p].primary != src && q.parts[p].hedge != src) p++;
+                if (p < parts && !q.parts[p].done) {
+                    Part &part = q.parts[p];
+                    // First answer for this partition wins; cancel the other copy if one was sent
+                    part.done = true;
+                    q.results[p] = msg.substr(nl3 + 1);
+                    q.scanned += scanned;
+                    q.records += records;
+                    q.partial |= status == 2;
+                    history.push_back(MPI_Wtime() - part.sent);
+                    if (history.size() > 512) history.pop_front();
+                    if (part.hedge >= 0) {
+                        int loser = src == part.primary ? part.hedge : part.primary;
+                        if (src == part.hedge) hedges_won++;
+                        send_string(to_string(qid), loser, TAG_CANCEL);
+                    }
+                    if (--q.remaining == 0) {
+                        out << "# " << q.term;
+                        if (q.partial)
+                            out << " [partial: " << fixed << setprecision(1) << 100.0 * q.scanned / max(1LL, q.records)
+                                << "% of records scanned]" << defaultfloat;
+                        out << "\n";
+                        partials += q.partial;
+                        for (const string &r : q.results) out << r;
+                        out.flush();
+                        query_latency.push_back(MPI_Wtime() - q.start);
+                        active.erase(it);
+                    }
+                }
+            }
+        }
+
+        // Hedge partitions whose primary is slower than the recent latency percentile
+        double threshold = latency_percentile(history, opt.hedge_pct);
+        double now = MPI_Wtime();
+        for (auto &[qid, q] : active) {
+            for (int p = 0; p < parts; p++) {
+                Part &part = q.parts[p];
+                if (part.done || part.hedge >= 0 || replicas[p].size() < 2 || now - part.sent < threshold) continue;
+                if (now >= q.deadline) continue;    // The primary is about to answer with a partial result
+                int idx = find(replicas[p].begin(), replicas[p].end(), part.primary) - replicas[p].begin();
+                part.hedge = replicas[p][(idx + 1) % replicas[p].size()];
+                send_string(query_message(qid, q), part.hedge, TAG_QUERY);
+                outstanding[part.hedge]++;
+                hedges++;
+                progressed = true;
+            }
+        }
+        if (!progressed) this_thread::sleep_for(chrono::microseconds(50));
+    }
+
+    // Collect late answers and cancel acknowledgements so no worker is left blocked in a send
+    for (auto &[w, n] : outstanding)
+        for (; n > 0; n--) receive_string(w, TAG_RESULT);
+    for (int w : workers) send_string("", w, TAG_STOP);
+    out.close();
+
+    if (!query_latency.empty()) {
+        sort(query_latency.begin(), query_latency.end());
+        auto pct = [&](double p) { return query_latency[min(query_latency.size() - 1, (size_t)(p / 100 * query_latency.size()))]; };
+        printf("Served %zu queries on %d partitions x %d replicas: p50 %.3f ms, p99 %.3f ms, max %.3f ms\n",
+               query_latency.size(), parts, opt.replicas, pct(50) * 1e3, pct(99) * 1e3, query_latency.back() * 1e3);
+        printf("Hedged %d partition requests, %d answered first by the hedge.\n", hedges, hedges_won);
     }
+    if (partials > 0 || rejected > 0)
+        printf("Deadlines: %d queries answered partially, %d rejected at admission.\n", partials, rejected);
 }
 
 int main(int argc, char **argv) {
-    MPI_Init(&argc, &argv);                         // Initialize the MPI environment
+    Options opt;
+    int first = parse_options(argc, argv, opt);    // Index of the first file name
+
+    // Initialize the MPI environment, with full thread support when a progress thread may run
+    int provided = MPI_THREAD_SINGLE;
+    if (opt.progress_thread || opt.overlap_bench) MPI_Init_thread(&argc, &argv, MPI_THREAD_MULTIPLE, &provided);
+    else MPI_Init(&argc, &argv);
+    bool threads = provided == MPI_THREAD_MULTIPLE;
     int rank, size;
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);           // Get current process ID
     MPI_Comm_size(MPI_COMM_WORLD, &size);           // Get total number of processes
+    wire.link_rate = opt.wire_gbps * 1e9 / 8;       // Bytes per second
+    if (wire.link_rate > 0) wire_calibrate(size);
+    if (opt.progress_thread && !threads) {
+        if (rank == 0) cerr << "The MPI library does not provide MPI_THREAD_MULTIPLE; running without a progress thread.\n";
+        opt.progress_thread = false;
+    }
+    bool service = (opt.replicas > 1 || !opt.queries.empty() || opt.deadline_ms > 0) && opt.lookup.empty();
+
+    // Self-tuned collectives; the overlapped and the compressed distributions keep their own sends
+    coll_ctx coll;
+    if (!opt.coll_tune.empty()) coll_open(&coll, MPI_COMM_WORLD, opt.coll_tune.c_str(), rank == 0);
+    auto finalize = [&]() {                         // Every exit from here on: close what was opened, then MPI
+        if (!opt.coll_tune.empty()) coll_close(&coll);
+        MPI_Finalize();
+    };
+    bool tuned = !opt.coll_tune.empty() && !opt.progress_thread && wire.link_rate == 0;
+
+    // Positional arguments: the phonebook files, then the search term unless another mode supplies the query
+    vector<string> files(argv + max(first, 1), argv + argc);
+    bool needs_term = opt.queries.empty() && opt.build_snapshot.empty() && opt.exact.empty() && opt.from.empty() &&
+                      !opt.dedup && opt.join.empty();
+    bool bitmaps = !opt.save.empty() || !opt.set_ops.empty(); // Results travel as record-ID bitmaps
+    string search_term;
+    bool has_term = !needs_term || !files.empty();
+    if (needs_term && !files.empty()) {
+        search_term = files.back();                 // Last argument is the search term
+        files.pop_back();
+    }
 
     // Check if the user provided sufficient arguments
-    if (argc < 3) {
+    bool has_input = opt.snapshot.empty() ? !files.empty() : files.empty();
+    if (first < 0 || !has_input || !has_term || (!opt.exact.empty() && opt.snapshot.empty()) ||
+        (!opt.join.empty() && files.size() != 2)) {
         if (rank == 0)
-            cerr << "Usage: mpirun -n <procs> " << argv[0] << " <file>... <search_term>\n";
-        MPI_Finalize();
+            cerr << "Usage: mpirun -n <procs> " << argv[0] << " [options] <file>... <search_term>\n";
+        finalize();
         return 1;
     }
-
-    string search_term = argv[argc - 1]; // Last argument is the search term
+    if (service && size - 1 < opt.replicas) {
+        if (rank == 0)
+            cerr << "Replicated mode needs at least " << opt.replicas + 1 << " processes.\n";
+        finalize();
+        return 1;
+    }
+    // A snapshot is checked once up front, so no mode mistakes a missing or corrupt one for an empty book
+    if (!opt.snapshot.empty()) {
+        string problem;
+        SnapshotView v;
+        if (rank == 0 && map_snapshot(opt.snapshot, v, &problem)) munmap(v.base, v.bytes);
+        int bad = !problem.empty();
+        MPI_Bcast(&bad, 1, MPI_INT, 0, MPI_COMM_WORLD);
+        if (bad) {
+            if (rank == 0) cerr << "Cannot use snapshot " << opt.snapshot << ": " << problem << "\n";
+            finalize();
+            return 1;
+        }
+    }
     double start, end;
+    int status = 0;                                 // Exit code: 1 when a result set cannot be used
+
+    // Snapshot build: rank 0 reads the files, all ranks build the perfect hash together
+    if (!opt.build_snapshot.empty()) {
+        vector<Contact> contacts;
+        if (rank == 0) load_contacts(opt, files, contacts);
+        build_snapshot(opt.build_snapshot, contacts, rank, size);
+        finalize();
+        return 0;
+    }
+
+    // Exact full-name lookup through the mapped snapshot, answered by rank 0 alone
+    if (!opt.exact.empty()) {
+        if (rank == 0) {
+            SnapshotView v;
+            if (!map_snapshot(opt.snapshot, v)) {
+                cerr << "Cannot read snapshot " << opt.snapshot << "\n";
+            } else {
+                start = MPI_Wtime();
+                string result = snapshot_exact(v, opt.exact);
+                end = MPI_Wtime();
+                ofstream out("output.txt");
+                out << result;
+                out.close();
+                printf("Process %d took %f seconds.\n", rank, end - start);
+            }
+        }
+        finalize();
+        return 0;
+    }
+
+    // Join job: both files are split over the ranks, shuffled by key and joined locally
+    if (!opt.join.empty()) {
+        vector<Contact> mine[2];
+        if (rank == 0) {
+            for (int side = 0; side < 2; side++) {
+                vector<Contact> rows;
+                load_contacts(opt, {files[side]}, rows);
+                vector<int> bounds = partition_by_bytes(rows, size, {});
+                for (int i = 1; i < size; i++) send_string(vector_to_string(rows, bounds[i], bounds[i + 1]), i);
+                mine[side].assign(rows.begin(), rows.begin() + bounds[1]);
+            }
+        } else {
+            for (int side = 0; side < 2; side++) mine[side] = string_to_contacts(receive_string(0));
+        }
+        unique_ptr<ResultFile> result;
+        ostream none(nullptr);                      // Workers write nothing themselves
+        if (rank == 0) result.reset(new ResultFile(opt));
+        start = MPI_Wtime();
+        long long pairs = distributed_join(mine[0], mine[1], opt.join == "phone", rank, size, result ? result->out : none);
+        long long total = 0;
+        end = MPI_Wtime();
+        MPI_Reduce(&pairs, &total, 1, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+        if (rank == 0) {
+            result->close();
+            printf("Join on %s: %lld matching pairs.\n", opt.join.c_str(), total);
+        }
+        printf("Process %d took %f seconds.\n", rank, end - start);
+        finalize();
+        return 0;
+    }
+
+    // Dedup job: distribute the records as for a search, then cluster them together
+    if (opt.dedup) {
+        vector<Contact> contacts, mine;
+        vector<int> bounds(size + 1);
+        if (rank == 0) {
+            load_contacts(opt, files, contacts);
+            bounds = partition_by_bytes(contacts, size, {});
+            for (int i = 1; i < size; i++) send_string(vector_to_string(contacts, bounds[i], bounds[i + 1]), i);
+            mine.assign(contacts.begin(), contacts.begin() + bounds[1]);
+        } else {
+            mine = string_to_contacts(receive_string(0));
+        }
+        MPI_Bcast(bounds.data(), size + 1, MPI_INT, 0, MPI_COMM_WORLD);
+        long long stats[3] = {0, 0, 0};             // Candidate pairs, verified pairs, clusters
+        start = MPI_Wtime();
+        vector<vector<uint32_t>> clusters = dedup_clusters(mine, bounds[rank], opt.dedup_threshold, rank, size, stats);
+        end = MPI_Wtime();
+        if (rank == 0) {
+            ofstream out("output.txt");             // One block per cluster, separated by blank lines
+            for (auto &cluster : clusters) {
+                for (uint32_t id : cluster) out << contacts[id].name << " " << contacts[id].phone << "\n";
+                out << "\n";
+            }
+            out.close();
+            printf("Dedup: %lld candidate pairs, %lld verified, %lld clusters.\n", stats[0], stats[1], stats[2]);
+        }
+        printf("Process %d took %f seconds.\n", rank, end - start);
+        finalize();
+        return 0;
+    }
+
+    // Overlap benchmark: rank 0 distributes the chunks while scanning its own, timed several ways
+    if (opt.overlap_bench) {
+        vector<Contact> contacts;
+        vector<int> bounds(size + 1);
+        if (rank == 0) {
+            load_contacts(opt, files, contacts);
+            bounds = partition_by_bytes(contacts, size, {});
+        }
+        overlap_benchmark(contacts, bounds, search_term, threads, rank, size);
+        finalize();
+        return 0;
+    }
+
+    // Exact-key lookups: every rank indexes its partition, rank 0 broadcasts the batch of keys
+    // and each rank probes them all with the interleaved probe engine
+    if (!opt.lookup.empty()) {
+        bool by_phone = opt.lookup == "phone";
+        vector<Contact> contacts;
+        string batch;                               // Query keys, one per line
+        if (rank == 0) {
+            load_contacts(opt, files, contacts);
+            vector<int> bounds = partition_by_bytes(contacts, size, {});
+            for (int i = 1; i < size; i++) send_string(vector_to_string(contacts, bounds[i], bounds[i + 1]), i);
+            contacts.resize(bounds[1]);
+            ifstream qfile;
+            if (!opt.queries.empty() && opt.queries != "-") qfile.open(opt.queries);
+            istream &qin = opt.queries == "-" ? cin : qfile;
+            string line;
+            if (opt.queries.empty()) batch = search_term + "\n";
+            else while (getline(qin, line)) if (!line.empty()) batch += line + "\n";
+        } else {
+            contacts = string_to_contacts(receive_string(0));
+        }
+        int len = batch.size();
+        MPI_Bcast(&len, 1, MPI_INT, 0, MPI_COMM_WORLD);
+        batch.resize(len);
+        if (tuned) coll_bcast(&coll, &batch[0], len, 0);
+        else MPI_Bcast(&batch[0], len, MPI_CHAR, 0, MPI_COMM_WORLD);
+        vector<string> queries, keys;
+        istringstream iss(batch);
+        for (string q; getline(iss, q);) {
+            queries.push_back(q);
+            keys.push_back(join_key(q, q, by_phone));
+        }
+
+        KeyIndex index = build_key_index(contacts, by_phone);
+        start = MPI_Wtime();
+        vector<vector<int>> hits = batch_lookup(index, keys, opt.lookup_group);
+        end = MPI_Wtime();
+
+        // Rank 0 lists the matches of every query, rank by rank
+        vector<string> found(queries.size());
+        for (size_t q = 0; q < queries.size(); q++) found[q] = format_matches(contacts, 0, hits[q]);
+        if (rank == 0) {
+            for (int i = 1; i < size; i++) {
+                istringstream part(receive_string(i));
+                for (size_t q = 0; q < queries.size(); q++) {
+                    string count, line;
+                    getline(part, count);
+                    for (int k = atoi(count.c_str()); k > 0 && getline(part, line); k--) found[q] += line + "\n";
+                }
+            }
+            ofstream out("output.txt");
+            for (size_t q = 0; q < queries.size(); q++) out << "# " << queries[q] << "\n" << found[q];
+            out.close();
+        } else {
+            string mine;                            // Per query: the match count, then the matches
+            for (size_t q = 0; q < queries.size(); q++) mine += to_string(hits[q].size()) + "\n" + found[q];
+            send_string(mine, 0);
+        }
+        printf("Process %d took %f seconds for %zu lookups.\n", rank, end - start, queries.size());
+        finalize();
+        return 0;
+    }
+
+    // Approximate mode: every rank samples and sketches its partition, rank 0 combines the answers
+    if (opt.approx > 0) {
+        vector<Contact> contacts;
+        if (rank == 0) {
+            load_contacts(opt, files, contacts);
+            vector<int> bounds = partition_by_bytes(contacts, size, {});
+            for (int i = 1; i < size; i++) send_string(vector_to_string(contacts, bounds[i], bounds[i + 1]), i);
+            contacts.resize(bounds[1]);
+        } else {
+            contacts = string_to_contacts(receive_string(0));
+        }
+        LocalScan scan;
+        prepare_scan(scan, opt, contacts, 0, contacts.size(), rank, size);
+        const vector<Contact> &names = scan.how.folded ? *scan.how.folded : contacts;
+        start = MPI_Wtime();
+        Sketches sketches;
+        build_sketches(sketches, names, 0, names.size());
+        Sample sample = draw_sample(names, 0, names.size(), opt.approx, rank);
+        end = MPI_Wtime();
+        reduce_sketches(sketches, rank);
+        string term = scan.how.folded ? fold_name(search_term, scan.how.compat) : search_term;
+        array<double, 5> part = sample_count(sample, term, opt.glob), total;
+        MPI_Reduce(part.data(), total.data(), 5, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+        if (rank == 0) {
+            string report = approx_report(sketches, total, search_term, opt.glob);
+            ofstream out("output.txt");
+            out << report;
+            out.close();
+            cout << report;
+        }
+        printf("Process %d took %f seconds.\n", rank, end - start);
+        finalize();
+        return 0;
+    }
+
+    // Set algebra over saved results only: rank 0 materializes them, no search runs
+    if (!opt.from.empty()) {
+        if (rank == 0) {
+            vector<Contact> contacts;
+            load_contacts(opt, files, contacts);
+            Roaring result;
+            string text;
+            if (!load_result_set(opt, opt.from, result, contacts.size())) {
+                cerr << "Result set '" << opt.from << "' is missing, corrupt or belongs to another phonebook.\n";
+                status = 1;
+            } else if (finish_result_set(opt, result, contacts, text)) {
+                ofstream out("output.txt");
+                out << text;
+                out.close();
+            } else {
+                status = 1;
+            }
+        }
+        finalize();
+        return status;
+    }
+
+    // Replicated service: rank 0 coordinates, every other rank serves one partition
+    if (service) {
+        vector<int> workers = interleave_workers_by_node(rank, size);
+        if (rank == 0) {
+            vector<Contact> contacts;
+            load_contacts(opt, files, contacts);
+            coordinate_queries(opt, contacts, workers, search_term, size);
+        } else {
+            vector<Contact> contacts = string_to_contacts(receive_string(0));
+            LocalScan scan;
+            prepare_scan(scan, opt, contacts, 0, contacts.size(), rank, size);
+            serve_partition(contacts, scan.how);
+        }
+        finalize();
+        return 0;
+    }
 
     // Master process (rank 0) handles reading and distributing the workload
     if (rank == 0) {
-        // Gather all input file names (excluding search term)
-        vector<string> files(argv + 1, argv + argc - 1);
         vector<Contact> contacts;
+        load_contacts(opt, files, contacts);        // Read contacts from the files (or the snapshot)
+        // Divide contacts across processes by name bytes, weighted by last run's speeds if known
+        vector<double> share;
+        if (!opt.speed_file.empty()) share = read_speed_shares(opt.speed_file, size);
+        vector<int> bounds = partition_by_bytes(contacts, size, share);
+        int chunk = bounds[1];                      // Rank 0 keeps records [0, chunk)
 
-        read_phonebook(files, contacts);            // Read contacts from the files
-        int total = contacts.size();                // Total number of contacts
-        int chunk = (total + size - 1) / size;      // Divide contacts across processes (ceil division)
-
-        // Send chunks to all other worker processes
+        // Send chunks to all other worker processes. With the progress thread the sends are only
+        // started here and finish while rank 0 scans its own chunk.
+        vector<string> chunks(size);
+        vector<int> lens(size);
+        vector<MPI_Request> sends;
+        ProgressThread progress;
+        if (opt.progress_thread) start_progress(progress);
         for (int i = 1; i < size; i++) {
-            string text = vector_to_string(contacts, i * chunk, (i + 1) * chunk);
-            send_string(text, i);
+            chunks[i] = vector_to_string(contacts, bounds[i], bounds[i + 1]);
+            if (opt.progress_thread) isend_string(chunks[i], lens[i], i, sends);
+            else if (!tuned) send_string(chunks[i], i);
         }
+        if (tuned) scatter_strings(coll, chunks);
+        if (bitmaps) MPI_Bcast(bounds.data(), size + 1, MPI_INT, 0, MPI_COMM_WORLD); // Workers need their first record ID
+        if (wire.link_rate > 0)
+            printf("Distribution: %lld of %lld messages compressed, %.1f MB sent for %.1f MB of text.\n", wire.packed,
+                   wire.messages, wire.wire_bytes / 1e6, wire.raw_bytes / 1e6);
+        LocalScan scan;
+        prepare_scan(scan, opt, contacts, 0, chunk, rank, size); // Load-time normalization and tokenization
 
         // Process the first chunk of data locally
         start = MPI_Wtime(); // Start timing
-        string result;
-        for (int i = 0; i < min(chunk, total); i++) {
-            string match = check(contacts[i], search_term);
-            if (!match.empty()) result += match;
-        }
+        vector<int> matches = match_range(contacts, 0, chunk, search_term, scan.how);
+        if (!opt.sort.empty() && !bitmaps) sort_records(contacts, 0, matches, opt.sort == "phone");
         end = MPI_Wtime(); // End timing
+        MPI_Waitall(sends.size(), sends.data(), MPI_STATUSES_IGNORE);
+        stop_progress(progress);
+        if (!opt.speed_file.empty()) record_speeds(opt.speed_file, contacts, 0, chunk, end - start, rank, size);
 
-        // Collect results from all worker processes
-        for (int i = 1; i < size; i++) {
-            string recv = receive_string(i);
-            if (!recv.empty()) result += recv;
+        // Collect results from all worker processes (all at once with the tuned gather)
+        bool sorted = !opt.sort.empty() && !bitmaps;
+        vector<string> gathered;
+        if (tuned && !sorted) gathered = gather_strings(coll, "");
+        auto result_of = [&](int i) { return tuned ? gathered[i] : receive_string(i); };
+        if (sorted) {
+            ResultFile out(opt);
+            merge_sorted_runs(contacts, matches, size, opt.sort == "phone", out.out); // Writes while merging
+            out.close();
+            printf("Process %d took %f seconds.\n", rank, end - start);
+            finalize();
+            return 0;
+        }
+        if (bitmaps) {
+            Roaring set;
+            for (int r : matches) roaring_add(set, r);
+            bool intact = true;                     // Every part is still received, so no worker blocks
+            for (int i = 1; i < size; i++) {
+                Roaring part;
+                if (!roaring_deserialize(result_of(i), part)) {
+                    cerr << "Corrupt result bitmap from process " << i << ".\n";
+                    intact = false;
+                }
+                set = roaring_combine(set, part, 'o');
+            }
+            string result;
+            if (!intact || !finish_result_set(opt, set, contacts, result)) {
+                result.clear();
+                status = 1;
+            }
+            ResultFile out(opt);
+            out.out << result;
+            out.close();
+        } else if (opt.compress) {
+            // Every rank's matches arrive as an LZ4 frame; the file is the frames in rank order
+            ofstream out("output.txt.lz4", ios::binary);
+            out << lz4_frame(format_matches(contacts, 0, matches));
+            for (int i = 1; i < size; i++) out << result_of(i);
+            out.close();
+        } else {
+            // Write the matches of every rank to the output as they arrive
+            ResultFile out(opt);
+            out.out << format_matches(contacts, 0, matches);
+            for (int i = 1; i < size; i++) {
+                out.out << result_of(i);
+                out.out.flush();                    // Hand finished lines to a ring consumer now
+            }
+            out.close();
         }
-
-        // Write all results to output file
-        ofstream out("output.txt");
-        out << result;
-        out.close();
 
         // Print execution time
         printf("Process %d took %f seconds.\n", rank, end - start);
 
     } else {
         // Worker processes receive their chunk of data from master
-        string recv_text = receive_string(0);
+        string recv_text = tuned ? scatter_strings(coll, {}) : receive_string(0);
         vector<Contact> contacts = string_to_contacts(recv_text);
+        vector<int> bounds(size + 1);
+        if (bitmaps) MPI_Bcast(bounds.data(), size + 1, MPI_INT, 0, MPI_COMM_WORLD);
+        LocalScan scan;
+        prepare_scan(scan, opt, contacts, 0, contacts.size(), rank, size);
 
         // Process local chunk and search for matches
         start = MPI_Wtime();
-        string result;
-        for (auto &c : contacts) {
-            string match = check(c, search_term);
-            if (!match.empty()) result += match;
-        }
+        vector<int> matches = match_range(contacts, 0, contacts.size(), search_term, scan.how);
+        if (!opt.sort.empty() && !bitmaps) sort_records(contacts, 0, matches, opt.sort == "phone");
         end = MPI_Wtime();
+        if (!opt.speed_file.empty()) record_speeds(opt.speed_file, contacts, 0, contacts.size(), end - start, rank, size);
 
-        // Send found matches back to master
-        send_string(result, 0);
+        // Send found matches back to master, as global record IDs when building result sets
+        if (!opt.sort.empty() && !bitmaps) {
+            send_sorted_run(contacts, matches);
+        } else if (bitmaps) {
+            Roaring set;
+            for (int r : matches) roaring_add(set, bounds[rank] + r);
+            if (tuned) gather_strings(coll, roaring_serialize(set));
+            else send_string(roaring_serialize(set), 0);
+        } else {
+            string text = format_matches(contacts, 0, matches);
+            if (opt.compress) text = lz4_frame(text); // Compressed before it travels
+            if (tuned) gather_strings(coll, text);
+            else send_string(text, 0);
+        }
         printf("Process %d took %f seconds.\n", rank, end - start);
     }
 
-    MPI_Finalize(); // Clean up and exit
-    return 0;
+    finalize(); // Clean up and exit
+    return status;
 }
@@ -0,0 +1,138 @@
+/*
+    Shared-memory result ring of phonebook_mpi.cpp (--shm-sink <path>).
+
+    With --shm-sink the search publishes its matches, as batches of whole lines, into a
+    single-producer single-consumer ring in a memfd instead of writing output.txt. <path> is a
+    symlink to the memfd, so a local consumer attaches with open + mmap and reads each batch in
+    place (no copy, no disk) while the search is still running:
+
+        #include "phonebook_ring.h"
+
+        pb_ring ring;
+        if (pb_ring_attach(&ring, "/tmp/phonebook.ring") != 0) return 1;
+        const char *data;
+        long n;
+        while ((n = pb_ring_next(&ring, &data)) > 0) {
+            fwrite(data, 1, n, stdout);          // data points into the shared mapping
+            pb_ring_release(&ring);              // hand the space back to the producer
+        }
+        pb_ring_detach(&ring);
+
+    The header is all there is to the consumer library; it compiles as C or C++.
+
+    Layout: one 4 KB header page, then a data area of `capacity` bytes (a power of two). head and
+    tail are byte counters that only grow; a position maps to offset pos & (capacity - 1). Each
+    record is a 4-byte length, 4 reserved bytes and the payload, padded to 8 bytes. A record that
+    would cross the end of the data area is preceded by a PB_RING_WRAP marker and starts again at
+    offset 0. The producer publishes a record with a release store of head, the consumer frees it
+    with a release store of tail.
+*/
+
+#ifndef PHONEBOOK_RING_H
+#define PHONEBOOK_RING_H
+
+#include <fcntl.h>
+#include <sched.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define PB_RING_MAGIC 0x0031474E49524250ULL  /* "PBRING1" as little-endian bytes */
+#define PB_RING_DATA 4096                     /* Offset of the data area */
+#define PB_RING_WRAP 0xFFFFFFFFU              /* Record length that means "continue at offset 0" */
+
+// Shared header at the start of the mapping; head, tail and closed sit on their own cache lines
+typedef struct {
+    uint64_t magic;
+    uint64_t capacity;                        // Bytes in the data area
+    uint64_t head __attribute__((aligned(64)));   // Bytes published by the producer
+    uint64_t tail __attribute__((aligned(64)));   // Bytes released by the consumer
+    uint32_t closed __attribute__((aligned(64))); // 1 once the producer has published everything
+} pb_ring_header;
+
+// Consumer side of an attached ring
+typedef struct {
+    pb_ring_header *hdr;
+    char *data;
+    size_t bytes;                             // Size of the whole mapping
+    uint64_t pending;                         // Bytes of the record handed out by pb_ring_next
+} pb_ring;
+
+// Space a record with an n-byte payload takes in the ring
+static inline uint64_t pb_ring_record_bytes(uint64_t n) {
+    return 8 + ((n + 7) & ~(uint64_t)7);
+}
+
+// Backs off while waiting for the other side: spin briefly, then yield, then sleep
+static inline void pb_ring_pause(unsigned *spins) {
+    if (++*spins < 64) return;
+    if (*spins < 1024) { sched_yield(); return; }
+    struct timespec ts = {0, 50000};
+    nanosleep(&ts, NULL);
+}
+
+// Maps the ring behind `path`; returns 0 on success, -1 if it cannot be opened or is no ring
+static inline int pb_ring_attach(pb_ring *r, const char *path) {
+    int fd = open(path, O_RDWR);
+    if (fd < 0) return -1;
+    struct stat st;
+    void *base = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > PB_RING_DATA)
+        base = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);                                // The mapping keeps the memfd alive
+    if (base == MAP_FAILED) return -1;
+    r->hdr = (pb_ring_header *)base;
+    r->data = (char *)base + PB_RING_DATA;
+    r->bytes = st.st_size;
+    r->pending = 0;
+    if (r->hdr->magic != PB_RING_MAGIC || PB_RING_DATA + r->hdr->capacity > r->bytes) {
+        munmap(base, st.st_size);
+        return -1;
+    }
+    return 0;
+}
+
+// Waits for the next batch and points *data at it inside the mapping. Returns its length, or 0
+// once the producer has closed the ring and everything has been read. Call pb_ring_release
+// when done with the batch; the pointer stays valid until then.
+static inline long pb_ring_next(pb_ring *r, const char **data) {
+    pb_ring_header *h = r->hdr;
+    uint64_t mask = h->capacity - 1, tail = h->tail;
+    unsigned spins = 0;
+    while (1) {
+        uint64_t head = __atomic_load_n(&h->head, __ATOMIC_ACQUIRE);
+        if (head == tail) {
+            if (__atomic_load_n(&h->closed, __ATOMIC_ACQUIRE) && __atomic_load_n(&h->head, __ATOMIC_ACQUIRE) == tail)
+                return 0;
+            pb_ring_pause(&spins);
+            continue;
+        }
+        uint32_t len;
+        memcpy(&len, r->data + (tail & mask), 4);
+        if (len == PB_RING_WRAP) {            // Skip the unused end of the data area
+            tail += h->capacity - (tail & mask);
+            __atomic_store_n(&h->tail, tail, __ATOMIC_RELEASE);
+            continue;
+        }
+        *data = r->data + (tail & mask) + 8;
+        r->pending = pb_ring_record_bytes(len);
+        return len;
+    }
+}
+
+// Frees the batch returned by the last pb_ring_next
+static inline void pb_ring_release(pb_ring *r) {
+    __atomic_store_n(&r->hdr->tail, r->hdr->tail + r->pending, __ATOMIC_RELEASE);
+    r->pending = 0;
+}
+
+// Unmaps the ring
+static inline void pb_ring_detach(pb_ring *r) {
+    munmap(r->hdr, r->bytes);
+    r->hdr = NULL;
+}
+
+#endif
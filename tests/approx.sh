@@ -0,0 +1,24 @@
+# Approximate answers (user-111): with every record sampled the estimates are exact; with a 10%
+# sample the confidence interval still contains the true match count.
+. "$(dirname "$0")/lib.sh"
+
+for np in 1 3; do
+    run $np --approx 1 "$ROOT/phonebook1.txt" AKTER
+    grep -v ' took ' run.log > report.txt
+    expect_ordered report.txt <<'EOF'
+Matches for "AKTER": about 6, 95% CI [6, 6] (89 of 89 records sampled)
+Contacts with token "akter": at most 6 (Count-Min; overcount <= 0 with 98.2% probability)
+Distinct names: about 88, 95% CI [87, 90] (HyperLogLog, 0.81% standard error)
+Distinct name tokens: about 168, 95% CI [165, 171] (HyperLogLog, 0.81% standard error)
+Distinct surnames: about 76, 95% CI [75, 77] (HyperLogLog, 0.81% standard error)
+EOF
+done
+
+synthetic_book names.txt
+run 3 --approx 0.1 names.txt "KHAN KHAN"
+sed -n 's/^Matches for "KHAN KHAN": about [0-9]*, 95% CI \[\([0-9]*\), \([0-9]*\)\].*/\1 \2/p' run.log > ci.txt
+read lo hi < ci.txt || fail "no match estimate"
+[ "$lo" -le 585 ] && [ 585 -le "$hi" ] || fail "CI [$lo, $hi] misses the 585 matches"
+sed -n 's/^Distinct names: about \([0-9]*\),.*/\1/p' run.log > names_estimate.txt
+read names < names_estimate.txt
+[ "$names" -ge 490 ] && [ "$names" -le 535 ] || fail "estimated $names distinct names, not about 512"
@@ -0,0 +1,32 @@
+# Tuned collectives (user-120): the chunks are scattered and the matches gathered with every
+# algorithm forced in turn through a hand-written tuning file, and with one the benchmark fills.
+. "$(dirname "$0")/lib.sh"
+
+run 3 "$ROOT/phonebook1.txt" A
+mv output.txt plain.txt
+
+for algorithm in library linear binomial chain hierarchical; do
+    printf 'scatter 3 1 0 %s\ngather 3 1 0 %s\nbcast 3 1 0 binomial\n' $algorithm $algorithm > forced.tune
+    run 3 --coll-tune forced.tune "$ROOT/phonebook1.txt" RAHMAN
+    expect <<'EOF'
+SADIA BINTA M RAHMAN 017 62 031
+SAKIA RAHMAN 017 75 523
+EOF
+    run 3 --coll-tune forced.tune "$ROOT/phonebook1.txt" A
+    expect < plain.txt
+done
+
+run 3 --coll-tune measured.tune "$ROOT/phonebook1.txt" A
+expect < plain.txt
+grep -q '^scatter 3 ' measured.tune || fail "the benchmark wrote no scatter rules"
+
+# The matrix program scatters A and B and gathers R through the same collectives
+PROGRAM=matrix
+for algorithm in linear binomial chain hierarchical; do
+    printf 'scatter 4 1 0 %s\ngather 4 1 0 %s\nbcast 4 1 0 binomial\n' $algorithm $algorithm > forced.tune
+    run 4 --coll-tune forced.tune --verify
+    expect_log "Verify: R matches the plain kernel"
+done
+run 4 --coll-tune matrix.tune --verify
+expect_log "Verify: R matches the plain kernel"
+grep -q '^gather 4 ' matrix.tune || fail "the benchmark wrote no gather rules"
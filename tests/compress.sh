@@ -0,0 +1,38 @@
+# Compressed output (user-116): output.txt.lz4 decodes with the stock lz4 tool to the plain matches,
+# for the per-rank frames, for the sorted merge and for output larger than one LZ4 block.
+. "$(dirname "$0")/lib.sh"
+
+if ! command -v lz4 > /dev/null; then
+    echo "skipped $TEST: no lz4 tool to decode the output" >&2
+    exit 0
+fi
+
+run 3 --compress lz4 "$ROOT/phonebook1.txt" AKTER
+[ ! -e output.txt ] || fail "--compress lz4 should not write output.txt"
+lz4 -dc output.txt.lz4 > decoded.txt
+expect decoded.txt <<'EOF'
+SAZNIN AKTER ZITU 016 16 217
+SUMAIYA AKTER SWEETY 018 07 741
+SUNJIDA AKTER NIPA 012 20 350
+SUMAIA AKTER TISHA 011 77 602
+FARJANA AKTER POPY 014 27 168
+MOSAMMAD SHARMIN AKTER 015 10 657
+EOF
+
+run 3 --compress lz4 --sort name "$ROOT/phonebook1.txt" AKTER
+lz4 -dc output.txt.lz4 > decoded.txt
+expect_ordered decoded.txt <<'EOF'
+FARJANA AKTER POPY 014 27 168
+MOSAMMAD SHARMIN AKTER 015 10 657
+SAZNIN AKTER ZITU 016 16 217
+SUMAIA AKTER TISHA 011 77 602
+SUMAIYA AKTER SWEETY 018 07 741
+SUNJIDA AKTER NIPA 012 20 350
+EOF
+
+synthetic_book names.txt
+run 3 names.txt KHAN
+mv output.txt plain.txt
+run 3 --compress lz4 names.txt KHAN
+lz4 -dc output.txt.lz4 > decoded.txt
+expect decoded.txt < plain.txt
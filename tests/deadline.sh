@@ -0,0 +1,22 @@
+# Deadlines (user-112): queries with feasible deadlines (their own or --deadline-ms) are answered in
+# full, and one whose deadline cannot be met is rejected at admission instead of answered late.
+. "$(dirname "$0")/lib.sh"
+
+printf 'FATEMA\t1000\t0\nRAHMAN\t0.001\t1\nAKTER\n' > queries.txt
+run 3 --queries queries.txt --deadline-ms 500 "$ROOT/phonebook1.txt"
+expect_log "Deadlines: 0 queries answered partially, 1 rejected at admission."
+grep -q '^# RAHMAN \[rejected: ' output.txt || fail "RAHMAN should be rejected"
+grep -v '^# RAHMAN' output.txt > answered.txt
+expect answered.txt <<'EOF'
+# FATEMA
+FATEMA JAHAN TAMMY 015 05 040
+BIBI FATEMA MIM 015 34 336
+KANIZ FATEMA SORNA 014 56 440
+# AKTER
+SAZNIN AKTER ZITU 016 16 217
+SUMAIYA AKTER SWEETY 018 07 741
+SUNJIDA AKTER NIPA 012 20 350
+SUMAIA AKTER TISHA 011 77 602
+FARJANA AKTER POPY 014 27 168
+MOSAMMAD SHARMIN AKTER 015 10 657
+EOF
@@ -0,0 +1,26 @@
+# Near-duplicate clustering (user-108): the same clusters on one and several ranks, including
+# records whose names are longer than 64 KiB, which must cross ranks without being truncated.
+. "$(dirname "$0")/lib.sh"
+
+long=$(printf 'LONG %.0s' $(seq 20000))
+printf '%s\n' '"FATEMA JAHAN TAMMY","015 05 040"' '"FATEMA JAHAN TAMY","015 05 041"' \
+    '"TAMMY FATEMA JAHAN","015 05 042"' '"SAZNIN AKTER ZITU","016 16 217"' '"SAZNIN AKTAR ZITU","016 16 218"' \
+    '"ANTU RANI HOWLADAR","017 62 174"' '"MD SAJJAD HOSSAIN","018 00 000"' \
+    "\"${long}NAME\",\"019 00 001\"" "\"${long}NAMES\",\"019 00 002\"" > names.txt
+
+for np in 1 3; do
+    run $np --dedup names.txt
+    expect_log "3 clusters"
+    expect_ordered <<EOF
+FATEMA JAHAN TAMMY 015 05 040
+FATEMA JAHAN TAMY 015 05 041
+TAMMY FATEMA JAHAN 015 05 042
+
+SAZNIN AKTER ZITU 016 16 217
+SAZNIN AKTAR ZITU 016 16 218
+
+${long}NAME 019 00 001
+${long}NAMES 019 00 002
+
+EOF
+done
@@ -0,0 +1,42 @@
+# Glob patterns (user-107): --glob matches whole names with * and ?, with and without literal
+# anchors for the prefilter, and case-insensitively under --normalize.
+. "$(dirname "$0")/lib.sh"
+
+run 3 --glob "$ROOT/phonebook1.txt" "S?DIA*"
+expect <<'EOF'
+SADIA BINTA M RAHMAN 017 62 031
+SADIA RAHAMAN 013 76 420
+SADIA ISLAM 018 73 425
+SADIA AFRIN 018 44 050
+SADIA AFROZ MOW 011 35 161
+EOF
+
+run 3 --glob "$ROOT/phonebook1.txt" "*RAHMAN"
+expect <<'EOF'
+SADIA BINTA M RAHMAN 017 62 031
+SAKIA RAHMAN 017 75 523
+EOF
+
+run 2 --glob "$ROOT/phonebook1.txt" "K*A"
+expect <<'EOF'
+KHADIZATUL KOBRA 015 03 625
+KHADIJA ISLAM SUJANA 012 56 812
+KANIZ FATEMA SORNA 014 56 440
+EOF
+
+# A pattern without wildcards is a whole name, not a substring
+run 2 --glob "$ROOT/phonebook1.txt" FATEMA
+expect < /dev/null
+run 1 --glob "$ROOT/phonebook1.txt" "FATEMA JAHAN TAMMY"
+expect <<'EOF'
+FATEMA JAHAN TAMMY 015 05 040
+EOF
+
+run 2 --glob "$ROOT/phonebook1.txt" "*"
+[ "$(wc -l < output.txt)" -eq 89 ] || fail "* should match all 89 contacts"
+
+run 2 --glob --normalize nfc "$ROOT/phonebook1.txt" "s?dia a*"
+expect <<'EOF'
+SADIA AFRIN 018 44 050
+SADIA AFROZ MOW 011 35 161
+EOF
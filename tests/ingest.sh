@@ -0,0 +1,20 @@
+# Staged ingest (user-114): the reader / parsers / builder pipeline loads several files, including
+# one without a final newline and a malformed line, into the same book as the plain loader.
+. "$(dirname "$0")/lib.sh"
+
+printf '"A ONE","1"\n"B TWO","2"\n' > second.txt
+printf 'garbage line\n"C ONE","3"' > third.txt
+
+for threads in 1 4; do
+    run 2 --ingest-threads $threads "$ROOT/phonebook1.txt" second.txt third.txt ONE
+    expect <<'EOF'
+A ONE 1
+C ONE 3
+EOF
+done
+
+synthetic_book names.txt
+run 3 names.txt second.txt "KHAN KHAN"
+mv output.txt plain.txt
+run 3 --ingest-threads 3 names.txt second.txt "KHAN KHAN"
+expect < plain.txt
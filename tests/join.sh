@@ -0,0 +1,29 @@
+# Distributed hash join (user-109): contacts of the first book that appear in the second, by name
+# (case and spacing ignored) and by phone digits, on one and several ranks, long names included.
+. "$(dirname "$0")/lib.sh"
+
+long=$(printf 'LONG %.0s' $(seq 20000))
+printf '%s\n' '"FATEMA JAHAN TAMMY","015 05 040"' '"ALIAS ONE","017 62 031"' '"sakia  rahman","999"' \
+    '"NOBODY","000 00 000"' '"DIGITS ONLY","01505040"' > second.txt
+# phonebook1.txt has no final newline
+{ cat "$ROOT/phonebook1.txt"; echo; } > first.txt
+printf '"%sNAME","019 00 001"\n' "$long" >> first.txt
+printf '"%sname","019 00 002"\n' "$long" >> second.txt
+
+for np in 1 3; do
+    run $np --join name first.txt second.txt
+    expect_log "Join on name: 3 matching pairs."
+    expect <<EOF
+FATEMA JAHAN TAMMY 015 05 040 | FATEMA JAHAN TAMMY 015 05 040
+SAKIA RAHMAN 017 75 523 | sakia  rahman 999
+${long}NAME 019 00 001 | ${long}name 019 00 002
+EOF
+
+    run $np --join phone first.txt second.txt
+    expect_log "Join on phone: 3 matching pairs."
+    expect <<'EOF'
+FATEMA JAHAN TAMMY 015 05 040 | FATEMA JAHAN TAMMY 015 05 040
+FATEMA JAHAN TAMMY 015 05 040 | DIGITS ONLY 01505040
+SADIA BINTA M RAHMAN 017 62 031 | ALIAS ONE 017 62 031
+EOF
+done
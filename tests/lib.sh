@@ -0,0 +1,76 @@
+# Shared helpers of the smoke tests (sourced, not run): build the search and the matrix programs
+# once into a scratch directory, run them there on fixed input and compare what they wrote with the
+# expected text.
+#
+#   run <procs> <args>...      mpirun $PROGRAM (search unless the test sets PROGRAM=matrix); its
+#                              stdout/stderr go to run.log
+#   fails <procs> <args>...    like run, but the program must exit non-zero
+#   expect [file]              the lines of file (default output.txt), in any order, must equal stdin
+#   expect_ordered [file]      the same, but the order must match too
+#   expect_log <text>          run.log must contain text
+#   synthetic_book <file>      20000 contacts over 512 distinct names, 585 containing "KHAN KHAN"
+#
+# MPIRUN overrides the launcher (default "mpirun --oversubscribe"); PB_WORK reuses a directory
+# that already holds the builds, which is how tests/run.sh builds only once.
+
+set -eu
+
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+TEST=$(basename "$0" .sh)
+MPIRUN=${MPIRUN:-mpirun --oversubscribe}
+PROGRAM=search
+
+if [ -n "${PB_WORK:-}" ]; then
+    WORK=$PB_WORK/$TEST
+else
+    WORK=$(mktemp -d)
+    trap 'rm -rf "$WORK"' EXIT
+fi
+mkdir -p "$WORK"
+if [ -x "${PB_WORK:-}/search" ]; then
+    ln -sf "$PB_WORK/search" "$PB_WORK/matrix" "$WORK"
+else
+    mpic++ -O2 -o "$WORK/search" "$ROOT/phonebook_mpi.cpp"
+    mpicc -O2 -o "$WORK/matrix" "$ROOT/matrix_mul_mpi.c" -lm
+fi
+cd "$WORK"
+
+fail() {
+    echo "FAIL $TEST: $*" >&2
+    [ -f run.log ] && sed 's/^/  | /' run.log >&2
+    exit 1
+}
+
+run() {
+    local np=$1; shift
+    rm -f output.txt
+    $MPIRUN -np "$np" ./$PROGRAM "$@" > run.log 2>&1 || fail "exit code $? from: $PROGRAM $*"
+}
+
+fails() {
+    local np=$1; shift
+    rm -f output.txt
+    if $MPIRUN -np "$np" ./$PROGRAM "$@" > run.log 2>&1; then fail "$PROGRAM $* should have failed"; fi
+}
+
+expect() {
+    cat > expected.txt
+    sort "${1:-output.txt}" > got.txt
+    sort expected.txt | diff -u - got.txt >&2 || fail "unexpected ${1:-output.txt}"
+}
+
+expect_ordered() {
+    cat > expected.txt
+    diff -u expected.txt "${1:-output.txt}" >&2 || fail "unexpected order of ${1:-output.txt}"
+}
+
+expect_log() {
+    grep -qF -- "$1" run.log || fail "run.log lacks: $1"
+}
+
+synthetic_book() {
+    awk 'BEGIN { split("FATEMA JAHAN RAHMAN AKTER HOSSAIN ISLAM BEGUM KHAN", w, " ")
+                 for (i = 0; i < 20000; i++)
+                     printf "\"%s %s %s\",\"01%d %02d %03d\"\n", w[i % 8 + 1], w[int(i / 8) % 8 + 1],
+                            w[int(i / 64) % 8 + 1], i % 10, i % 97, i % 1000 }' > "$1"
+}
@@ -0,0 +1,58 @@
+# Embeddable library (user-119): build libphonebook.so as documented, query it from C in every
+# mode, open snapshots through it (a truncated one must fail cleanly), and check that nothing but
+# the pb_* API is exported.
+. "$(dirname "$0")/lib.sh"
+
+g++ -O2 -fPIC -shared -fvisibility=hidden -Wl,--version-script="$ROOT/phonebook.map" \
+    -o libphonebook.so "$ROOT/phonebook_lib.cpp" -lpthread
+cat > app.c <<'EOF'
+#include <stdio.h>
+#include <string.h>
+#include "phonebook.h"
+
+static int print_row(const char *name, const char *phone, void *user) {
+    printf("%s%s %s\n", (const char *)user, name, phone);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    pb_book *book = strcmp(argv[1], "files") == 0 ? pb_open_files((const char *const *)argv + 2, 1, 0)
+                                                  : pb_open_snapshot(argv[2], 0);
+    if (book == NULL) { printf("error: %s\n", pb_error()); return 1; }
+    printf("%zu records\n", pb_size(book));
+    pb_result *res = pb_query(book, "FATEMA", PB_SUBSTRING);
+    const char *name, *phone;
+    while (pb_result_next(res, &name, &phone)) printf("substring: %s %s\n", name, phone);
+    pb_result_free(res);
+    pb_search(book, "K?NIZ *", PB_GLOB, print_row, "glob: ");
+    pb_search(book, "fatema  jahan TAMMY", PB_EXACT_NAME, print_row, "exact: ");
+    pb_search(book, "01762031", PB_PHONE, print_row, "phone: ");
+    pb_close(book);
+    return 0;
+}
+EOF
+cc -O2 -I"$ROOT" -o app app.c -L. -lphonebook
+
+nm -D --defined-only libphonebook.so | awk '$2 != "A" && $3 !~ /^pb_/' > leaked.txt
+expect leaked.txt < /dev/null
+
+LD_LIBRARY_PATH=. ./app files "$ROOT/phonebook1.txt" > app.txt
+expect app.txt <<'EOF'
+89 records
+substring: FATEMA JAHAN TAMMY 015 05 040
+substring: BIBI FATEMA MIM 015 34 336
+substring: KANIZ FATEMA SORNA 014 56 440
+glob: KANIZ FATEMA SORNA 014 56 440
+exact: FATEMA JAHAN TAMMY 015 05 040
+phone: SADIA BINTA M RAHMAN 017 62 031
+EOF
+
+run 2 --build-snapshot book.snap "$ROOT/phonebook1.txt"
+LD_LIBRARY_PATH=. ./app snapshot book.snap > snap.txt
+expect snap.txt < app.txt
+
+head -c $(($(wc -c < book.snap) / 2)) book.snap > cut.snap
+if LD_LIBRARY_PATH=. ./app snapshot cut.snap > cut.txt; then fail "a truncated snapshot opened"; fi
+expect cut.txt <<'EOF'
+error: cut.snap: corrupt snapshot
+EOF
@@ -0,0 +1,34 @@
+# Exact-key lookups (user-115): --lookup name|phone for one term and for a query file, probed one
+# at a time and in interleaved groups, with the answers in query order.
+. "$(dirname "$0")/lib.sh"
+
+run 3 --lookup name "$ROOT/phonebook1.txt" "fatema  jahan tammy"
+expect_ordered <<'EOF'
+# fatema  jahan tammy
+FATEMA JAHAN TAMMY 015 05 040
+EOF
+
+run 3 --lookup phone "$ROOT/phonebook1.txt" 01762031
+expect_ordered <<'EOF'
+# 01762031
+SADIA BINTA M RAHMAN 017 62 031
+EOF
+
+printf 'FATEMA JAHAN TAMMY\nnobody\nSAKIA RAHMAN\n' > queries.txt
+for group in 1 2 16; do
+    run 3 --lookup name --lookup-group $group --queries queries.txt "$ROOT/phonebook1.txt"
+    expect_ordered <<'EOF'
+# FATEMA JAHAN TAMMY
+FATEMA JAHAN TAMMY 015 05 040
+# nobody
+# SAKIA RAHMAN
+SAKIA RAHMAN 017 75 523
+EOF
+done
+
+# These two names occur 39 times each in the synthetic book; all copies must be found
+synthetic_book names.txt
+printf 'KHAN KHAN KHAN\nfatema jahan rahman\n' > many.txt
+run 2 --lookup name --queries many.txt names.txt
+[ "$(grep -c '^KHAN KHAN KHAN ' output.txt)" -eq 39 ] || fail "expected 39 KHAN KHAN KHAN"
+[ "$(grep -c '^FATEMA JAHAN RAHMAN ' output.txt)" -eq 39 ] || fail "expected 39 FATEMA JAHAN RAHMAN"
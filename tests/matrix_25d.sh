@@ -0,0 +1,15 @@
+# 2.5D multiply (user-124): with replicated layers and the reduce-scatter (c = 2) and as plain
+# SUMMA (c = 1) the product matches the plain kernel; a process count that forms no grid is refused.
+. "$(dirname "$0")/lib.sh"
+PROGRAM=matrix
+
+run 8 --2.5d 2 --verify
+expect_log "2.5D multiply: 768 x 768 on a 2 x 2 x 2 grid (8 processes)"
+expect_log "Verify: R matches the plain kernel"
+
+run 4 --2.5d 1 --verify
+expect_log "2.5D multiply: 768 x 768 on a 2 x 2 x 1 grid (4 processes)"
+expect_log "Verify: R matches the plain kernel"
+
+fails 6 --2.5d 2
+expect_log "2.5D needs q x q x c processes with c <= q and q dividing 768; 6 processes, c = 2 do not fit"
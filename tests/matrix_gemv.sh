@@ -0,0 +1,14 @@
+# Batched GEMV (user-122): the byte kernel computes exactly what the general kernel does, for one
+# vector, a few and more than one block of vectors, also when the matrices do not split evenly.
+. "$(dirname "$0")/lib.sh"
+PROGRAM=matrix
+
+run 3 --gemv 2
+expect_log "GEMV: 3 processes, 100 matrices of 1024 x 1024, 2 vector(s) each"
+expect_log "  results identical"
+
+for v in 1 9; do
+    run 4 --gemv $v --dims 10 50 50 50
+    expect_log "GEMV: 4 processes, 10 matrices of 1024 x 1024, $v vector(s) each"
+    expect_log "  results identical"
+done
@@ -0,0 +1,22 @@
+# Linear systems over GF(65521) (user-123): the batched solves and inverses and the block-cyclic
+# solve check their answers against the original systems, on square and uneven process grids.
+. "$(dirname "$0")/lib.sh"
+PROGRAM=matrix
+
+run 4 --solve batch
+expect_log "solved and inverted 100, singular 0; A x = b and A A^-1 = I hold for all of them"
+# Orders that leave a partial block, and fewer systems on some processes than on others
+run 4 --solve batch --dims 10 45 1 1
+expect_log "solved and inverted 10, singular 0; A x = b and A A^-1 = I hold for all of them"
+
+# Square and non-square grids; the 769 columns (b appended) make 25 blocks, the last one partial,
+# which the 2 process columns of the 2 x 2 and 3 x 2 grids share unevenly
+for np in 4 3 6; do
+    run $np --solve cyclic
+    expect_log "GF(65521) cyclic: one system of order 768 on a"
+    expect_log "A x = b holds"
+done
+expect_log "on a 3 x 2 grid, blocks of 32"
+
+fails 2 --solve bogus
+expect_log "Unknown solve mode bogus (batch or cyclic)"
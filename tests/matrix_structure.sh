@@ -0,0 +1,21 @@
+# Structured products (user-121): symmetric, lower and upper R agree with the plain kernel on the
+# default and on uneven shapes, and an unknown structure or a non-square triangular A is refused.
+. "$(dirname "$0")/lib.sh"
+PROGRAM=matrix
+
+for s in symmetric lower upper; do
+    run 3 --structure $s --verify
+    expect_log "Structure $s: 6375000 of 12500000 multiply-adds (51%)"
+    expect_log "Verify: R matches the plain kernel"
+done
+
+# Fewer rows than processes for some matrices, and a symmetric product of a non-square A
+run 4 --structure lower --dims 7 9 9 5 --verify
+expect_log "Verify: R matches the plain kernel"
+run 4 --structure symmetric --dims 5 6 11 3 --verify
+expect_log "Verify: R matches the plain kernel"
+
+fails 3 --structure bogus
+expect_log "Unknown structure bogus (full, symmetric, lower or upper)"
+fails 3 --structure upper --dims 6 5 7 5
+expect_log "Triangular operands must be square."
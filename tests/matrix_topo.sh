@@ -0,0 +1,20 @@
+# Node-aware process grids (user-125): on one real node rank order stays; on simulated nodes that
+# rank order serves badly another placement is chosen, and the solve and the product still verify.
+. "$(dirname "$0")/lib.sh"
+PROGRAM=matrix
+
+run 4 --solve cyclic --topo-grid
+expect_log "Grid layout: 1 node(s), 100% of the neighbour bytes on-node in rank order, 100% with rank order"
+expect_log "A x = b holds"
+
+# Ranks dealt round-robin to 3 nodes share no grid neighbours in rank order
+run 6 --solve cyclic --topo-grid --simulate-nodes 3
+expect_log "Grid layout: 3 node(s), 0% of the neighbour bytes on-node in rank order, 33% with node blocks"
+expect_log "A x = b holds"
+
+run 8 --2.5d 2 --topo-grid --simulate-nodes 3 --verify
+expect_log "Grid layout: 3 node(s), 0% of the neighbour bytes on-node in rank order, 47% with node blocks"
+expect_log "Verify: R matches the plain kernel"
+
+fails 4 --solve cyclic --topo-grid --simulate-nodes 5
+expect_log "--simulate-nodes needs 1 to 4 nodes."
@@ -0,0 +1,50 @@
+# UTF-8 normalization (user-110): canonically equivalent and differently cased spellings match,
+# across the whole Greek block (tonos capitals, final sigma, the 0x3D0-0x3FF symbol variants).
+. "$(dirname "$0")/lib.sh"
+
+acute=$(printf '\314\201')    # "Jose" + combining acute: decomposed, and kept that way in the output
+printf '%s\n' '"ΣΊΣΥΦΟΣ","0171"' '"Σίσυφος","0172"' '"Άννα Ιωάννου","0173"' '"JOSÉ ÅSTRÖM","0174"' \
+    "\"Jose$acute ﬁnn\",\"0175\"" '"ϐασίλης","0176"' '"FATEMA JAHAN","0177"' > names.txt
+
+run 2 --normalize nfc names.txt "σίσυφος"
+expect <<'EOF'
+ΣΊΣΥΦΟΣ 0171
+Σίσυφος 0172
+EOF
+
+run 2 --normalize nfc names.txt "ΆΝΝΑ"
+expect <<'EOF'
+Άννα Ιωάννου 0173
+EOF
+
+run 2 --normalize nfc names.txt "βασίλης"
+expect <<'EOF'
+ϐασίλης 0176
+EOF
+
+run 2 --normalize nfc names.txt "josé"
+expect <<EOF
+JOSÉ ÅSTRÖM 0174
+Jose$acute ﬁnn 0175
+EOF
+
+# Full case folding expands the ligature; fullwidth letters are only compatibility equivalents
+run 1 --normalize nfc names.txt "FINN"
+expect <<EOF
+Jose$acute ﬁnn 0175
+EOF
+
+run 2 --normalize nfc names.txt "ＦＡＴＥＭＡ"
+expect < /dev/null
+run 2 --normalize nfkc names.txt "ＦＡＴＥＭＡ"
+expect <<'EOF'
+FATEMA JAHAN 0177
+EOF
+
+# Snapshot keys go through the same folding
+run 2 --build-snapshot names.snap names.txt
+run 1 --snapshot names.snap --exact "σίσυφοσ"
+expect <<'EOF'
+ΣΊΣΥΦΟΣ 0171
+Σίσυφος 0172
+EOF
@@ -0,0 +1,38 @@
+# Byte-balanced partitions (user-106): names of very different lengths, equal shares and skewed
+# speed-file shares all find every match, and a run leaves one speed per rank in the file.
+. "$(dirname "$0")/lib.sh"
+
+long=$(printf 'X%.0s' $(seq 3000))
+{
+    printf '"%s TARGET ONE","011 00 001"\n' "$long"
+    for i in $(seq 1 200); do printf '"P%d","011 %02d %03d"\n' $i $((i % 100)) $i; done
+    printf '"TARGET TWO","011 00 002"\n'
+    printf '"%s","011 00 003"\n' "$long"
+    printf '"LAST TARGET","011 00 004"\n'
+} > names.txt
+
+for np in 1 2 4; do
+    run $np names.txt TARGET
+    sed "s/^$long/LONG/" output.txt > short.txt
+    expect short.txt <<'EOF'
+LONG TARGET ONE 011 00 001
+TARGET TWO 011 00 002
+LAST TARGET 011 00 004
+EOF
+done
+
+printf '1\n3\n' > speeds.txt
+run 2 --speed-file speeds.txt "$ROOT/phonebook1.txt" AKTER
+expect <<'EOF'
+SAZNIN AKTER ZITU 016 16 217
+SUMAIYA AKTER SWEETY 018 07 741
+SUNJIDA AKTER NIPA 012 20 350
+SUMAIA AKTER TISHA 011 77 602
+FARJANA AKTER POPY 014 27 168
+MOSAMMAD SHARMIN AKTER 015 10 657
+EOF
+[ "$(wc -l < speeds.txt)" -eq 2 ] || fail "speeds.txt should hold one speed per rank"
+
+rm -f speeds.txt
+run 3 --speed-file speeds.txt "$ROOT/phonebook1.txt" AKTER
+[ "$(wc -l < speeds.txt)" -eq 3 ] || fail "speeds.txt should hold one speed per rank"
@@ -0,0 +1,24 @@
+# Progress thread (user-113): the overlapped distribution finds the same matches as the plain one,
+# on a small book and on one large enough for several distribution stages, and the overlap
+# benchmark runs to its report.
+. "$(dirname "$0")/lib.sh"
+
+run 3 --progress-thread "$ROOT/phonebook1.txt" AKTER
+expect <<'EOF'
+SAZNIN AKTER ZITU 016 16 217
+SUMAIYA AKTER SWEETY 018 07 741
+SUNJIDA AKTER NIPA 012 20 350
+SUMAIA AKTER TISHA 011 77 602
+FARJANA AKTER POPY 014 27 168
+MOSAMMAD SHARMIN AKTER 015 10 657
+EOF
+
+synthetic_book names.txt
+run 3 names.txt "KHAN KHAN"
+mv output.txt plain.txt
+run 3 --progress-thread names.txt "KHAN KHAN"
+expect < plain.txt
+
+run 3 --overlap-bench names.txt "KHAN KHAN"
+expect_log "Overlap benchmark: 2 workers"
+expect_log "send + scan, progress thread"
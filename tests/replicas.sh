@@ -0,0 +1,34 @@
+# Replicated partitions (user-101): a query file served by 2 or 3 replicas per partition, with
+# several queries in flight and with hedging, answers every query exactly once.
+. "$(dirname "$0")/lib.sh"
+
+printf 'FATEMA\nRAHMAN\nZZZ\nAKTER\n' > queries.txt
+cat > answers.txt <<'EOF'
+# FATEMA
+FATEMA JAHAN TAMMY 015 05 040
+BIBI FATEMA MIM 015 34 336
+KANIZ FATEMA SORNA 014 56 440
+# RAHMAN
+SADIA BINTA M RAHMAN 017 62 031
+SAKIA RAHMAN 017 75 523
+# ZZZ
+# AKTER
+SAZNIN AKTER ZITU 016 16 217
+SUMAIYA AKTER SWEETY 018 07 741
+SUNJIDA AKTER NIPA 012 20 350
+SUMAIA AKTER TISHA 011 77 602
+FARJANA AKTER POPY 014 27 168
+MOSAMMAD SHARMIN AKTER 015 10 657
+EOF
+
+run 5 --replicas 2 --queries queries.txt "$ROOT/phonebook1.txt"
+expect_log "Served 4 queries on 2 partitions x 2 replicas"
+expect_ordered < answers.txt
+
+# With several queries in flight they may finish in any order
+run 7 --replicas 3 --inflight 4 --hedge-pct 0 --queries queries.txt "$ROOT/phonebook1.txt"
+expect_log "Served 4 queries on 2 partitions x 3 replicas"
+expect < answers.txt
+
+sed -n '1,2p' queries.txt | run 3 --replicas 2 --queries - "$ROOT/phonebook1.txt"
+sed -n '1,7p' answers.txt | expect_ordered
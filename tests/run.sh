@@ -0,0 +1,24 @@
+#!/bin/sh
+# Runs every smoke test (or the ones named on the command line) against one build of the search
+# and the matrix programs and reports which failed. Needs mpic++, mpicc and mpirun on the PATH.
+#
+#   sh tests/run.sh              all tests
+#   sh tests/run.sh sort glob    only tests/sort.sh and tests/glob.sh
+
+DIR=$(cd "$(dirname "$0")" && pwd)
+PB_WORK=$(mktemp -d)
+export PB_WORK
+trap 'rm -rf "$PB_WORK"' EXIT
+
+mpic++ -O2 -o "$PB_WORK/search" "$DIR/../phonebook_mpi.cpp" || exit 1
+mpicc -O2 -o "$PB_WORK/matrix" "$DIR/../matrix_mul_mpi.c" -lm || exit 1
+
+if [ $# -eq 0 ]; then
+    set -- $(cd "$DIR" && ls *.sh | grep -v -e '^lib.sh$' -e '^run.sh$' | sed 's/\.sh$//')
+fi
+failed=0
+for t in "$@"; do
+    if bash "$DIR/$t.sh"; then echo "ok   $t"; else echo "FAIL $t"; failed=$((failed + 1)); fi
+done
+echo "$(($# - failed)) of $# smoke tests passed"
+[ $failed -eq 0 ]
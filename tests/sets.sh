@@ -0,0 +1,55 @@
+# Result sets (user-104): save searches as bitmaps, combine them with --and/--or/--andnot, start
+# from a saved set, and refuse a missing set or one saved over another phonebook.
+. "$(dirname "$0")/lib.sh"
+
+run 3 --save fatema "$ROOT/phonebook1.txt" FATEMA
+expect <<'EOF'
+FATEMA JAHAN TAMMY 015 05 040
+BIBI FATEMA MIM 015 34 336
+KANIZ FATEMA SORNA 014 56 440
+EOF
+run 3 --save akter "$ROOT/phonebook1.txt" AKTER
+
+run 3 --or akter "$ROOT/phonebook1.txt" FATEMA
+expect <<'EOF'
+FATEMA JAHAN TAMMY 015 05 040
+SAZNIN AKTER ZITU 016 16 217
+SUMAIYA AKTER SWEETY 018 07 741
+SUNJIDA AKTER NIPA 012 20 350
+SUMAIA AKTER TISHA 011 77 602
+BIBI FATEMA MIM 015 34 336
+FARJANA AKTER POPY 014 27 168
+KANIZ FATEMA SORNA 014 56 440
+MOSAMMAD SHARMIN AKTER 015 10 657
+EOF
+
+run 2 --and fatema "$ROOT/phonebook1.txt" JAHAN
+expect <<'EOF'
+FATEMA JAHAN TAMMY 015 05 040
+EOF
+
+run 1 --from fatema --andnot akter "$ROOT/phonebook1.txt"
+expect <<'EOF'
+FATEMA JAHAN TAMMY 015 05 040
+BIBI FATEMA MIM 015 34 336
+KANIZ FATEMA SORNA 014 56 440
+EOF
+
+run 2 --from akter --and fatema "$ROOT/phonebook1.txt"
+expect < /dev/null
+
+fails 2 --from nosuch "$ROOT/phonebook1.txt"
+expect_log "Result set 'nosuch' is missing"
+fails 3 --or nosuch "$ROOT/phonebook1.txt" FATEMA
+expect_log "Result set 'nosuch' is missing"
+printf '"SOMEONE ELSE","011 11 111"\n' > other.txt
+fails 2 --from fatema other.txt
+expect_log "belongs to another phonebook"
+
+# A set file cut short or with bytes past its last container is refused, not read as a smaller set
+head -c -3 .phonebook_results/fatema.roar > .phonebook_results/cut.roar
+fails 2 --from cut "$ROOT/phonebook1.txt"
+expect_log "Result set 'cut' is missing, corrupt"
+{ cat .phonebook_results/fatema.roar; printf 'x'; } > .phonebook_results/long.roar
+fails 3 --and long "$ROOT/phonebook1.txt" FATEMA
+expect_log "Result set 'long' is missing, corrupt"
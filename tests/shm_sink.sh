@@ -0,0 +1,53 @@
+# Shared-memory result ring (user-117): a consumer built on phonebook_ring.h reads the matches in
+# place while the search runs; what it reads equals the plain output, for a few lines and for a whole book.
+. "$(dirname "$0")/lib.sh"
+
+cat > consumer.c <<'EOF'
+#include <stdio.h>
+#include <unistd.h>
+#include "phonebook_ring.h"
+
+int main(int argc, char **argv) {
+    pb_ring ring;
+    while (pb_ring_attach(&ring, argv[1]) != 0) usleep(1000);   // Wait for the search to start
+    const char *data;
+    long n;
+    while ((n = pb_ring_next(&ring, &data)) > 0) {
+        fwrite(data, 1, n, stdout);
+        pb_ring_release(&ring);
+    }
+    pb_ring_detach(&ring);
+    return n < 0;
+}
+EOF
+cc -O2 -I"$ROOT" -o consumer consumer.c
+
+# Runs the search into a fresh ring while the consumer copies it to consumed.txt
+sink() {
+    rm -f results.ring
+    timeout 60 ./consumer results.ring > consumed.txt &
+    local reader=$!
+    run "$@"
+    wait $reader || fail "the consumer failed"
+}
+
+sink 3 --shm-sink results.ring "$ROOT/phonebook1.txt" AKTER
+[ ! -e output.txt ] || fail "--shm-sink should not write output.txt"
+expect consumed.txt <<'EOF'
+SAZNIN AKTER ZITU 016 16 217
+SUMAIYA AKTER SWEETY 018 07 741
+SUNJIDA AKTER NIPA 012 20 350
+SUMAIA AKTER TISHA 011 77 602
+FARJANA AKTER POPY 014 27 168
+MOSAMMAD SHARMIN AKTER 015 10 657
+EOF
+
+synthetic_book names.txt
+run 3 names.txt A
+mv output.txt plain.txt
+sink 3 --shm-sink results.ring names.txt A
+expect consumed.txt < plain.txt
+
+# A ring that cannot be created ends the run with an error instead of dropping every match
+fails 2 --shm-sink "$WORK/missing/results.ring" "$ROOT/phonebook1.txt" AKTER
+expect_log "Cannot create the shared-memory sink $WORK/missing/results.ring"
@@ -0,0 +1,36 @@
+# Snapshots (user-103): build one, look names up through its perfect hash, search it, and make
+# sure a truncated or foreign file is refused instead of read past its end.
+. "$(dirname "$0")/lib.sh"
+
+run 2 --build-snapshot book.snap "$ROOT/phonebook1.txt"
+expect_log "89 records"
+
+run 1 --snapshot book.snap --exact "fatema  JAHAN tammy"
+expect <<'EOF'
+FATEMA JAHAN TAMMY 015 05 040
+EOF
+
+run 1 --snapshot book.snap --exact "NOBODY"
+expect < /dev/null
+
+run 2 --snapshot book.snap FATEMA
+expect <<'EOF'
+FATEMA JAHAN TAMMY 015 05 040
+BIBI FATEMA MIM 015 34 336
+KANIZ FATEMA SORNA 014 56 440
+EOF
+
+size=$(wc -c < book.snap)
+for keep in 8 600 $((size / 2)) $((size - 8)); do
+    head -c $keep book.snap > cut.snap
+    fails 1 --snapshot cut.snap --exact "FATEMA JAHAN TAMMY"
+    expect_log "Cannot use snapshot cut.snap"
+    fails 2 --snapshot cut.snap FATEMA
+    expect_log "Cannot use snapshot cut.snap"
+done
+
+head -c 4096 /dev/zero > zero.snap
+fails 1 --snapshot zero.snap --exact "FATEMA JAHAN TAMMY"
+expect_log "not a snapshot of this format"
+fails 1 --snapshot missing.snap --exact "FATEMA JAHAN TAMMY"
+expect_log "cannot open"
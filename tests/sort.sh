@@ -0,0 +1,41 @@
+# Sorted output (user-105): --sort name|phone on one and several ranks. The names share their first
+# 8 bytes, so only the tie-break on the full key can order them; equal names keep the file order.
+. "$(dirname "$0")/lib.sh"
+
+printf '%s\n' '"ABCDEFGH","019 00 004"' '"ABCDEFGHZ","013 00 001"' '"ABCDEFGHA","017 00 003"' \
+    '"ABCDEFGHM","015 00 002"' '"ABC","016 00 005"' '"ZED ABC","014 00 006"' '"NOBODY","011 00 007"' \
+    '"ABCDEFGHA","012 00 008"' > names.txt
+
+for np in 1 3; do
+    run $np --sort name names.txt ABC
+    expect_ordered <<'EOF'
+ABC 016 00 005
+ABCDEFGH 019 00 004
+ABCDEFGHA 017 00 003
+ABCDEFGHA 012 00 008
+ABCDEFGHM 015 00 002
+ABCDEFGHZ 013 00 001
+ZED ABC 014 00 006
+EOF
+
+    run $np --sort phone names.txt ABC
+    expect_ordered <<'EOF'
+ABCDEFGHA 012 00 008
+ABCDEFGHZ 013 00 001
+ZED ABC 014 00 006
+ABCDEFGHM 015 00 002
+ABC 016 00 005
+ABCDEFGHA 017 00 003
+ABCDEFGH 019 00 004
+EOF
+done
+
+# The example that the prefix-only tie-break left unsorted
+printf '%s\n' '"ABCDEFGH","1"' '"ABCDEFGHZ","2"' '"ABCDEFGHA","3"' '"ABCDEFGHM","4"' > prefix.txt
+run 1 --sort name prefix.txt ABC
+expect_ordered <<'EOF'
+ABCDEFGH 1
+ABCDEFGHA 3
+ABCDEFGHM 4
+ABCDEFGHZ 2
+EOF
@@ -0,0 +1,34 @@
+# Dictionary-encoded tokens (user-102): --tokens finds the same contacts as the plain scan, for
+# terms inside one token, across a token boundary and matching many tokens.
+. "$(dirname "$0")/lib.sh"
+
+run 3 --tokens "$ROOT/phonebook1.txt" "MA JA"
+expect <<'EOF'
+FATEMA JAHAN TAMMY 015 05 040
+PURNIMA JAMAN NIDRA 015 54 613
+EOF
+
+run 3 --tokens "$ROOT/phonebook1.txt" Z
+expect <<'EOF'
+SAZNIN AKTER ZITU 016 16 217
+MST. NAZIA SULTANA MUMU 014 34 273
+KHADIZATUL KOBRA 015 03 625
+SANZIDA TASNIM 013 16 885
+MARIYA AZAD DOLA 016 14 266
+HALIMA TUZ SADIA 018 71 476
+AMRATUL MAHARAZ 017 22 134
+KANIZ FATEMA SORNA 014 56 440
+SADIA AFROZ MOW 011 35 161
+EOF
+
+run 2 --tokens --normalize nfc "$ROOT/phonebook1.txt" "fatema j"
+expect <<'EOF'
+FATEMA JAHAN TAMMY 015 05 040
+EOF
+
+for term in FATEMA AKT "N " ZZZ; do
+    run 2 "$ROOT/phonebook1.txt" "$term"
+    mv output.txt plain.txt
+    run 2 --tokens "$ROOT/phonebook1.txt" "$term"
+    expect < plain.txt
+done
@@ -0,0 +1,17 @@
+# LZ4-compressed messages (user-118): on a slow link the chunks travel compressed, on a very fast
+# one only the periodic probe is compressed, and the matches are the same as without compression.
+. "$(dirname "$0")/lib.sh"
+
+synthetic_book names.txt
+
+run 3 names.txt "KHAN KHAN"
+[ "$(wc -l < output.txt)" -eq 585 ] || fail "expected 585 matches"
+mv output.txt plain.txt
+
+run 3 --wire-lz4 0.1 names.txt "KHAN KHAN"
+expect_log "Distribution: 2 of 2 messages compressed"
+expect < plain.txt
+
+run 3 --wire-lz4 100000 names.txt "KHAN KHAN"
+expect_log "Distribution: 1 of 2 messages compressed"
+expect < plain.txt